@@ -39,14 +39,29 @@
 #ifndef OTA_CONFIG_H_
 #define OTA_CONFIG_H_
 
+/* The block request window and the request wait time are provided by the
+ * OTA flow controller. */
+#include "ota_flow_control.h"
+
 /**
  * @brief Log base 2 of the size of the file data block message (excluding the
  * header).
  *
- * <b>Possible values:</b> Any unsigned 32 integer. <br>
+ * In this application the value is set with OTA_FILE_BLOCK_SIZE_LOG2 in the
+ * Makefile. All buffers whose size depends on the block size follow it. The
+ * size is fixed at build time; the OTA library sizes OtaEventData_t and the
+ * block bitmap from it, so it cannot be selected when the OTA agent starts.
+ *
+ * <b>Possible values:</b> 10 (1 KB) to 14 (16 KB). <br>
  * <b>Default value:</b> '12'
  */
-#define otaconfigLOG2_FILE_BLOCK_SIZE           12UL
+#ifndef otaconfigLOG2_FILE_BLOCK_SIZE
+    #define otaconfigLOG2_FILE_BLOCK_SIZE       12UL
+#endif
+
+#if ( otaconfigLOG2_FILE_BLOCK_SIZE < 10 ) || ( otaconfigLOG2_FILE_BLOCK_SIZE > 14 )
+    #error "otaconfigLOG2_FILE_BLOCK_SIZE must select a block size from 1 KB to 16 KB."
+#endif
 
 
 /**
@@ -72,10 +87,14 @@
  * service so we will only send the request message after being idle for this
  * amount of time.
  *
+ * In this application the wait time is derived at runtime from the measured
+ * request to block round trip time, see ota_flow_control.c. It is bounded by
+ * OTA_FLOW_CONTROL_MIN_REQUEST_WAIT_MS and OTA_FLOW_CONTROL_MAX_REQUEST_WAIT_MS.
+ *
  * <b>Possible values:</b> Any unsigned 32 integer. <br>
  * <b>Default value:</b> '10000'
  */
-#define otaconfigFILE_REQUEST_WAIT_MS           10000U
+#define otaconfigFILE_REQUEST_WAIT_MS           OtaFlowControl_GetRequestWaitMs()
 
 /**
  * @brief The maximum allowed length of the thing name used by the OTA agent.
@@ -104,10 +123,16 @@
  * limit or lower based on how many data blocks response is expected for each
  * data requests.
  *
+ * In this application the number of blocks is adapted at runtime to the
+ * measured round trip time, the OTA event buffer pool occupancy and dropped
+ * blocks, see ota_flow_control.c. It starts at
+ * OTA_FLOW_CONTROL_INITIAL_WINDOW and is bounded by
+ * OTA_FLOW_CONTROL_MAX_WINDOW.
+ *
  * <b>Possible values:</b> Any unsigned 32 integer value greater than 0. <br>
  * <b>Default value:</b> '1'
  */
-#define otaconfigMAX_NUM_BLOCKS_REQUEST         8U
+#define otaconfigMAX_NUM_BLOCKS_REQUEST         OtaFlowControl_GetBlockWindow()
 
 /**
  * @brief The maximum number of requests allowed to send without a response
@@ -140,10 +165,20 @@
  * @note This configurations parameter sets the maximum number of static data
  * buffers used by the OTA agent for job and file data blocks received.
  *
+ * In this application the number of buffers follows from the block size so
+ * that the buffers always take about OTA_DATA_BUFFER_MEMORY_SIZE bytes of
+ * RAM, i.e. 10 buffers of 4 KB blocks. OTA_DATA_BLOCK_SIZE is the size of the
+ * data member of OtaEventData_t, including the space for the block header.
+ * The MQTT dispatcher queues the received messages in these buffers as well.
+ *
  * <b>Possible values:</b> Any unsigned 32 integer. <br>
  * <b>Default value:</b> '1'
  */
-#define otaconfigMAX_NUM_OTA_DATA_BUFFERS       10U
+#ifndef OTA_DATA_BUFFER_MEMORY_SIZE
+    #define OTA_DATA_BUFFER_MEMORY_SIZE         ( 56U * 1024U )
+#endif
+
+#define otaconfigMAX_NUM_OTA_DATA_BUFFERS       ( OTA_DATA_BUFFER_MEMORY_SIZE / OTA_DATA_BLOCK_SIZE )
 
 /**
  * @brief Flag to enable booting into updates that have an identical or lower
@@ -0,0 +1,199 @@
+# (c) 2022, Cypress Semiconductor Corporation. All rights reserved.
+# Licensed under the Apache License, Version 2.0 (the "License").
+# You may not use this file except in compliance with the License.
+# A copy of the License is located at
+#     http://www.apache.org/licenses/LICENSE-2.0
+# or in the "license" file accompanying this file. This file is distributed 
+# on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either 
+# express or implied. See the License for the specific language governing 
+# permissions and limitations under the License.
+#
+# Delta patch generator for OTA updates. The patch rebuilds the new image from
+# the image running on the device; the format is applied by source/ota_delta.c.
+
+import struct
+import zlib
+
+DELTA_MAGIC = b"OTAD"
+DELTA_VERSION = 1
+
+# Bytes hashed to find candidate matches in the old image.
+ANCHOR_SIZE = 8
+
+# Candidate positions kept per anchor.
+MAX_CANDIDATES = 4
+
+# Shortest exact match starting an add section.
+MIN_MATCH = 32
+
+# Zero differences needed to end a literal run, shorter runs are cheaper inline.
+MIN_ZERO_RUN = 3
+
+
+def _varint(value):
+    out = bytearray()
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+    return bytes(out)
+
+
+def _zigzag(value):
+    return (value << 1) if value >= 0 else ((-value) << 1) - 1
+
+
+def _index(old):
+    index = {}
+    for pos in range(len(old) - ANCHOR_SIZE + 1):
+        positions = index.setdefault(old[pos:pos + ANCHOR_SIZE], [])
+        if len(positions) < MAX_CANDIDATES:
+            positions.append(pos)
+    return index
+
+
+def _exact_length(old, new, old_pos, new_pos):
+    length = 0
+    limit = min(len(old) - old_pos, len(new) - new_pos)
+    while length < limit and old[old_pos + length] == new[new_pos + length]:
+        length += 1
+    return length
+
+
+def _approximate_length(old, new, old_pos, new_pos, length):
+    # Extend an exact match over mismatching bytes while at least half of the
+    # bytes still match, e.g. code moved by a changed branch offset.
+    limit = min(len(old) - old_pos, len(new) - new_pos)
+    matches = length
+    best_score = length
+    best_length = length
+    while length < limit:
+        if old[old_pos + length] == new[new_pos + length]:
+            matches += 1
+        length += 1
+        score = 2 * matches - length
+        if score > best_score:
+            best_score = score
+            best_length = length
+        elif score < best_score - 64:
+            break
+    return best_length
+
+
+def _find_segments(old, new):
+    index = _index(old)
+    segments = []
+    previous_end = 0
+    new_pos = 0
+    while new_pos <= len(new) - ANCHOR_SIZE:
+        best_old = -1
+        best_length = 0
+        for old_pos in index.get(new[new_pos:new_pos + ANCHOR_SIZE], ()):
+            length = _exact_length(old, new, old_pos, new_pos)
+            if length > best_length:
+                best_old, best_length = old_pos, length
+        if best_length < MIN_MATCH:
+            new_pos += 1
+            continue
+
+        # Extend backwards into the bytes not covered yet.
+        while new_pos > previous_end and best_old > 0 and new[new_pos - 1] == old[best_old - 1]:
+            new_pos -= 1
+            best_old -= 1
+            best_length += 1
+
+        best_length = _approximate_length(old, new, best_old, new_pos, best_length)
+        segments.append((new_pos, best_old, best_length))
+        new_pos += best_length
+        previous_end = new_pos
+    return segments
+
+
+def _encode_add(old, new, old_pos, new_pos, length):
+    diff = bytes((new[new_pos + i] - old[old_pos + i]) & 0xFF for i in range(length))
+    out = bytearray()
+    pos = 0
+    while pos < length:
+        start = pos
+        while pos < length and diff[pos] == 0:
+            pos += 1
+        zero_run = pos - start
+
+        start = pos
+        while pos < length:
+            if diff[pos:pos + MIN_ZERO_RUN] == bytes(MIN_ZERO_RUN):
+                break
+            pos += 1
+        out += _varint(zero_run) + _varint(pos - start) + diff[start:pos]
+    return bytes(out)
+
+
+def create_patch(old, new):
+    """Returns a patch rebuilding new from old."""
+    segments = _find_segments(old, new)
+
+    # The device starts reading the old image at offset 0, so a first match
+    # elsewhere needs a leading record to carry the seek.
+    if segments and segments[0][0] == 0 and segments[0][1] != 0:
+        new_pos, old_pos, length = segments[0]
+        segments[0] = (1, old_pos + 1, length - 1)
+        if length == 1:
+            segments.pop(0)
+
+    patch = bytearray(struct.pack("<4sB3xIII", DELTA_MAGIC, DELTA_VERSION,
+                                  len(old), zlib.crc32(old) & 0xFFFFFFFF, len(new)))
+    if not segments or segments[0][0] > 0:
+        insert_end = segments[0][0] if segments else len(new)
+        seek = segments[0][1] if segments else 0
+        patch += _varint(0) + _varint(insert_end) + _varint(_zigzag(seek)) + new[:insert_end]
+
+    for number, (new_pos, segment_old, length) in enumerate(segments):
+        if number + 1 < len(segments):
+            insert_end, next_old = segments[number + 1][0], segments[number + 1][1]
+        else:
+            insert_end, next_old = len(new), segment_old + length
+        patch += _varint(length) + _varint(insert_end - new_pos - length)
+        patch += _varint(_zigzag(next_old - segment_old - length))
+        patch += _encode_add(old, new, segment_old, new_pos, length)
+        patch += new[new_pos + length:insert_end]
+    return bytes(patch)
+
+
+def apply_patch(old, patch):
+    """Rebuilds the new image, used to check a patch before it is uploaded."""
+    magic, version, old_size, old_crc, new_size = struct.unpack_from("<4sB3xIII", patch)
+    if magic != DELTA_MAGIC or version != DELTA_VERSION or old_size != len(old) or \
+            old_crc != zlib.crc32(old) & 0xFFFFFFFF:
+        raise ValueError("patch does not apply to this image")
+
+    def varint():
+        nonlocal pos
+        value, shift = 0, 0
+        while True:
+            byte = patch[pos]
+            pos += 1
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if byte < 0x80:
+                return value
+
+    pos = struct.calcsize("<4sB3xIII")
+    new = bytearray()
+    old_pos = 0
+    while len(new) < new_size:
+        add_length, insert_length, seek = varint(), varint(), varint()
+        end = len(new) + add_length
+        while len(new) < end:
+            zero_run, literal = varint(), varint()
+            new += old[old_pos:old_pos + zero_run]
+            old_pos += zero_run
+            for byte in patch[pos:pos + literal]:
+                new.append((old[old_pos] + byte) & 0xFF)
+                old_pos += 1
+            pos += literal
+        new += patch[pos:pos + insert_length]
+        pos += insert_length
+        old_pos += (seek >> 1) ^ -(seek & 1)
+    if len(new) != new_size or pos != len(patch):
+        raise ValueError("patch is malformed")
+    return bytes(new)
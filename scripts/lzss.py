@@ -0,0 +1,106 @@
+# (c) 2022, Cypress Semiconductor Corporation. All rights reserved.
+# Licensed under the Apache License, Version 2.0 (the "License").
+# You may not use this file except in compliance with the License.
+# A copy of the License is located at
+#     http://www.apache.org/licenses/LICENSE-2.0
+# or in the "license" file accompanying this file. This file is distributed 
+# on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either 
+# express or implied. See the License for the specific language governing 
+# permissions and limitations under the License.
+#
+# LZSS compressor for OTA updates. The small window lets the device decompress
+# the file as it is received; the format is decoded by source/ota_decompress.c.
+
+import struct
+
+LZSS_MAGIC = b"OTAZ"
+LZSS_VERSION = 1
+
+# Window of the device, see OTA_DECOMPRESS_WINDOW_BITS.
+WINDOW_BITS = 10
+
+MIN_MATCH = 3
+
+# Candidate positions searched per match.
+MAX_CHAIN = 64
+
+HEADER_FORMAT = "<4sBB2xI"
+
+
+def compress(data, window_bits=WINDOW_BITS):
+    """Returns data compressed for a device window of 2^window_bits bytes."""
+    window = 1 << window_bits
+    max_match = (1 << (16 - window_bits)) - 1 + MIN_MATCH
+    chains = {}
+    out = bytearray(struct.pack(HEADER_FORMAT, LZSS_MAGIC, LZSS_VERSION, window_bits, len(data)))
+    flags_pos = len(out)
+    flag_count = 8
+    pos = 0
+
+    def insert(position):
+        if position + MIN_MATCH <= len(data):
+            chain = chains.setdefault(data[position:position + MIN_MATCH], [])
+            chain.append(position)
+            if len(chain) > MAX_CHAIN:
+                del chain[0]
+
+    while pos < len(data):
+        if flag_count == 8:
+            flags_pos = len(out)
+            out.append(0)
+            flag_count = 0
+
+        best_length = 0
+        best_distance = 0
+        limit = min(max_match, len(data) - pos)
+        for candidate in reversed(chains.get(data[pos:pos + MIN_MATCH], ())):
+            if pos - candidate > window:
+                break
+            length = 0
+            while length < limit and data[candidate + length] == data[pos + length]:
+                length += 1
+            if length > best_length:
+                best_length, best_distance = length, pos - candidate
+                if length == limit:
+                    break
+
+        if best_length >= MIN_MATCH:
+            token = (best_distance - 1) | ((best_length - MIN_MATCH) << window_bits)
+            out += struct.pack("<H", token)
+        else:
+            best_length = 1
+            out[flags_pos] |= 1 << flag_count
+            out.append(data[pos])
+        flag_count += 1
+
+        for position in range(pos, pos + best_length):
+            insert(position)
+        pos += best_length
+    return bytes(out)
+
+
+def decompress(stream):
+    """Decompresses a stream, used to check it before it is uploaded."""
+    magic, version, window_bits, size = struct.unpack_from(HEADER_FORMAT, stream)
+    if magic != LZSS_MAGIC or version != LZSS_VERSION:
+        raise ValueError("not a compressed stream")
+    out = bytearray()
+    pos = struct.calcsize(HEADER_FORMAT)
+    while len(out) < size:
+        flags = stream[pos]
+        pos += 1
+        for bit in range(8):
+            if len(out) >= size:
+                break
+            if flags & (1 << bit):
+                out.append(stream[pos])
+                pos += 1
+            else:
+                token = stream[pos] | (stream[pos + 1] << 8)
+                pos += 2
+                distance = (token & ((1 << window_bits) - 1)) + 1
+                for _ in range((token >> window_bits) + MIN_MATCH):
+                    out.append(out[-distance])
+    if pos != len(stream):
+        raise ValueError("stream is malformed")
+    return bytes(out)
@@ -28,6 +28,8 @@ import user
 from user import User
 import json
 import logging
+import delta
+import lzss
 
 parser = argparse.ArgumentParser(description='Script to start OTA update')
 parser.add_argument("--profile", help="Profile name created using aws configure", required=True)
@@ -40,6 +42,8 @@ parser.add_argument("--s3bucket", help="S3 bucket to store firmware updates", re
 parser.add_argument("--otasigningprofile", help="Signing profile to be created or used", required=True)
 parser.add_argument("--signingcertificateid", help="certificate id (not arn) to be used", required=False)
 parser.add_argument("--buildlocation", help="build folder location (can be relative)", default="../build/CY8CKIT-064S0S2-4343W/Debug", required=False)
+parser.add_argument("--patchfrom", help="image (.bin) running on the device. When given, a delta patch against it is uploaded instead of the full image", default="", required=False)
+parser.add_argument("--compress", help="compress the uploaded file, the device decompresses it while it is received", action="store_true")
 parser.add_argument("--appversion", help="version of the image being uploade. The appversion value should follow the format APP_VERSION_MAJOR-APP_VERSION_MINOR-APP_VERSION_BUILD that is appended to the filename of the file being uploaded",default="0-0-0",required=True)
 args=parser.parse_args()
 
@@ -64,6 +68,45 @@ class AWS_IoT_OTA:
             logging.error(e)
             sys.exit
 
+        if args.patchfrom != '':
+            self.BuildPatchFile()
+
+        if args.compress:
+            self.CompressFile()
+
+    # Replace the image to upload by a delta patch against the running image
+    def BuildPatchFile(self):
+        try:
+            old = Path(args.patchfrom).read_bytes()
+            new = self.APP_FULL_NAME.read_bytes()
+            patch = delta.create_patch(old, new)
+            if delta.apply_patch(old, patch) != new:
+                raise ValueError("patch does not rebuild the image")
+            self.APP_NAME="mtb-example-aws-iot-ota-mqtt_" + args.appversion + ".delta"
+            self.APP_FULL_NAME=self.BUILD_PATH / Path(self.APP_NAME)
+            self.APP_FULL_NAME.write_bytes(patch)
+            print ("Delta patch for uploading to AWS: %s, %u bytes for a %u byte image (%.1f%%)"
+                   % (self.APP_FULL_NAME, len(patch), len(new), 100.0 * len(patch) / len(new)))
+        except Exception as e:
+            print("Error creating delta patch: %s" % e)
+            sys.exit()
+
+    # Replace the file to upload by its compressed form
+    def CompressFile(self):
+        try:
+            data = self.APP_FULL_NAME.read_bytes()
+            stream = lzss.compress(data)
+            if lzss.decompress(stream) != data:
+                raise ValueError("stream does not decompress to the file")
+            self.APP_NAME = self.APP_NAME + ".lz"
+            self.APP_FULL_NAME=self.BUILD_PATH / Path(self.APP_NAME)
+            self.APP_FULL_NAME.write_bytes(stream)
+            print ("Compressed file for uploading to AWS: %s, %u bytes for %u bytes (%.1f%%)"
+                   % (self.APP_FULL_NAME, len(stream), len(data), 100.0 * len(stream) / len(data)))
+        except Exception as e:
+            print("Error compressing file: %s" % e)
+            sys.exit()
+
 
 
 
@@ -48,6 +48,8 @@
 
 #include <FreeRTOS.h>
 #include <task.h>
+#include <event_groups.h>
+#include <timers.h>
 
 /* Wi-Fi connection manager header files. */
 #include "cy_wcm.h"
@@ -56,6 +58,55 @@
 #include "cy_mqtt_api.h"
 #include "mqtt_subscription_manager.h"
 
+/* MQTT dispatcher include. */
+#include "mqtt_dispatcher.h"
+
+/* OTA event buffer pool include. */
+#include "ota_buffer_pool.h"
+
+
+/* Deferred log pipeline include. */
+#include "ota_log.h"
+
+/* OTA flow controller include. */
+#include "ota_flow_control.h"
+
+/* OTA flash writer include. */
+#include "ota_flash_writer.h"
+
+/* Reconnect backoff include. */
+#include "retry_backoff.h"
+
+/* OTA telemetry include. */
+#include "ota_telemetry.h"
+
+/* OTA agent memory pool include. */
+#include "ota_mem_pool.h"
+
+/* OTA delta update include. */
+#include "ota_delta.h"
+
+/* OTA decompression include. */
+#include "ota_decompress.h"
+
+/* OTA image digest include. */
+#include "ota_image_hash.h"
+
+/* OTA stream lanes include. */
+#include "ota_stream_lanes.h"
+
+/* Stream block decoder include. */
+#include "ota_block_decoder.h"
+
+/* Dropped block recovery include. */
+#include "ota_block_recovery.h"
+
+/* Fast retransmit of missing blocks include. */
+#include "ota_fast_retransmit.h"
+
+/* Wi-Fi access point cache include. */
+#include "wifi_ap_cache.h"
+
 /* OTA Library include. */
 #include "ota.h"
 #include "ota_config.h"
@@ -107,6 +158,27 @@
  */
 #define OTA_MQTT_KEEP_ALIVE_INTERVAL_SECONDS    (0U)
 
+/* Set to 1 to connect with a persistent session (clean session flag cleared),
+ * so that the broker keeps the QoS 1 messages published while the device is
+ * disconnected. cy_mqtt does not report the session present flag of CONNACK,
+ * so the OTA topics are still subscribed again on every connect.
+ */
+#ifndef OTA_MQTT_PERSISTENT_SESSION
+#define OTA_MQTT_PERSISTENT_SESSION             (0U)
+#endif
+
+/* Granted QoS of a topic filter rejected by the broker in the SUBACK. */
+#define OTA_MQTT_SUBACK_FAILURE                 (0x80U)
+
+/* Bounds of the jittered exponential delay between connection attempts. */
+#ifndef OTA_MQTT_RECONNECT_BASE_DELAY_MS
+#define OTA_MQTT_RECONNECT_BASE_DELAY_MS        (500U)
+#endif
+
+#ifndef OTA_MQTT_RECONNECT_MAX_DELAY_MS
+#define OTA_MQTT_RECONNECT_MAX_DELAY_MS         (32000U)
+#endif
+
 /* @brief Timeout for MQTT_ProcessLoop function in milliseconds. */
 #define MQTT_PROCESS_LOOP_TIMEOUT_MS            (100U)
 
@@ -121,9 +193,8 @@
 
 #define OTA_NETWORK_BUFFER_SIZE                  (otaconfigFILE_BLOCK_SIZE + 128)
 
-/* The delay used in the main OTA Demo task loop to periodically output the OTA
- * statistics like number of packets received, dropped, processed and queued
- * per connection.
+/* The delay used by the OTA Demo task before retrying a failed connection and
+ * while counting down to exit.
  */
 #define OTA_EXAMPLE_TASK_DELAY_MS                (1000U)
 
@@ -132,6 +203,18 @@
  */
 #define OTA_SUSPEND_TIMEOUT_MS                   (5000U)
 
+/* Events driving the OTA demo supervisor loop. */
+#define OTA_DEMO_EVENT_DISCONNECT                (1U << 0)   /* MQTT connection lost. */
+#define OTA_DEMO_EVENT_AGENT_STATE_CHANGE        (1U << 1)   /* OTA agent changed state. */
+#define OTA_DEMO_EVENT_CONNECT_COMPLETE          (1U << 2)   /* MQTT connection established. */
+#define OTA_DEMO_EVENT_SHUTDOWN                  (1U << 3)   /* OTA agent stopped. */
+#define OTA_DEMO_EVENT_TELEMETRY                 (1U << 4)   /* Telemetry interval elapsed. */
+#define OTA_DEMO_EVENT_ALL                       (OTA_DEMO_EVENT_DISCONNECT | \
+                                                  OTA_DEMO_EVENT_AGENT_STATE_CHANGE | \
+                                                  OTA_DEMO_EVENT_CONNECT_COMPLETE | \
+                                                  OTA_DEMO_EVENT_SHUTDOWN | \
+                                                  OTA_DEMO_EVENT_TELEMETRY)
+
 /* The timeout for waiting before exiting the OTA demo. */
 #define OTA_DEMO_EXIT_TIMEOUT_MS                 (10000U)
 
@@ -143,8 +226,11 @@
  */
 #define OTA_MAX_STREAM_NAME_SIZE                 (128U)
 
-/* The common prefix for all OTA topics. */
-#define OTA_TOPIC_PREFIX                        "$aws/things/+/"
+/* The common prefix for all OTA topics of this thing. The thing name is the
+ * client identifier passed to OTA_Init(), so all OTA topics are known at
+ * compile time and their lengths are resolved with sizeof() instead of strlen().
+ */
+#define OTA_TOPIC_PREFIX                        "$aws/things/" CLIENT_IDENTIFIER "/"
 
 /* The string used for jobs topics. */
 #define OTA_TOPIC_JOBS                          "jobs"
@@ -152,6 +238,42 @@
 /* The string used for streaming service topics. */
 #define OTA_TOPIC_STREAM                        "streams"
 
+/* Length of a topic string literal, excluding the NULL terminator. */
+#define OTA_TOPIC_LENGTH( topic )               (( uint16_t ) ( sizeof( topic ) - 1U ))
+
+/* Prefixes of the thing-specific jobs and streams topics. */
+#define OTA_JOBS_TOPIC_PREFIX                   OTA_TOPIC_PREFIX OTA_TOPIC_JOBS "/"
+#define OTA_STREAM_TOPIC_PREFIX                 OTA_TOPIC_PREFIX OTA_TOPIC_STREAM "/"
+
+/* Suffixes of the job topics carrying job documents. */
+#define OTA_JOB_SUFFIX_NEXT_GET_ACCEPTED        "$next/get/accepted"
+#define OTA_JOB_SUFFIX_NOTIFY_NEXT              "notify-next"
+
+/* Suffix of the stream topic carrying file block requests. */
+#define OTA_STREAM_SUFFIX_GET_CBOR              "/get/cbor"
+
+/* Size of the buffer holding the stream topic file block requests are sent on. */
+#define OTA_STREAM_REQUEST_TOPIC_SIZE           ( OTA_TOPIC_LENGTH( OTA_STREAM_TOPIC_PREFIX OTA_STREAM_SUFFIX_GET_CBOR ) + \
+                                                  OTA_MAX_STREAM_NAME_SIZE )
+
+/* Topic the OTA performance telemetry is published on. Topics below $aws are
+ * reserved, so the telemetry goes to a device data topic of this thing. The
+ * AWS IoT policy of the thing must allow publishing to it.
+ */
+#ifndef OTA_TELEMETRY_TOPIC
+#define OTA_TELEMETRY_TOPIC                     "dt/ota/" CLIENT_IDENTIFIER "/telemetry"
+#endif
+
+/* Interval at which the telemetry is published while a job is downloading.
+ * Set to 0 to only publish the summary at the end of every job.
+ */
+#ifndef OTA_TELEMETRY_INTERVAL_MS
+#define OTA_TELEMETRY_INTERVAL_MS               (10000U)
+#endif
+
+/* Size of the buffer holding a telemetry document. */
+#define OTA_TELEMETRY_DOCUMENT_SIZE             (256U)
+
 #define OTA_THREAD_SIZE                         (1024 * 4)
 
 #define OTA_THREAD_PRIORITY                     (configMAX_PRIORITIES - 4)
@@ -170,9 +292,97 @@ const AppVersion32_t appFirmwareVersion =
 /* Keep a flag for indicating if the MQTT connection is alive. */
 bool mqttSessionEstablished = false;
 
-/* Semaphore for synchronizing buffer operations. */
-SemaphoreHandle_t bufferSemaphore;
-SemaphoreHandle_t mqtt_discon_Semaphore;
+/* Event group driving the OTA demo supervisor loop. */
+EventGroupHandle_t otaDemoEventGroup;
+
+/* Last OTA agent state seen by the agent task, to detect state changes. */
+static OtaState_t lastAgentState = OtaAgentStateInit;
+
+/* Connection attempt statistics since boot. */
+typedef struct otaConnectionStatistics
+{
+    uint32_t connectAttempts;       /* Calls to cy_mqtt_connect. */
+    uint32_t connectFailures;       /* Failed connection attempts. */
+    uint32_t lastReconnectMs;       /* Time from the last disconnect to the reconnect. */
+    uint32_t maxReconnectMs;        /* Longest time from a disconnect to the reconnect. */
+    uint32_t subscribeRoundTrips;   /* SUBSCRIBE packets sent. */
+    uint32_t subscribeTimeMs;       /* Time spent waiting for SUBACKs. */
+    uint32_t unsubscribeRoundTrips; /* UNSUBSCRIBE packets sent. */
+    uint32_t unsubscribeTimeMs;     /* Time spent waiting for UNSUBACKs. */
+    uint32_t topicsCoalesced;       /* Requests served by a packet sent for a companion topic. */
+} otaConnectionStatistics_t;
+
+/* Connection statistics since boot. */
+static otaConnectionStatistics_t otaConnectionStatistics = { 0 };
+
+/* Wi-Fi connection statistics of this boot. */
+typedef struct wifiConnectionStatistics
+{
+    uint32_t attempts;              /* Calls to cy_wcm_connect_ap. */
+    uint32_t cachedApJoins;         /* Access point joined from the cache, without a scan. */
+    uint32_t cachedApMisses;        /* Cached access point not joined, fell back to a scan. */
+    uint32_t lastJoinMs;            /* Duration of the last cy_wcm_connect_ap. */
+    uint32_t timeToIpMs;            /* Time from boot until an IP address was obtained. */
+} wifiConnectionStatistics_t;
+
+/* Wi-Fi connection statistics. */
+static wifiConnectionStatistics_t wifiConnectionStatistics = { 0 };
+
+/* Delay between connection attempts. */
+static RetryBackoff_t reconnectBackoff;
+
+/* Set once the connection was lost, until it is re-established. */
+static bool mqttReconnecting = false;
+
+/* Time the connection was lost. */
+static TickType_t mqttDisconnectTick = 0;
+
+/* Job topics the OTA agent subscribes right after each other when it
+ * requests a job, and unsubscribes right after each other on shutdown. They
+ * are sent to the broker in a single packet. */
+static const struct
+{
+    const char * pFilter;
+    uint16_t filterLength;
+} otaCompanionTopics[] =
+{
+        { OTA_JOBS_TOPIC_PREFIX OTA_JOB_SUFFIX_NEXT_GET_ACCEPTED,
+          OTA_TOPIC_LENGTH( OTA_JOBS_TOPIC_PREFIX OTA_JOB_SUFFIX_NEXT_GET_ACCEPTED ) },
+        { OTA_JOBS_TOPIC_PREFIX OTA_JOB_SUFFIX_NOTIFY_NEXT,
+          OTA_TOPIC_LENGTH( OTA_JOBS_TOPIC_PREFIX OTA_JOB_SUFFIX_NOTIFY_NEXT ) }
+};
+
+/* Number of companion topics. */
+#define OTA_NUM_COMPANION_TOPICS    ( sizeof( otaCompanionTopics ) / sizeof( otaCompanionTopics[ 0 ] ) )
+
+/* Companion topics subscribed or unsubscribed by a packet sent for another
+ * companion, before the OTA agent asked for them. */
+static bool companionSubscribedAhead[ OTA_NUM_COMPANION_TOPICS ];
+static bool companionUnsubscribedAhead[ OTA_NUM_COMPANION_TOPICS ];
+
+/* Statistics of the payload handoff from the MQTT layer to the OTA agent. */
+typedef struct otaDataPathStatistics
+{
+    uint32_t bytesReceived;     /* Job document and file block payload bytes received. */
+    uint32_t bytesCopied;       /* Payload bytes copied into event buffers by the loans. */
+    uint32_t buffersLoaned;     /* Event buffers handed over to the OTA agent. */
+    uint32_t loansReclaimed;    /* Loans taken back because the event could not be queued. */
+    uint32_t payloadsDropped;   /* Payloads dropped for lack of a buffer or being oversized. */
+    uint32_t blocksStaged;      /* Blocks copied from the network buffer into the flash writer. */
+    uint32_t blocksRejected;    /* Stream data messages that could not be decoded or staged. */
+} otaDataPathStatistics_t;
+
+/* Payload handoff statistics for the current job, updated by the dispatcher
+ * and agent tasks. Only accessed inside a critical section. */
+static otaDataPathStatistics_t otaDataPathStatistics = { 0 };
+
+#if ( OTA_FAST_RETRANSMIT_ENABLE == 1 ) && ( MQTT_DISPATCHER_ENABLE == 1 )
+/* Stream topic of the current job. Set by the OTA agent task with every
+ * stream request and copied by the dispatcher task to ask for missing
+ * blocks, both inside a critical section. */
+static char streamRequestTopic[ OTA_STREAM_REQUEST_TOPIC_SIZE ];
+static uint16_t streamRequestTopicLength = 0U;
+#endif
 
 /* Enum for type of OTA job messages received. */
 typedef enum jobMessageType
@@ -194,15 +404,18 @@ uint8_t certFilePath[ OTA_MAX_FILE_PATH_SIZE ];
 /* Stream name buffer. */
 uint8_t streamName[ OTA_MAX_STREAM_NAME_SIZE ];
 
-/* Decode memory. */
-uint8_t decodeMem[ otaconfigFILE_BLOCK_SIZE ];
+/* Decode memory. With the block decoder the OTA agent decodes block headers
+ * with an empty payload only, the block data never passes through it. */
+#if ( OTA_BLOCK_DECODER_ENABLE == 1 )
+#define OTA_DECODE_MEMORY_SIZE      (16U)
+#else
+#define OTA_DECODE_MEMORY_SIZE      otaconfigFILE_BLOCK_SIZE
+#endif
+uint8_t decodeMem[ OTA_DECODE_MEMORY_SIZE ];
 
 /* Bitmap memory. */
 uint8_t bitmap[ OTA_MAX_BLOCK_BITMAP_SIZE ];
 
-/* Event buffer. */
-OtaEventData_t eventBuffer[ otaconfigMAX_NUM_OTA_DATA_BUFFERS ];
-
 /* The buffer passed to the OTA Agent from application while initializing. */
 OtaAppBuffer_t otaBuffer =
 {
@@ -213,7 +426,7 @@ OtaAppBuffer_t otaBuffer =
         .pStreamName        = streamName,
         .streamNameSize     = OTA_MAX_STREAM_NAME_SIZE,
         .pDecodeMemory      = decodeMem,
-        .decodeMemorySize   = otaconfigFILE_BLOCK_SIZE,
+        .decodeMemorySize   = OTA_DECODE_MEMORY_SIZE,
         .pFileBitmap        = bitmap,
         .fileBitmapSize     = OTA_MAX_BLOCK_BITMAP_SIZE
 };
@@ -226,7 +439,18 @@ cy_mqtt_t               mqtthandle;
 cy_rslt_t connect_to_wifi_ap(void);
 cy_rslt_t startOTADemo(void);
 void otaAppCallback(OtaJobEvent_t event, const void * pData );
+void printJobStatistics(void);
+void resetJobStatistics(void);
+void countDataPath(uint32_t * pCounter, uint32_t value);
+OtaPalStatus_t otaPalCreateFile(OtaFileContext_t * const pFileContext);
+void publishTelemetry(bool final);
+void telemetryTimerCallback(TimerHandle_t timer);
+void otaMemPoolFailureHook(size_t size);
 void setOtaInterfaces(OtaInterfaces_t * pOtaInterfaces );
+int16_t otaPalWriteBlock(OtaFileContext_t * const pFileContext,
+        uint32_t offset,
+        uint8_t * const pData,
+        uint32_t blockSize);
 OtaMqttStatus_t mqttSubscribe(const char * pTopicFilter,
         uint16_t topicFilterLength,
         uint8_t qos);
@@ -238,6 +462,11 @@ OtaMqttStatus_t mqttPublish(const char * const pacTopic,
 OtaMqttStatus_t mqttUnsubscribe(const char * pTopicFilter,
         uint16_t topicFilterLength,
         uint8_t qos);
+void publishStreamLanes(const char * const pacTopic,
+        uint16_t topicLen,
+        uint32_t lanes,
+        uint8_t qos);
+void publishRetransmitRequest(void);
 void otaEventBufferFree(OtaEventData_t * const pxBuffer);
 void registerSubscriptionManagerCallback(const char * pTopicFilter,
         uint16_t topicFilterLength);
@@ -247,7 +476,17 @@ SubscriptionManagerCallback_t otaMessageCallback[] = {mqttJobCallback, mqttDataC
 jobMessageType_t getJobMessageType(const char * pTopicName,
         uint16_t topicNameLength);
 OtaEventData_t * otaEventBufferGet(void);
+bool otaEventBufferLoan(const cy_mqtt_received_msg_info_t * pPublishInfo,
+        OtaEvent_t eventId);
+bool stageDataBlock(const cy_mqtt_received_msg_info_t * pPublishInfo);
+void recoverDroppedBlocks(void);
 void otaThread(void * pParam);
+bool findCompanionTopic(const char * pTopicFilter,
+        uint16_t topicFilterLength,
+        uint8_t * pIndex);
+OtaOsStatus_t otaEventReceive(OtaEventContext_t * pEventCtx,
+        void * pEventMsg,
+        uint32_t timeout);
 void create_mqtt_handle(void);
 cy_rslt_t establishConnection(void);
 void disconnect(void);
@@ -271,13 +510,18 @@ void ota_mqtt_app_task( void *arg )
 {
     cy_rslt_t result = CY_RSLT_SUCCESS;
 
-    /* Semaphore initialization flag. */
-    bool bufferSemInitialized = false;
-    bool mqttDisconSemInitialized = false;
+    /* Event group initialization flag. */
+    bool otaDemoEventGroupInitialized = false;
 
     /* Maximum time in milliseconds to wait before exiting demo . */
     int16_t waitTimeoutMs = OTA_DEMO_EXIT_TIMEOUT_MS;
 
+    /* Start the deferred log pipeline before the data path. */
+    if( OtaLog_Init() == false )
+    {
+        printf("Failed to start the deferred log pipeline, logging synchronously. \n");
+    }
+
     result = cy_awsport_ota_flash_init();
     if(result == CY_RSLT_SUCCESS)
     {
@@ -289,40 +533,60 @@ void ota_mqtt_app_task( void *arg )
         goto app_exit;
     }
 
-    /* Connect to Wi-Fi AP */
-    result = connect_to_wifi_ap();
-    if( result != CY_RSLT_SUCCESS)
+    /* Start the write-behind flash writer. */
+    if( OtaFlashWriter_Init() == false )
     {
-        printf("\n Failed to connect to Wi-FI AP. \n");
-        CY_ASSERT(0);
+        printf("Failed to start the OTA flash writer. \n");
+        result = !CY_RSLT_SUCCESS;
+        goto app_exit;
     }
 
-    /* Initialize semaphore for buffer operations. */
-    bufferSemaphore = xSemaphoreCreateCounting(1, 1);
-    if(bufferSemaphore == NULL)
+#if ( MQTT_DISPATCHER_ENABLE == 1 )
+    /* Run the subscription callbacks off the MQTT receive thread. */
+    if( MqttDispatcher_Init( SubscriptionManager_DispatchHandler ) == false )
     {
-        printf("Failed to initialize buffer semaphore. \n");
+        printf("Failed to start the MQTT dispatcher. \n");
         result = !CY_RSLT_SUCCESS;
         goto app_exit;
     }
-    else
+#endif
+
+    /* Connect to Wi-Fi AP */
+    result = connect_to_wifi_ap();
+    if( result != CY_RSLT_SUCCESS)
     {
-        printf("Initialized buffer semaphore. \n");
-        bufferSemInitialized = true;
+        printf("\n Failed to connect to Wi-FI AP. \n");
+        CY_ASSERT(0);
     }
 
-    /* Initialize semaphore for buffer operations. */
-    mqtt_discon_Semaphore = xSemaphoreCreateCounting(1, 0);
-    if(mqtt_discon_Semaphore == NULL)
+    /* Initialize the lock-free pool of OTA event buffers. */
+    OtaBufferPool_Init();
+    printf("Initialized OTA event buffer pool. \n");
+
+    /* Initialize the memory pool serving the OTA agent allocations. */
+    OtaMemPool_Init(otaMemPoolFailureHook);
+
+    /* Start the block timing of the telemetry. */
+    OtaTelemetry_Init();
+
+    /* Seed the reconnect jitter per device so that a fleet does not reconnect
+     * in lockstep. */
+    RetryBackoff_Init(&reconnectBackoff, OTA_MQTT_RECONNECT_BASE_DELAY_MS,
+            OTA_MQTT_RECONNECT_MAX_DELAY_MS,
+            RetryBackoff_SeedFromString(CLIENT_IDENTIFIER, ( uint32_t ) xTaskGetTickCount()));
+
+    /* Initialize the event group driving the supervisor loop. */
+    otaDemoEventGroup = xEventGroupCreate();
+    if(otaDemoEventGroup == NULL)
     {
-        printf("Failed to initialize mqtt disconnect notification semaphore. \n");
+        printf("Failed to initialize OTA demo event group. \n");
         result = !CY_RSLT_SUCCESS;
         goto app_exit;
     }
     else
     {
-        printf("Initialized mqtt disconnect notification semaphore. \n");
-        mqttDisconSemInitialized = true;
+        printf("Initialized OTA demo event group. \n");
+        otaDemoEventGroupInitialized = true;
     }
 
     if(result == CY_RSLT_SUCCESS)
@@ -361,18 +625,11 @@ void ota_mqtt_app_task( void *arg )
         mqtthandle = NULL;
     }
 
-    if(bufferSemInitialized == true)
-    {
-        /* Cleanup semaphore created for buffer operations. */
-        vSemaphoreDelete( bufferSemaphore );
-        printf("Destroyed buffer semaphore. \n");
-    }
-
-    if(mqttDisconSemInitialized == true)
+    if(otaDemoEventGroupInitialized == true)
     {
-        /* Cleanup semaphore created for mqtt disconnect notification. */
-        vSemaphoreDelete( mqtt_discon_Semaphore );
-        printf("Destroyed mqtt disconnect notification semaphore. \n");
+        /* Cleanup event group created for the supervisor loop. */
+        vEventGroupDelete( otaDemoEventGroup );
+        printf("Destroyed OTA demo event group. \n");
     }
 
     /* Wait and log message before exiting demo. */
@@ -400,7 +657,10 @@ void ota_mqtt_app_task( void *arg )
  *******************************************************************************
  * Summary:
  *  Connects to Wi-Fi AP using the user-configured credentials, retries up to a
- *  configured number of times until the connection succeeds.
+ *  configured number of times until the connection succeeds. The access point
+ *  joined on the last boot is tried first by its BSSID and band, so that the
+ *  join does not scan all channels; a full scan for the SSID follows if it
+ *  fails. Failed attempts back off exponentially with jitter.
  *
  * Return:
  *  CY_RSLT_SUCCESS: if a connection is established, other error code in case of
@@ -413,6 +673,14 @@ cy_rslt_t connect_to_wifi_ap(void)
     cy_wcm_connect_params_t wifi_conn_param;
     cy_wcm_ip_address_t ip_address;
     cy_rslt_t result;
+    RetryBackoff_t backoff;
+    TickType_t joinStart;
+    uint32_t delayMs;
+#if ( WIFI_AP_CACHE_ENABLE == 1 )
+    cy_wcm_associated_ap_info_t ap_info;
+    WifiApCacheEntry_t cachedAp;
+    bool useCachedAp = false;
+#endif
 
     /* Variable to track the number of connection retries to the Wi-Fi AP specified
      * by WIFI_SSID macro. */
@@ -427,21 +695,77 @@ cy_rslt_t connect_to_wifi_ap(void)
     memcpy(wifi_conn_param.ap_credentials.password, WIFI_PASSWORD, sizeof(WIFI_PASSWORD));
     wifi_conn_param.ap_credentials.security = WIFI_SECURITY;
 
+#if ( WIFI_AP_CACHE_ENABLE == 1 )
+    /* Join the access point of the last boot directly. The connection
+     * parameters take no channel, the band of the cached channel narrows
+     * the search instead. */
+    if( ( WifiApCache_Init() == true ) && ( WifiApCache_Load( WIFI_SSID, &cachedAp ) == true ) )
+    {
+        memcpy( wifi_conn_param.BSSID, cachedAp.bssid, sizeof( wifi_conn_param.BSSID ) );
+        wifi_conn_param.band = ( cy_wcm_wifi_band_t ) cachedAp.band;
+        useCachedAp = true;
+    }
+#endif
+
+    RetryBackoff_Init( &backoff, WIFI_CONN_RETRY_DELAY_MS, WIFI_CONN_RETRY_MAX_DELAY_MS,
+            RetryBackoff_SeedFromString( CLIENT_IDENTIFIER, ( uint32_t ) xTaskGetTickCount() ) );
+
     /* Connect to the Wi-Fi AP */
     for(conn_retries = 0; conn_retries < MAX_CONNECTION_RETRIES; conn_retries++)
     {
+        wifiConnectionStatistics.attempts++;
+        joinStart = xTaskGetTickCount();
         result = cy_wcm_connect_ap( &wifi_conn_param, &ip_address );
+        wifiConnectionStatistics.lastJoinMs = ( uint32_t ) ( xTaskGetTickCount() - joinStart ) * portTICK_PERIOD_MS;
 
         if (result == CY_RSLT_SUCCESS)
         {
-            printf( "Successfully connected to Wi-Fi network '%s'.\n",
-                    wifi_conn_param.ap_credentials.SSID);
+            wifiConnectionStatistics.timeToIpMs = ( uint32_t ) xTaskGetTickCount() * portTICK_PERIOD_MS;
+            printf( "Successfully connected to Wi-Fi network '%s' in %u ms, %u ms after boot.\n",
+                    wifi_conn_param.ap_credentials.SSID,
+                    (unsigned int)wifiConnectionStatistics.lastJoinMs,
+                    (unsigned int)wifiConnectionStatistics.timeToIpMs);
+
+#if ( WIFI_AP_CACHE_ENABLE == 1 )
+            if( useCachedAp == true )
+            {
+                wifiConnectionStatistics.cachedApJoins++;
+            }
+
+            /* Remember the access point for the next boot. */
+            if( cy_wcm_get_associated_ap_info( &ap_info ) == CY_RSLT_SUCCESS )
+            {
+                memset( &cachedAp, 0x00, sizeof( cachedAp ) );
+                strncpy( cachedAp.ssid, WIFI_SSID, WIFI_AP_CACHE_MAX_SSID_LENGTH );
+                memcpy( cachedAp.bssid, ap_info.BSSID, sizeof( cachedAp.bssid ) );
+                cachedAp.channel = ap_info.channel;
+                cachedAp.band = ( uint8_t ) ( ( ap_info.channel > 14U ) ?
+                        CY_WCM_WIFI_BAND_5GHZ : CY_WCM_WIFI_BAND_2_4GHZ );
+                ( void ) WifiApCache_Save( &cachedAp );
+            }
+#endif
             return result;
         }
 
+#if ( WIFI_AP_CACHE_ENABLE == 1 )
+        if( useCachedAp == true )
+        {
+            /* The access point may have moved to another channel or be gone,
+             * scan for the SSID right away. */
+            printf( "Cached Wi-Fi AP not joined with error code %d. Scanning for '%s'...\n",
+                    (int) result, WIFI_SSID );
+            memset( wifi_conn_param.BSSID, 0x00, sizeof( wifi_conn_param.BSSID ) );
+            wifi_conn_param.band = CY_WCM_WIFI_BAND_ANY;
+            useCachedAp = false;
+            wifiConnectionStatistics.cachedApMisses++;
+            continue;
+        }
+#endif
+
+        delayMs = RetryBackoff_NextDelayMs( &backoff );
         printf( "Connection to Wi-Fi network failed with error code %d."
-                "Retrying in %d ms...\n", (int) result, WIFI_CONN_RETRY_DELAY_MS );
-        vTaskDelay(pdMS_TO_TICKS(WIFI_CONN_RETRY_DELAY_MS));
+                "Retrying in %u ms...\n", (int) result, (unsigned int) delayMs );
+        vTaskDelay(pdMS_TO_TICKS(delayMs));
     }
 
     printf( "Exceeded maximum Wi-Fi connection attempts\n" );
@@ -478,17 +802,26 @@ cy_rslt_t startOTADemo( void )
     /* OTA event message used for sending event to OTA Agent.*/
     OtaEventMsg_t eventMsg = { 0 };
 
-    /* OTA library packet statistics per job.*/
-    OtaAgentStatistics_t otaStatistics = { 0 };
-
     /* OTA Agent thread handle.*/
     TaskHandle_t threadHandle = NULL;
 
     /* OTA interface context required for library interface functions.*/
     OtaInterfaces_t otaInterfaces;
 
-    /* Maximum time to wait for the OTA agent to get suspended. */
-    int16_t suspendTimeout;
+    /* Time the OTA agent was asked to suspend. */
+    TickType_t suspendStart;
+
+    /* Time waited so far for the OTA agent to suspend. */
+    TickType_t suspendElapsed;
+
+    /* Events received by the supervisor loop. */
+    EventBits_t events;
+
+    /* Delay before the next connection attempt. */
+    uint32_t reconnectDelayMs;
+
+    /* Timer pacing the telemetry publishes. */
+    TimerHandle_t telemetryTimer = NULL;
 
     /* Set OTA Library interfaces.*/
     setOtaInterfaces(&otaInterfaces);
@@ -497,6 +830,8 @@ cy_rslt_t startOTADemo( void )
     printf("Major version : %u \n\r", (appFirmwareVersion.u.x.major));
     printf("Minor version : %u \n\r", (appFirmwareVersion.u.x.minor));
     printf("Build version : %u \n\n\r", (appFirmwareVersion.u.x.build));
+    printf("OTA file block size : %u bytes, %u event buffers \n\n\r",
+            (unsigned int)otaconfigFILE_BLOCK_SIZE, (unsigned int)otaconfigMAX_NUM_OTA_DATA_BUFFERS);
 
     /* Init OTA Library. */
     if(result == CY_RSLT_SUCCESS)
@@ -525,77 +860,132 @@ cy_rslt_t startOTADemo( void )
         }
     }
 
+    /* Start the telemetry timer. */
+    if( ( result == CY_RSLT_SUCCESS ) && ( OTA_TELEMETRY_INTERVAL_MS != 0U ) )
+    {
+        telemetryTimer = xTimerCreate("otaTelemetry", pdMS_TO_TICKS(OTA_TELEMETRY_INTERVAL_MS),
+                pdTRUE, NULL, telemetryTimerCallback);
+        if( ( telemetryTimer == NULL ) || ( xTimerStart(telemetryTimer, 0) != pdPASS ) )
+        {
+            printf("Failed to start the OTA telemetry timer, only publishing job summaries.\n");
+        }
+    }
+
     /* OTA Demo loop */
     if( result == CY_RSLT_SUCCESS )
     {
         printf("Calling create_mqtt_handle..\n");
         create_mqtt_handle();
 
-        /* Wait till OTA library is stopped, output statistics for currently running
-         * OTA job */
+        /* React to connection and agent events until the OTA library is stopped. */
         while(( ( state = OTA_GetState() ) != OtaAgentStateStopped ))
         {
             if( mqttSessionEstablished != true )
             {
-                /* Connect to MQTT broker and create MQTT connection. */
-                printf("Calling establishConnection..\n");
-                result = establishConnection();
-                if(result == CY_RSLT_SUCCESS)
+                if( otaConnectionStatistics.connectAttempts > 0U )
                 {
-                    /* Check if OTA process was suspended and resume if required. */
-                    if( state == OtaAgentStateSuspended )
-                    {
-                        /* Resume OTA operations. */
-                        OTA_Resume();
-                    }
-                    else
+                    /* Back off with jitter before reconnecting, unless the agent
+                     * stops meanwhile. */
+                    reconnectDelayMs = RetryBackoff_NextDelayMs(&reconnectBackoff);
+                    printf("Reconnecting in %u ms..\n", (unsigned int)reconnectDelayMs);
+                    if( ( xEventGroupWaitBits(otaDemoEventGroup, OTA_DEMO_EVENT_SHUTDOWN,
+                            pdFALSE, pdFALSE, pdMS_TO_TICKS(reconnectDelayMs)) &
+                            OTA_DEMO_EVENT_SHUTDOWN ) != 0U )
                     {
-                        /* Send start event to OTA Agent.*/
-                        eventMsg.eventId = OtaAgentEventStart;
-                        OTA_SignalEvent( &eventMsg );
+                        break;
                     }
                 }
+
+                /* Connect to MQTT broker and create MQTT connection. */
+                printf("Calling establishConnection..\n");
+                if( establishConnection() != CY_RSLT_SUCCESS )
+                {
+                    continue;
+                }
+            }
+
+            events = xEventGroupWaitBits(otaDemoEventGroup, OTA_DEMO_EVENT_ALL,
+                    pdTRUE, pdFALSE, portMAX_DELAY);
+
+            if( ( events & OTA_DEMO_EVENT_SHUTDOWN ) != 0U )
+            {
+                break;
+            }
+
+            if( ( events & OTA_DEMO_EVENT_CONNECT_COMPLETE ) != 0U )
+            {
+                /* Check if OTA process was suspended and resume if required. */
+                if( OTA_GetState() == OtaAgentStateSuspended )
+                {
+                    /* Resume OTA operations. */
+                    OTA_Resume();
+                }
+                else
+                {
+                    /* Send start event to OTA Agent.*/
+                    eventMsg.eventId = OtaAgentEventStart;
+                    OTA_SignalEvent( &eventMsg );
+                }
             }
 
-            if( mqttSessionEstablished == true )
+            if( ( events & OTA_DEMO_EVENT_DISCONNECT ) != 0U )
             {
-                if( pdTRUE == xSemaphoreTake(mqtt_discon_Semaphore, pdMS_TO_TICKS(500)))
+                printf("Received MQTT disconnect notification...\n");
+                mqttDisconnectTick = xTaskGetTickCount();
+                mqttReconnecting = true;
+                /* Disconnect from broker and close connection. */
+                disconnect();
+                /* Suspend OTA operations. */
+                otaRet = OTA_Suspend();
+                if( otaRet == OtaErrNone )
                 {
-                    printf("Received MQTT disconnect notification...\n");
-                    /* Disconnect from broker and close connection. */
-                    disconnect();
-                    /* Suspend OTA operations. */
-                    otaRet = OTA_Suspend();
-                    if( otaRet == OtaErrNone )
+                    /* Wait for the agent to report the suspended state. */
+                    suspendStart = xTaskGetTickCount();
+                    while( OTA_GetState() != OtaAgentStateSuspended )
                     {
-                        suspendTimeout = OTA_SUSPEND_TIMEOUT_MS;
-                        while( ( ( state = OTA_GetState() ) != OtaAgentStateSuspended ) && ( suspendTimeout > 0 ) )
+                        /* Read the tick count once, so the time left cannot
+                         * wrap between the check and the wait. */
+                        suspendElapsed = xTaskGetTickCount() - suspendStart;
+                        if( suspendElapsed >= pdMS_TO_TICKS(OTA_SUSPEND_TIMEOUT_MS) )
                         {
-                            /* Wait for OTA Library state to suspend */
-                            vTaskDelay(pdMS_TO_TICKS(OTA_EXAMPLE_TASK_DELAY_MS));
-                            suspendTimeout -= OTA_EXAMPLE_TASK_DELAY_MS;
+                            break;
                         }
-                    }
-                    else
-                    {
-                        printf("OTA failed to suspend. StatusCode=%d.\n", otaRet);
+
+                        (void) xEventGroupWaitBits(otaDemoEventGroup, OTA_DEMO_EVENT_AGENT_STATE_CHANGE,
+                                pdTRUE, pdFALSE,
+                                pdMS_TO_TICKS(OTA_SUSPEND_TIMEOUT_MS) - suspendElapsed);
                     }
                 }
                 else
                 {
-                    /* Get OTA statistics for currently executing job. */
-                    OTA_GetStatistics( &otaStatistics );
+                    printf("OTA failed to suspend. StatusCode=%d.\n", otaRet);
+                }
+            }
 
-                    /* Delay if mqtt process loop is set to zero.*/
-                    if( MQTT_PROCESS_LOOP_TIMEOUT_MS > 0 )
-                    {
-                        vTaskDelay(pdMS_TO_TICKS(1000));
-                    }
+            /* An agent state change only needs the loop condition to be
+             * evaluated again. */
+
+            if( ( events & OTA_DEMO_EVENT_TELEMETRY ) != 0U )
+            {
+                /* Only report while a file is being downloaded. */
+                state = OTA_GetState();
+                if( ( mqttSessionEstablished == true ) &&
+                        ( ( state == OtaAgentStateCreatingFile ) ||
+                          ( state == OtaAgentStateRequestingFileBlock ) ||
+                          ( state == OtaAgentStateWaitingForFileBlock ) ||
+                          ( state == OtaAgentStateClosingFile ) ) )
+                {
+                    publishTelemetry(false);
                 }
             }
         }
     }
 
+    if( telemetryTimer != NULL )
+    {
+        (void) xTimerDelete(telemetryTimer, 0);
+    }
+
     /* Wait for OTA Thread. */
     if( threadHandle != NULL )
     {
@@ -639,6 +1029,8 @@ void otaAppCallback( OtaJobEvent_t event, const void *pData )
     {
     case OtaJobEventActivate:
         printf("Received OtaJobEventActivate callback from OTA Agent.\n");
+        printJobStatistics();
+
         /* Activate the new firmware image. */
         OTA_ActivateNewImage();
 
@@ -654,6 +1046,8 @@ void otaAppCallback( OtaJobEvent_t event, const void *pData )
 
     case OtaJobEventFail:
         printf("Received OtaJobEventFail callback from OTA Agent.\n");
+        printJobStatistics();
+
         /* Nothing special to do. The OTA agent handles it. */
         break;
 
@@ -677,10 +1071,12 @@ void otaAppCallback( OtaJobEvent_t event, const void *pData )
         break;
 
     case OtaJobEventProcessed:
-        printf("Received OtaJobEventProcessed callback from OTA Agent.\n");
+        OTA_LOG_DEBUG(OTA_LOG_MODULE_APP, "Received OtaJobEventProcessed callback from OTA Agent.\n");
         if(pData != NULL)
         {
+            OtaTelemetry_RecordBlockProcessed(( const OtaEventData_t * ) pData);
             otaEventBufferFree(( OtaEventData_t * ) pData);
+            recoverDroppedBlocks();
         }
 
         if(nw_ota_fs_ctx == NULL)
@@ -690,9 +1086,8 @@ void otaAppCallback( OtaJobEvent_t event, const void *pData )
 
         if(nw_ota_fs_ctx != NULL)
         {
-            printf("\n\n==================================================================");
-            printf("\nBlocks Remaining=%u", (unsigned int)nw_ota_fs_ctx->blocksRemaining);
-            printf("\n==================================================================\n");
+            OTA_LOG_INFO(OTA_LOG_MODULE_APP, "Blocks Remaining=%u\n",
+                    (unsigned int)nw_ota_fs_ctx->blocksRemaining);
         }
 
         break;
@@ -715,114 +1110,676 @@ void otaAppCallback( OtaJobEvent_t event, const void *pData )
 }
 
 /*******************************************************************************
- * Function Name: setOtaInterfaces()
+ * Function Name: printJobStatistics()
  *******************************************************************************
  * Summary:
- *  Set OTA interfaces.
+ *  Prints the throughput of the job, the usage statistics of the OTA event
+ *  buffer pool and the payload handoff statistics, publishes the telemetry
+ *  summary of the job. The per-job counters are cleared when the file of the
+ *  next job is created, see resetJobStatistics().
  *
  * Parameters:
- *  pOtaInterfaces: pointer to OTA interface structure.
+ *  void
  *
  * Return:
  *  void
  *
  *******************************************************************************/
-void setOtaInterfaces( OtaInterfaces_t * pOtaInterfaces )
+void printJobStatistics( void )
 {
-    /* Initialize OTA library OS Interface. */
-    pOtaInterfaces->os.event.init = cy_awsport_ota_event_init;
-    pOtaInterfaces->os.event.send = cy_awsport_ota_event_send;
-    pOtaInterfaces->os.event.recv = cy_awsport_ota_event_receive;
-    pOtaInterfaces->os.event.deinit = cy_awsport_ota_event_deinit;
-    pOtaInterfaces->os.timer.start = cy_awsport_ota_timer_create_start;
-    pOtaInterfaces->os.timer.stop = cy_awsport_ota_timer_stop;
-    pOtaInterfaces->os.timer.delete = cy_awsport_ota_timer_delete;
-    pOtaInterfaces->os.mem.malloc = cy_awsport_ota_malloc;
-    pOtaInterfaces->os.mem.free = cy_awsport_ota_free;
+    OtaBufferPoolStatistics_t poolStatistics = { 0 };
+    OtaLogStatistics_t logStatistics = { 0 };
+    OtaFlowControlStatistics_t flowStatistics = { 0 };
+    OtaStreamLanesStatistics_t laneStatistics = { 0 };
+    OtaBlockRecoveryStatistics_t recoveryStatistics = { 0 };
+#if ( OTA_FAST_RETRANSMIT_ENABLE == 1 ) && ( MQTT_DISPATCHER_ENABLE == 1 )
+    OtaFastRetransmitStatistics_t retransmitStatistics = { 0 };
+#endif
+    OtaFlashWriterStatistics_t writerStatistics = { 0 };
+    OtaMemPoolStatistics_t memStatistics = { 0 };
+    OtaDeltaStatistics_t deltaStatistics = { 0 };
+    OtaDecompressStatistics_t decompressStatistics = { 0 };
+#if ( OTA_IMAGE_HASH_ENABLE == 1 )
+    OtaImageHashStatistics_t hashStatistics = { 0 };
+#endif
+#if ( MQTT_DISPATCHER_ENABLE == 1 )
+    MqttDispatcherStatistics_t dispatcherStatistics = { 0 };
+#endif
+    OtaTelemetryThroughput_t throughput = { 0 };
+    otaDataPathStatistics_t dataPathStatistics;
+    uint32_t dispatcherBytesCopied = 0U;
+    uint32_t classIndex;
+
+    OtaTelemetry_GetThroughput( &throughput );
+    OtaFlashWriter_GetStatistics( &writerStatistics );
+#if ( MQTT_DISPATCHER_ENABLE == 1 )
+    MqttDispatcher_GetStatistics( &dispatcherStatistics );
+    dispatcherBytesCopied = dispatcherStatistics.bytesCopied;
+#endif
 
-    /* Initialize the OTA library MQTT Interface.*/
-    pOtaInterfaces->mqtt.subscribe = mqttSubscribe;
-    pOtaInterfaces->mqtt.publish = mqttPublish;
-    pOtaInterfaces->mqtt.unsubscribe = mqttUnsubscribe;
+    taskENTER_CRITICAL();
+    dataPathStatistics = otaDataPathStatistics;
+    taskEXIT_CRITICAL();
+
+    printf("OTA throughput: blocks received=%u, bytes=%u, download time=%u ms, blocks/s=%u.\n",
+            (unsigned int)throughput.blocksReceived,
+            (unsigned int)throughput.bytesReceived,
+            (unsigned int)throughput.downloadTimeMs,
+            (unsigned int)throughput.blocksPerSecond);
+    printf("OTA recovery from disconnect to resumed block flow: recoveries=%u, "
+            "last=%u ms, max=%u ms.\n",
+            (unsigned int)throughput.recoveries,
+            (unsigned int)throughput.lastRecoveryMs,
+            (unsigned int)throughput.maxRecoveryMs);
+
+    /* Before the payload loans every received payload was copied once into an
+     * event buffer, and the PAL programmed the block from there. */
+    printf("OTA payload copies: bytes received=%u, copied before=%u, copied now=%u "
+            "(dispatcher=%u, event buffers=%u, flash writer slots=%u).\n",
+            (unsigned int)dataPathStatistics.bytesReceived,
+            (unsigned int)dataPathStatistics.bytesReceived,
+            (unsigned int)( dispatcherBytesCopied + dataPathStatistics.bytesCopied + writerStatistics.bytesQueued ),
+            (unsigned int)dispatcherBytesCopied,
+            (unsigned int)dataPathStatistics.bytesCopied,
+            (unsigned int)writerStatistics.bytesQueued);
+
+    OtaBufferPool_GetStatistics( &poolStatistics );
+
+    printf("OTA buffer pool: capacity=%u, in use=%u, high-water mark=%u, "
+            "allocations=%u, allocation failures=%u.\n",
+            (unsigned int)poolStatistics.capacity,
+            (unsigned int)poolStatistics.inUse,
+            (unsigned int)poolStatistics.highWaterMark,
+            (unsigned int)poolStatistics.allocations,
+            (unsigned int)poolStatistics.allocationFailures);
+
+    printf("OTA data path: bytes copied=%u, buffers loaned=%u, loans reclaimed=%u, "
+            "payloads dropped=%u, blocks staged=%u, blocks rejected=%u.\n",
+            (unsigned int)dataPathStatistics.bytesCopied,
+            (unsigned int)dataPathStatistics.buffersLoaned,
+            (unsigned int)dataPathStatistics.loansReclaimed,
+            (unsigned int)dataPathStatistics.payloadsDropped,
+            (unsigned int)dataPathStatistics.blocksStaged,
+            (unsigned int)dataPathStatistics.blocksRejected);
+
+    OtaLog_GetStatistics( &logStatistics );
+
+    printf("OTA log pipeline: records written=%u, records dropped=%u, "
+            "queue high-water mark=%u, unused log task stack=%u bytes.\n",
+            (unsigned int)logStatistics.recordsWritten,
+            (unsigned int)logStatistics.recordsDropped,
+            (unsigned int)logStatistics.queueHighWaterMark,
+            (unsigned int)logStatistics.stackUnusedBytes);
+
+    OtaFlowControl_GetStatistics( &flowStatistics );
+
+    printf("OTA flow control: window=%u, ssthresh=%u, srtt=%u ms, rttvar=%u ms, "
+            "request wait=%u ms, requests=%u, timeouts=%u, drops=%u, "
+            "increases=%u, decreases=%u.\n",
+            (unsigned int)flowStatistics.window,
+            (unsigned int)flowStatistics.slowStartThreshold,
+            (unsigned int)flowStatistics.smoothedRttMs,
+            (unsigned int)flowStatistics.rttVariationMs,
+            (unsigned int)flowStatistics.requestWaitMs,
+            (unsigned int)flowStatistics.requests,
+            (unsigned int)flowStatistics.timeouts,
+            (unsigned int)flowStatistics.drops,
+            (unsigned int)flowStatistics.windowIncreases,
+            (unsigned int)flowStatistics.windowDecreases);
+
+    OtaBlockRecovery_GetStatistics( &recoveryStatistics );
+
+    printf("OTA block recovery: blocks dropped=%u, blocks redelivered=%u, early requests=%u, "
+            "lane requests paused=%u, stall=%u ms.\n",
+            (unsigned int)recoveryStatistics.blocksDropped,
+            (unsigned int)recoveryStatistics.blocksRedelivered,
+            (unsigned int)recoveryStatistics.earlyRequests,
+            (unsigned int)recoveryStatistics.requestsPaused,
+            (unsigned int)recoveryStatistics.stallMs);
+
+    OtaStreamLanes_GetStatistics( &laneStatistics );
+
+    printf("OTA stream lanes: lanes=%u of %u, agent requests=%u, lane requests=%u, "
+            "increases=%u, decreases=%u, duplicate blocks=%u, re-requests=%u, skipped requests=%u, "
+            "last round=%u blocks/s.\n",
+            (unsigned int)laneStatistics.lanes,
+            (unsigned int)OTA_STREAM_LANES_MAX,
+            (unsigned int)laneStatistics.rounds,
+            (unsigned int)laneStatistics.laneRequests,
+            (unsigned int)laneStatistics.laneIncreases,
+            (unsigned int)laneStatistics.laneDecreases,
+            (unsigned int)laneStatistics.duplicateBlocks,
+            (unsigned int)laneStatistics.outstandingExpired,
+            (unsigned int)laneStatistics.requestsSkipped,
+            (unsigned int)laneStatistics.blocksPerSecond);
+
+#if ( OTA_FAST_RETRANSMIT_ENABLE == 1 ) && ( MQTT_DISPATCHER_ENABLE == 1 )
+    OtaFastRetransmit_GetStatistics( &retransmitStatistics );
+
+    printf("OTA fast retransmit: gaps detected=%u, gaps filled late=%u, requests=%u, "
+            "blocks requested=%u, blocks recovered=%u.\n",
+            (unsigned int)retransmitStatistics.gapsDetected,
+            (unsigned int)retransmitStatistics.gapsFilled,
+            (unsigned int)retransmitStatistics.requests,
+            (unsigned int)retransmitStatistics.blocksRequested,
+            (unsigned int)retransmitStatistics.blocksRecovered);
+#endif
 
-    /* Initialize the OTA library PAL Interface.*/
-    pOtaInterfaces->pal.getPlatformImageState = cy_awsport_ota_flash_get_platform_imagestate;
-    pOtaInterfaces->pal.setPlatformImageState = cy_awsport_ota_flash_set_platform_imagestate;
-    pOtaInterfaces->pal.writeBlock = cy_awsport_ota_flash_write_block;
-    pOtaInterfaces->pal.activate = cy_awsport_ota_flash_activate_newimage;
-    pOtaInterfaces->pal.closeFile = cy_awsport_ota_flash_close_receive_file;
-    pOtaInterfaces->pal.reset = cy_awsport_ota_flash_reset_device;
-    pOtaInterfaces->pal.abort = cy_awsport_ota_flash_abort;
-    pOtaInterfaces->pal.createFile = cy_awsport_ota_flash_create_receive_file;
+    printf("OTA flash writer: blocks queued=%u, blocks from network=%u, blocks durable=%u, "
+            "extents written=%u, bytes written=%u, slot wait=%u ms, write errors=%u, "
+            "blocks resumed=%u, bytes in order=%u, bytes read back=%u, close=%u ms.\n",
+            (unsigned int)writerStatistics.blocksQueued,
+            (unsigned int)writerStatistics.blocksFromNetwork,
+            (unsigned int)writerStatistics.blocksDurable,
+            (unsigned int)writerStatistics.extentsWritten,
+            (unsigned int)writerStatistics.bytesWritten,
+            (unsigned int)writerStatistics.agentStallMs,
+            (unsigned int)writerStatistics.writeErrors,
+            (unsigned int)writerStatistics.blocksResumed,
+            (unsigned int)writerStatistics.bytesInOrder,
+            (unsigned int)writerStatistics.bytesReadBack,
+            (unsigned int)writerStatistics.closeMs);
+
+#if ( OTA_IMAGE_HASH_ENABLE == 1 )
+    OtaImageHash_GetStatistics( &hashStatistics );
+
+    printf("OTA image digest: bytes hashed=%u, signature verification=%u ms.\n",
+            (unsigned int)hashStatistics.bytesHashed,
+            (unsigned int)hashStatistics.verifyMs);
+#endif
+
+    if( writerStatistics.compressedFile == true )
+    {
+        OtaDecompress_GetStatistics( &decompressStatistics );
+
+        printf("OTA decompression: compressed bytes=%u, output bytes=%u of %u, "
+                "ratio=%u%%, literals=%u, matches=%u.\n",
+                (unsigned int)decompressStatistics.compressedBytes,
+                (unsigned int)decompressStatistics.outputBytes,
+                (unsigned int)decompressStatistics.originalSize,
+                (unsigned int)( ( decompressStatistics.outputBytes != 0U ) ?
+                        ( ( ( uint64_t ) decompressStatistics.compressedBytes * 100U ) / decompressStatistics.outputBytes ) : 0U ),
+                (unsigned int)decompressStatistics.literals,
+                (unsigned int)decompressStatistics.matches);
+    }
+
+    if( writerStatistics.patchFile == true )
+    {
+        OtaDelta_GetStatistics( &deltaStatistics );
+
+        printf("OTA delta update: patch bytes=%u, image bytes=%u of %u, "
+                "running image bytes read=%u, records=%u.\n",
+                (unsigned int)deltaStatistics.patchBytes,
+                (unsigned int)deltaStatistics.imageBytes,
+                (unsigned int)deltaStatistics.imageSize,
+                (unsigned int)deltaStatistics.oldBytesRead,
+                (unsigned int)deltaStatistics.records);
+    }
+
+    OtaMemPool_GetStatistics( &memStatistics );
+
+    for( classIndex = 0U; classIndex < OTA_MEM_POOL_NUM_CLASSES; classIndex++ )
+    {
+        printf("OTA memory pool class %u B: blocks=%u, in use=%u, high-water mark=%u, "
+                "allocations=%u, spills=%u.\n",
+                (unsigned int)memStatistics.classes[ classIndex ].blockSize,
+                (unsigned int)memStatistics.classes[ classIndex ].blockCount,
+                (unsigned int)memStatistics.classes[ classIndex ].inUse,
+                (unsigned int)memStatistics.classes[ classIndex ].highWaterMark,
+                (unsigned int)memStatistics.classes[ classIndex ].allocations,
+                (unsigned int)memStatistics.classes[ classIndex ].spills);
+    }
+
+    printf("OTA memory pool: allocation failures=%u, invalid frees=%u.\n",
+            (unsigned int)memStatistics.allocationFailures,
+            (unsigned int)memStatistics.invalidFrees);
+
+    printf("Wi-Fi connection: time to IP=%u ms, last join=%u ms, attempts=%u, "
+            "cached AP joins=%u, cached AP misses=%u.\n",
+            (unsigned int)wifiConnectionStatistics.timeToIpMs,
+            (unsigned int)wifiConnectionStatistics.lastJoinMs,
+            (unsigned int)wifiConnectionStatistics.attempts,
+            (unsigned int)wifiConnectionStatistics.cachedApJoins,
+            (unsigned int)wifiConnectionStatistics.cachedApMisses);
+
+    printf("MQTT connection: attempts=%u, failures=%u, "
+            "last reconnect=%u ms, max reconnect=%u ms.\n",
+            (unsigned int)otaConnectionStatistics.connectAttempts,
+            (unsigned int)otaConnectionStatistics.connectFailures,
+            (unsigned int)otaConnectionStatistics.lastReconnectMs,
+            (unsigned int)otaConnectionStatistics.maxReconnectMs);
+
+    printf("MQTT subscriptions: SUBSCRIBE round trips=%u (%u ms), "
+            "UNSUBSCRIBE round trips=%u (%u ms), topics coalesced=%u.\n",
+            (unsigned int)otaConnectionStatistics.subscribeRoundTrips,
+            (unsigned int)otaConnectionStatistics.subscribeTimeMs,
+            (unsigned int)otaConnectionStatistics.unsubscribeRoundTrips,
+            (unsigned int)otaConnectionStatistics.unsubscribeTimeMs,
+            (unsigned int)otaConnectionStatistics.topicsCoalesced);
+
+#if ( MQTT_DISPATCHER_ENABLE == 1 )
+    printf("MQTT dispatcher: messages queued=%u, dispatched=%u, dropped=%u, oversized=%u, "
+            "bytes copied=%u, queue depth=%u, high-water mark=%u, max queue delay=%u ms, "
+            "overflow wait=%u ms.\n",
+            (unsigned int)dispatcherStatistics.messagesQueued,
+            (unsigned int)dispatcherStatistics.messagesDispatched,
+            (unsigned int)dispatcherStatistics.messagesDropped,
+            (unsigned int)dispatcherStatistics.messagesOversized,
+            (unsigned int)dispatcherStatistics.bytesCopied,
+            (unsigned int)dispatcherStatistics.queueDepth,
+            (unsigned int)dispatcherStatistics.queueHighWaterMark,
+            (unsigned int)dispatcherStatistics.maxQueueDelayMs,
+            (unsigned int)dispatcherStatistics.overflowWaitMs);
+#endif
+
+    if( mqttSessionEstablished == true )
+    {
+        publishTelemetry(true);
+    }
 }
 
 /*******************************************************************************
- * Function Name: mqttSubscribe()
+ * Function Name: resetJobStatistics()
  *******************************************************************************
  * Summary:
- *  Subscribe to the MQTT topic filter, and registers the handler for the topic
- *  filter with the subscription manager.This function subscribes to the Mqtt
- *  topics with the Quality of service received as parameter. This function also
- *  registers a callback for the topicfilter.
+ *  Clears the per-job state and counters when the file of a job is created,
+ *  before the first block is requested. Every module clears its own state
+ *  inside its critical section, as blocks of an earlier job may still be
+ *  handled by the dispatcher task.
  *
  * Parameters:
- *  pTopicFilter:       Mqtt topic filter.
- *  topicFilterLength:  Length of the topic filter.
- *  qos:                Quality of Service
+ *  void
  *
  * Return:
- *  OtaMqttSuccess: if success, other error code on failure.
+ *  void
  *
  *******************************************************************************/
-OtaMqttStatus_t mqttSubscribe( const char *pTopicFilter,
-        uint16_t topicFilterLength,
-        uint8_t qos )
+void resetJobStatistics( void )
 {
-    cy_rslt_t result = CY_RSLT_SUCCESS;
-    OtaMqttStatus_t otaRet = OtaMqttSuccess;
-    cy_mqtt_subscribe_info_t sub_msg[1];
+    taskENTER_CRITICAL();
+    memset( &otaDataPathStatistics, 0x00, sizeof( otaDataPathStatistics ) );
+    taskEXIT_CRITICAL();
+
+    OtaFlowControl_Reset();
+    OtaStreamLanes_Reset();
+    OtaBlockRecovery_Reset();
+#if ( OTA_FAST_RETRANSMIT_ENABLE == 1 ) && ( MQTT_DISPATCHER_ENABLE == 1 )
+    OtaFastRetransmit_Reset();
+#endif
+    OtaTelemetry_Reset();
+#if ( MQTT_DISPATCHER_ENABLE == 1 )
+    MqttDispatcher_ResetStatistics();
+#endif
+}
 
-    if((pTopicFilter == NULL ) || (topicFilterLength == 0))
-    {
-        printf("Invalid parameters to MQTT subscribe. \n");
-        return OtaMqttSubscribeFailed;
-    }
+/*******************************************************************************
+ * Function Name: countDataPath()
+ *******************************************************************************
+ * Summary:
+ *  Adds to a payload handoff counter inside a critical section.
+ *
+ * Parameters:
+ *  pCounter:   Counter of otaDataPathStatistics.
+ *  value:      Value to add.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void countDataPath( uint32_t * pCounter,
+        uint32_t value )
+{
+    taskENTER_CRITICAL();
+    *pCounter += value;
+    taskEXIT_CRITICAL();
+}
 
-    memset( &sub_msg, 0x00, sizeof( cy_mqtt_subscribe_info_t ));
-    sub_msg[0].qos = (cy_mqtt_qos_t)qos;
-    sub_msg[0].topic = pTopicFilter;
-    sub_msg[0].topic_len = topicFilterLength;
+/*******************************************************************************
+ * Function Name: publishTelemetry()
+ *******************************************************************************
+ * Summary:
+ *  Publishes the performance telemetry of the current job with QoS 0. A lost
+ *  document is superseded by the next one, so it is not worth an
+ *  acknowledgement on the busy connection.
+ *
+ * Parameters:
+ *  final: true for the summary sent at the end of the job.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void publishTelemetry( bool final )
+{
+    /* Called from both the supervisor loop and the OTA agent task. */
+    char telemetryDocument[ OTA_TELEMETRY_DOCUMENT_SIZE ];
+    size_t length;
 
-    result = cy_mqtt_subscribe(mqtthandle, &sub_msg[0], 1);
-    if(result != CY_RSLT_SUCCESS)
+    length = OtaTelemetry_BuildDocument( telemetryDocument, sizeof( telemetryDocument ), final );
+    if( length == 0U )
     {
-        otaRet = OtaMqttSubscribeFailed;
-        printf("cy_mqtt_subscribe failed with Error : [0x%X] \n\r",
-                (unsigned int)result);
-        printf("OTA MQTT subscribe failed. \n\r");
+        OTA_LOG_WARN(OTA_LOG_MODULE_APP, "OTA telemetry document exceeds %u bytes.\n",
+                (unsigned int)sizeof( telemetryDocument ));
     }
-    else
+    else if( mqttPublish( OTA_TELEMETRY_TOPIC, OTA_TOPIC_LENGTH( OTA_TELEMETRY_TOPIC ),
+            telemetryDocument, ( uint32_t ) length, 0U ) != OtaMqttSuccess )
     {
-        printf("OTA MQTT subscribe completed successfully. \n");
-        printf("SUBSCRIBE topic %.*s to broker.\n\n", topicFilterLength,
-                pTopicFilter);
+        OTA_LOG_WARN(OTA_LOG_MODULE_APP, "Failed to publish OTA telemetry.\n");
     }
-
-    registerSubscriptionManagerCallback(pTopicFilter, topicFilterLength);
-    return otaRet;
 }
 
 /*******************************************************************************
- * Function Name: mqttPublish()
+ * Function Name: otaMemPoolFailureHook()
  *******************************************************************************
  * Summary:
- *  Publish message to a topic.This function publishes a message to a
- *  given topic & QoS.
+ *  Reports an OTA agent allocation the memory pool could not serve. The
+ *  agent fails the job in that case; raise the count or the size of the
+ *  OTA_MEM_POOL_CLASS_* blocks accordingly.
  *
  * Parameters:
- *  pacTopic:   Mqtt topic filter.
- *  topicLen:   Length of the topic filter.
- *  pMsg:       Message to publish.
+ *  size: Number of bytes requested.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void otaMemPoolFailureHook( size_t size )
+{
+    OTA_LOG_ERROR(OTA_LOG_MODULE_APP, "OTA memory pool cannot serve %u bytes.\n", (unsigned int)size);
+}
+
+/*******************************************************************************
+ * Function Name: telemetryTimerCallback()
+ *******************************************************************************
+ * Summary:
+ *  Timer callback waking up the supervisor loop to publish the telemetry.
+ *
+ * Parameters:
+ *  timer: Handle of the expired timer.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void telemetryTimerCallback( TimerHandle_t timer )
+{
+    (void) xEventGroupSetBits(otaDemoEventGroup, OTA_DEMO_EVENT_TELEMETRY);
+}
+
+/*******************************************************************************
+ * Function Name: setOtaInterfaces()
+ *******************************************************************************
+ * Summary:
+ *  Set OTA interfaces.
+ *
+ * Parameters:
+ *  pOtaInterfaces: pointer to OTA interface structure.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void setOtaInterfaces( OtaInterfaces_t * pOtaInterfaces )
+{
+    /* Initialize OTA library OS Interface. */
+    pOtaInterfaces->os.event.init = cy_awsport_ota_event_init;
+    pOtaInterfaces->os.event.send = cy_awsport_ota_event_send;
+    pOtaInterfaces->os.event.recv = otaEventReceive;
+    pOtaInterfaces->os.event.deinit = cy_awsport_ota_event_deinit;
+    pOtaInterfaces->os.timer.start = cy_awsport_ota_timer_create_start;
+    pOtaInterfaces->os.timer.stop = cy_awsport_ota_timer_stop;
+    pOtaInterfaces->os.timer.delete = cy_awsport_ota_timer_delete;
+    pOtaInterfaces->os.mem.malloc = OtaMemPool_Malloc;
+    pOtaInterfaces->os.mem.free = OtaMemPool_Free;
+
+    /* Initialize the OTA library MQTT Interface.*/
+    pOtaInterfaces->mqtt.subscribe = mqttSubscribe;
+    pOtaInterfaces->mqtt.publish = mqttPublish;
+    pOtaInterfaces->mqtt.unsubscribe = mqttUnsubscribe;
+
+    /* Initialize the OTA library PAL Interface.*/
+    pOtaInterfaces->pal.getPlatformImageState = cy_awsport_ota_flash_get_platform_imagestate;
+    pOtaInterfaces->pal.setPlatformImageState = cy_awsport_ota_flash_set_platform_imagestate;
+    pOtaInterfaces->pal.writeBlock = otaPalWriteBlock;
+    pOtaInterfaces->pal.activate = cy_awsport_ota_flash_activate_newimage;
+    pOtaInterfaces->pal.closeFile = OtaFlashWriter_CloseFile;
+    pOtaInterfaces->pal.reset = cy_awsport_ota_flash_reset_device;
+    pOtaInterfaces->pal.abort = OtaFlashWriter_Abort;
+    pOtaInterfaces->pal.createFile = otaPalCreateFile;
+}
+
+/*******************************************************************************
+ * Function Name: otaPalCreateFile()
+ *******************************************************************************
+ * Summary:
+ *  Starts the counters of a new job and creates the receive file through the
+ *  write-behind flash writer.
+ *
+ * Parameters:
+ *  pFileContext:   OTA file context.
+ *
+ * Return:
+ *  OtaPalSuccess on success, PAL error code otherwise.
+ *
+ *******************************************************************************/
+OtaPalStatus_t otaPalCreateFile( OtaFileContext_t * const pFileContext )
+{
+    resetJobStatistics();
+
+    return OtaFlashWriter_CreateFile( pFileContext );
+}
+
+/*******************************************************************************
+ * Function Name: otaPalWriteBlock()
+ *******************************************************************************
+ * Summary:
+ *  Hands a file block to the write-behind flash writer.
+ *
+ * Parameters:
+ *  pFileContext:   OTA file context.
+ *  offset:         Offset of the block in the file.
+ *  pData:          Block data.
+ *  blockSize:      Size of the block.
+ *
+ * Return:
+ *  Number of bytes written, negative value on failure.
+ *
+ *******************************************************************************/
+int16_t otaPalWriteBlock( OtaFileContext_t * const pFileContext,
+        uint32_t offset,
+        uint8_t * const pData,
+        uint32_t blockSize )
+{
+    int16_t bytesWritten;
+
+#if ( OTA_BLOCK_DECODER_ENABLE == 1 )
+    /* The block was staged by the receive path, pData holds no block data. */
+    bytesWritten = OtaFlashWriter_ConfirmBlock( pFileContext, offset, blockSize );
+#else
+    bytesWritten = OtaFlashWriter_WriteBlock( pFileContext, offset, pData, blockSize );
+#endif
+
+    return bytesWritten;
+}
+
+/*******************************************************************************
+ * Function Name: mqttSubscribe()
+ *******************************************************************************
+ * Summary:
+ *  Subscribe to the MQTT topic filter, and registers the handler for the topic
+ *  filter with the subscription manager.This function subscribes to the Mqtt
+ *  topics with the Quality of service received as parameter. This function also
+ *  registers a callback for the topicfilter.
+ *
+ *  The OTA agent subscribes its job topics one by one, right after each other.
+ *  The first of them is subscribed together with its companion topics in a
+ *  single SUBSCRIBE packet, and the requests for the companions that follow
+ *  are answered from the result of that packet without a round trip.
+ *
+ * Parameters:
+ *  pTopicFilter:       Mqtt topic filter.
+ *  topicFilterLength:  Length of the topic filter.
+ *  qos:                Quality of Service
+ *
+ * Return:
+ *  OtaMqttSuccess: if success, other error code on failure.
+ *
+ *******************************************************************************/
+OtaMqttStatus_t mqttSubscribe( const char *pTopicFilter,
+        uint16_t topicFilterLength,
+        uint8_t qos )
+{
+    cy_rslt_t result = CY_RSLT_SUCCESS;
+    OtaMqttStatus_t otaRet = OtaMqttSuccess;
+    cy_mqtt_subscribe_info_t sub_msg[OTA_NUM_COMPANION_TOPICS];
+    uint8_t count = 1U;
+    uint8_t index;
+    uint8_t companion = OTA_NUM_COMPANION_TOPICS;
+    TickType_t startTick;
+
+    if((pTopicFilter == NULL ) || (topicFilterLength == 0))
+    {
+        printf("Invalid parameters to MQTT subscribe. \n");
+        return OtaMqttSubscribeFailed;
+    }
+
+    (void) findCompanionTopic(pTopicFilter, topicFilterLength, &companion);
+
+    /* A batch sent for a companion topic already subscribed this one. */
+    if( ( companion < OTA_NUM_COMPANION_TOPICS ) && ( companionSubscribedAhead[companion] == true ) )
+    {
+        companionSubscribedAhead[companion] = false;
+        otaConnectionStatistics.topicsCoalesced++;
+        printf("Topic %.*s subscribed with its companion topics.\n",
+                topicFilterLength, pTopicFilter);
+        registerSubscriptionManagerCallback(pTopicFilter, topicFilterLength);
+        return OtaMqttSuccess;
+    }
+
+    memset( &sub_msg, 0x00, sizeof( sub_msg ));
+    sub_msg[0].qos = (cy_mqtt_qos_t)qos;
+    sub_msg[0].topic = pTopicFilter;
+    sub_msg[0].topic_len = topicFilterLength;
+
+    /* Add the companion topics. */
+    if( companion < OTA_NUM_COMPANION_TOPICS )
+    {
+        companionUnsubscribedAhead[companion] = false;
+
+        for( index = 0U; index < OTA_NUM_COMPANION_TOPICS; index++ )
+        {
+            if( index != companion )
+            {
+                sub_msg[count].qos = (cy_mqtt_qos_t)qos;
+                sub_msg[count].topic = otaCompanionTopics[index].pFilter;
+                sub_msg[count].topic_len = otaCompanionTopics[index].filterLength;
+                count++;
+            }
+        }
+    }
+
+    startTick = xTaskGetTickCount();
+    result = cy_mqtt_subscribe(mqtthandle, &sub_msg[0], count);
+    otaConnectionStatistics.subscribeRoundTrips++;
+    otaConnectionStatistics.subscribeTimeMs += ( uint32_t ) ( xTaskGetTickCount() - startTick ) * portTICK_PERIOD_MS;
+
+    if(result != CY_RSLT_SUCCESS)
+    {
+        otaRet = OtaMqttSubscribeFailed;
+        printf("cy_mqtt_subscribe failed with Error : [0x%X] \n\r",
+                (unsigned int)result);
+        printf("OTA MQTT subscribe failed. \n\r");
+    }
+    else
+    {
+        for( index = 0U; index < count; index++ )
+        {
+            /* The broker may reject single topic filters of the packet. */
+            if( ( uint32_t ) sub_msg[index].allocated_qos == OTA_MQTT_SUBACK_FAILURE )
+            {
+                printf("SUBSCRIBE topic %.*s rejected by broker.\n", sub_msg[index].topic_len,
+                        sub_msg[index].topic);
+                continue;
+            }
+
+            printf("SUBSCRIBE topic %.*s to broker.\n", sub_msg[index].topic_len,
+                    sub_msg[index].topic);
+        }
+        printf("\n");
+
+        if( ( uint32_t ) sub_msg[0].allocated_qos == OTA_MQTT_SUBACK_FAILURE )
+        {
+            otaRet = OtaMqttSubscribeFailed;
+            printf("OTA MQTT subscribe failed. \n\r");
+        }
+        else
+        {
+            printf("OTA MQTT subscribe completed successfully. \n");
+        }
+
+        /* Answer the requests for the granted companions from this packet,
+         * the rejected ones are subscribed again on their own. */
+        for( index = 1U; index < count; index++ )
+        {
+            if( ( ( uint32_t ) sub_msg[index].allocated_qos != OTA_MQTT_SUBACK_FAILURE ) &&
+                    ( findCompanionTopic(sub_msg[index].topic, sub_msg[index].topic_len, &companion) == true ) )
+            {
+                companionSubscribedAhead[companion] = true;
+                companionUnsubscribedAhead[companion] = false;
+            }
+        }
+    }
+
+    registerSubscriptionManagerCallback(pTopicFilter, topicFilterLength);
+    return otaRet;
+}
+
+/*******************************************************************************
+ * Function Name: findCompanionTopic()
+ *******************************************************************************
+ * Summary:
+ *  Looks up a topic filter among the companion topics, which are subscribed
+ *  and unsubscribed in a single packet.
+ *
+ * Parameters:
+ *  pTopicFilter:       Mqtt topic filter.
+ *  topicFilterLength:  Length of the topic filter.
+ *  pIndex:             Receives the index of the companion topic found.
+ *
+ * Return:
+ *  true if the topic filter is a companion topic, false otherwise.
+ *
+ *******************************************************************************/
+bool findCompanionTopic( const char * pTopicFilter,
+        uint16_t topicFilterLength,
+        uint8_t * pIndex )
+{
+    uint8_t index;
+
+    for( index = 0U; index < OTA_NUM_COMPANION_TOPICS; index++ )
+    {
+        if( ( otaCompanionTopics[index].filterLength == topicFilterLength ) &&
+                ( memcmp( otaCompanionTopics[index].pFilter, pTopicFilter, topicFilterLength ) == 0 ) )
+        {
+            *pIndex = index;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*******************************************************************************
+ * Function Name: mqttPublish()
+ *******************************************************************************
+ * Summary:
+ *  Publish message to a topic.This function publishes a message to a
+ *  given topic & QoS.
+ *
+ * Parameters:
+ *  pacTopic:   Mqtt topic filter.
+ *  topicLen:   Length of the topic filter.
+ *  pMsg:       Message to publish.
  *  msgSize:    Message size.
  *  qos:        Quality of Service
  *
@@ -836,9 +1793,17 @@ OtaMqttStatus_t mqttPublish( const char * const pacTopic,
         uint32_t msgSize,
         uint8_t qos )
 {
+#if ( OTA_STREAM_LANES_MAX > 1U )
+    /* Stream request sent in place of the one of the agent. Only the OTA
+     * agent task publishes stream requests. */
+    static uint8_t streamRequest[ OTA_STREAM_LANES_REQUEST_SIZE ];
+    size_t streamRequestSize = 0U;
+#endif
     OtaMqttStatus_t otaRet = OtaMqttSuccess;
     cy_rslt_t result = CY_RSLT_SUCCESS;
     cy_mqtt_publish_info_t pub_msg;
+    bool isStreamRequest;
+    uint32_t lanes = 0U;
 
     if((pacTopic == NULL ) || (topicLen == 0 ) || (pMsg == NULL))
     {
@@ -846,6 +1811,34 @@ OtaMqttStatus_t mqttPublish( const char * const pacTopic,
         return OtaMqttPublishFailed;
     }
 
+    isStreamRequest = ( topicLen > OTA_TOPIC_LENGTH( OTA_STREAM_TOPIC_PREFIX OTA_STREAM_SUFFIX_GET_CBOR ) ) &&
+            ( memcmp( pacTopic, OTA_STREAM_TOPIC_PREFIX,
+                    OTA_TOPIC_LENGTH( OTA_STREAM_TOPIC_PREFIX ) ) == 0 ) &&
+            ( memcmp( &pacTopic[ topicLen - OTA_TOPIC_LENGTH( OTA_STREAM_SUFFIX_GET_CBOR ) ],
+                    OTA_STREAM_SUFFIX_GET_CBOR, OTA_TOPIC_LENGTH( OTA_STREAM_SUFFIX_GET_CBOR ) ) == 0 );
+
+    if( isStreamRequest == true )
+    {
+        lanes = OtaStreamLanes_OnBlockRequest( ( const uint8_t * ) pMsg, msgSize );
+
+#if ( OTA_STREAM_LANES_MAX > 1U )
+        /* Ask only for the blocks that are not already in flight from the
+         * requests of the earlier rounds. */
+        if( lanes == 0U )
+        {
+            OTA_LOG_INFO(OTA_LOG_MODULE_MQTT, "All requested blocks are in flight, request skipped.\n");
+            publishStreamLanes( pacTopic, topicLen, lanes, qos );
+            return OtaMqttSuccess;
+        }
+
+        if( OtaStreamLanes_BuildRequest( 0U, streamRequest, sizeof( streamRequest ), &streamRequestSize ) == true )
+        {
+            pMsg = ( const char * ) streamRequest;
+            msgSize = ( uint32_t ) streamRequestSize;
+        }
+#endif
+    }
+
     memset( &pub_msg, 0x00, sizeof( cy_mqtt_publish_info_t ));
     pub_msg.topic = pacTopic;
     pub_msg.topic_len = topicLen;
@@ -857,25 +1850,181 @@ OtaMqttStatus_t mqttPublish( const char * const pacTopic,
     if(result != CY_RSLT_SUCCESS)
     {
         otaRet = OtaMqttPublishFailed;
-        printf("cy_mqtt_publish failed with Error : [0x%X]\n",
+        OTA_LOG_ERROR(OTA_LOG_MODULE_MQTT, "cy_mqtt_publish failed with Error : [0x%X]\n",
                 (unsigned int)result);
-        printf("OTA MQTT publish failed. \n");
     }
     else
     {
-        printf("OTA MQTT publish completed successfully.\n");
-        printf("Sent PUBLISH packet to broker %.*s to broker.\n", topicLen, pacTopic);
+        OTA_LOG_DEBUG(OTA_LOG_MODULE_MQTT, "Sent PUBLISH packet to broker %.*s.\n",
+                topicLen, pacTopic);
+
+        /* Start timing the round trip of file block requests and send the
+         * requests of the other stream lanes. */
+        if( isStreamRequest == true )
+        {
+            publishStreamLanes( pacTopic, topicLen, lanes, qos );
+        }
     }
 
     return otaRet;
 }
 
+/*******************************************************************************
+ * Function Name: publishStreamLanes()
+ *******************************************************************************
+ * Summary:
+ *  Starts the flow control batch of a stream request of the OTA agent and
+ *  follows the request with the requests of the other stream lanes, each
+ *  asking for the blocks after those of the previous lane, so that the
+ *  service never runs out of queued blocks between requests.
+ *
+ * Parameters:
+ *  pacTopic:   Stream request topic.
+ *  topicLen:   Length of the topic.
+ *  lanes:      Lanes of the round, 0 if the request of the agent was
+ *              skipped because all its blocks are in flight.
+ *  qos:        Quality of Service
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void publishStreamLanes( const char * const pacTopic,
+        uint16_t topicLen,
+        uint32_t lanes,
+        uint8_t qos )
+{
+#if ( OTA_STREAM_LANES_MAX > 1U )
+    uint8_t laneRequest[ OTA_STREAM_LANES_REQUEST_SIZE ];
+    size_t laneRequestSize = 0U;
+    cy_mqtt_publish_info_t pub_msg;
+#endif
+    uint8_t bitmap[ OTA_MAX_BLOCK_BITMAP_SIZE ];
+    uint32_t numBlocks = 0U;
+#if ( OTA_STREAM_LANES_MAX > 1U ) || \
+    ( ( OTA_FAST_RETRANSMIT_ENABLE == 1 ) && ( MQTT_DISPATCHER_ENABLE == 1 ) )
+    uint32_t lane = 1U;
+#endif
+
+    /* Track the batch against the blocks the agent actually asked for, the
+     * window may have changed since the agent encoded the request. */
+    if( OtaStreamLanes_GetAgentRequest( bitmap, sizeof( bitmap ), &numBlocks ) == false )
+    {
+        numBlocks = 0U;
+    }
+
+    OtaFlowControl_OnBlockRequest( numBlocks );
+
+#if ( OTA_STREAM_LANES_MAX > 1U )
+    /* Hold the other lanes back while the agent still drains the pool. */
+    if( ( lanes > 1U ) && ( OtaFlowControl_IsPoolUnderPressure() == true ) )
+    {
+        OtaBlockRecovery_OnRequestPaused();
+        lanes = 1U;
+    }
+
+    for( lane = 1U; lane < lanes; lane++ )
+    {
+        if( OtaStreamLanes_BuildRequest( lane, laneRequest, sizeof( laneRequest ), &laneRequestSize ) == false )
+        {
+            break;
+        }
+
+        memset( &pub_msg, 0x00, sizeof( cy_mqtt_publish_info_t ));
+        pub_msg.topic = pacTopic;
+        pub_msg.topic_len = topicLen;
+        pub_msg.qos = (cy_mqtt_qos_t)qos;
+        pub_msg.payload = (const char *)laneRequest;
+        pub_msg.payload_len = laneRequestSize;
+
+        if( cy_mqtt_publish( mqtthandle, &pub_msg ) != CY_RSLT_SUCCESS )
+        {
+            OTA_LOG_WARN(OTA_LOG_MODULE_MQTT, "Stream request of lane %u failed.\n", (unsigned int)lane);
+            break;
+        }
+    }
+#endif
+
+#if ( OTA_FAST_RETRANSMIT_ENABLE == 1 ) && ( MQTT_DISPATCHER_ENABLE == 1 )
+    /* Track the blocks asked for in this round to spot those lost on the way. */
+    if( ( topicLen <= sizeof( streamRequestTopic ) ) && ( numBlocks != 0U ) && ( lanes != 0U ) )
+    {
+        /* Only the agent task writes the topic, so it can be compared
+         * outside the critical section. */
+        if( ( topicLen != streamRequestTopicLength ) ||
+                ( memcmp( streamRequestTopic, pacTopic, topicLen ) != 0 ) )
+        {
+            taskENTER_CRITICAL();
+            memcpy( streamRequestTopic, pacTopic, topicLen );
+            streamRequestTopicLength = topicLen;
+            taskEXIT_CRITICAL();
+        }
+
+        OtaFastRetransmit_OnRequest( bitmap, sizeof( bitmap ), numBlocks, lane );
+    }
+#endif
+}
+
+/*******************************************************************************
+ * Function Name: publishRetransmitRequest()
+ *******************************************************************************
+ * Summary:
+ *  Asks the streaming service again for the blocks found missing behind
+ *  later blocks of the same request, without waiting for the OTA agent to
+ *  time out on the request. Runs on the dispatcher task.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void publishRetransmitRequest( void )
+{
+#if ( OTA_FAST_RETRANSMIT_ENABLE == 1 ) && ( MQTT_DISPATCHER_ENABLE == 1 )
+    uint8_t bitmap[ OTA_MAX_BLOCK_BITMAP_SIZE ];
+    uint8_t request[ OTA_STREAM_LANES_REQUEST_SIZE ];
+    char topic[ OTA_STREAM_REQUEST_TOPIC_SIZE ];
+    uint16_t topicLength;
+    size_t requestSize = 0U;
+    cy_mqtt_publish_info_t pub_msg;
+    uint32_t numBlocks = 0U;
+
+    taskENTER_CRITICAL();
+    topicLength = streamRequestTopicLength;
+    memcpy( topic, streamRequestTopic, topicLength );
+    taskEXIT_CRITICAL();
+
+    if( ( topicLength == 0U ) ||
+            ( OtaFastRetransmit_TakeRequest( bitmap, sizeof( bitmap ), &numBlocks ) == false ) ||
+            ( OtaStreamLanes_BuildBlockRequest( bitmap, numBlocks, request, sizeof( request ), &requestSize ) == false ) )
+    {
+        return;
+    }
+
+    memset( &pub_msg, 0x00, sizeof( cy_mqtt_publish_info_t ));
+    pub_msg.topic = topic;
+    pub_msg.topic_len = topicLength;
+    pub_msg.qos = CY_MQTT_QOS0;
+    pub_msg.payload = (const char *)request;
+    pub_msg.payload_len = requestSize;
+
+    if( cy_mqtt_publish( mqtthandle, &pub_msg ) != CY_RSLT_SUCCESS )
+    {
+        OTA_LOG_WARN(OTA_LOG_MODULE_MQTT, "Request for %u missing blocks failed.\n", (unsigned int)numBlocks);
+    }
+#endif
+}
+
 /*******************************************************************************
  * Function Name: mqttUnsubscribe()
  *******************************************************************************
  * Summary:
  *  Unsubscribe to the Mqtt topics. This function unsubscribes to the Mqtt
- *  topics with the Quality of service received as parameter.
+ *  topics with the Quality of service received as parameter. Companion
+ *  topics are unsubscribed together in a single UNSUBSCRIBE packet, see
+ *  mqttSubscribe().
  *
  * Parameters:
  *  pTopicFilter:       Mqtt topic filter.
@@ -892,7 +2041,11 @@ OtaMqttStatus_t mqttUnsubscribe( const char * pTopicFilter,
 {
     cy_rslt_t result = CY_RSLT_SUCCESS;
     OtaMqttStatus_t otaRet = OtaMqttSuccess;
-    cy_mqtt_unsubscribe_info_t unsub_msg[1];
+    cy_mqtt_unsubscribe_info_t unsub_msg[OTA_NUM_COMPANION_TOPICS];
+    uint8_t count = 1U;
+    uint8_t index;
+    uint8_t companion = OTA_NUM_COMPANION_TOPICS;
+    TickType_t startTick;
 
     if( (pTopicFilter == NULL ) || (topicFilterLength == 0) )
     {
@@ -900,12 +2053,44 @@ OtaMqttStatus_t mqttUnsubscribe( const char * pTopicFilter,
         return OtaMqttUnsubscribeFailed;
     }
 
-    memset( &unsub_msg, 0x00, sizeof( cy_mqtt_unsubscribe_info_t ));
+    (void) findCompanionTopic(pTopicFilter, topicFilterLength, &companion);
+
+    /* A batch sent for a companion topic already unsubscribed this one. */
+    if( ( companion < OTA_NUM_COMPANION_TOPICS ) && ( companionUnsubscribedAhead[companion] == true ) )
+    {
+        companionUnsubscribedAhead[companion] = false;
+        otaConnectionStatistics.topicsCoalesced++;
+        printf("Topic %.*s unsubscribed with its companion topics.\n",
+                topicFilterLength, pTopicFilter);
+        return OtaMqttSuccess;
+    }
+
+    memset( &unsub_msg, 0x00, sizeof( unsub_msg ));
     unsub_msg[0].qos = (cy_mqtt_qos_t)qos;
     unsub_msg[0].topic = pTopicFilter;
     unsub_msg[0].topic_len = topicFilterLength;
 
-    result = cy_mqtt_unsubscribe(mqtthandle, &unsub_msg[0], 1);
+    if( companion < OTA_NUM_COMPANION_TOPICS )
+    {
+        companionSubscribedAhead[companion] = false;
+
+        for( index = 0U; index < OTA_NUM_COMPANION_TOPICS; index++ )
+        {
+            if( index != companion )
+            {
+                unsub_msg[count].qos = (cy_mqtt_qos_t)qos;
+                unsub_msg[count].topic = otaCompanionTopics[index].pFilter;
+                unsub_msg[count].topic_len = otaCompanionTopics[index].filterLength;
+                count++;
+            }
+        }
+    }
+
+    startTick = xTaskGetTickCount();
+    result = cy_mqtt_unsubscribe(mqtthandle, &unsub_msg[0], count);
+    otaConnectionStatistics.unsubscribeRoundTrips++;
+    otaConnectionStatistics.unsubscribeTimeMs += ( uint32_t ) ( xTaskGetTickCount() - startTick ) * portTICK_PERIOD_MS;
+
     if(result != CY_RSLT_SUCCESS)
     {
         otaRet = OtaMqttUnsubscribeFailed;
@@ -916,8 +2101,22 @@ OtaMqttStatus_t mqttUnsubscribe( const char * pTopicFilter,
     else
     {
         printf("OTA MQTT unsubscribe completed successfully.\n");
-        printf("Unsubscribed topic %.*s from broker.\n", topicFilterLength,
-                pTopicFilter);
+
+        for( index = 0U; index < count; index++ )
+        {
+            printf("Unsubscribed topic %.*s from broker.\n", unsub_msg[index].topic_len,
+                    unsub_msg[index].topic);
+        }
+
+        /* Answer the requests for the companions from this packet. */
+        for( index = 1U; index < count; index++ )
+        {
+            if( findCompanionTopic(unsub_msg[index].topic, unsub_msg[index].topic_len, &companion) == true )
+            {
+                companionUnsubscribedAhead[companion] = true;
+                companionSubscribedAhead[companion] = false;
+            }
+        }
     }
 
     return otaRet;
@@ -927,7 +2126,8 @@ OtaMqttStatus_t mqttUnsubscribe( const char * pTopicFilter,
  * Function Name: otaEventBufferFree()
  *******************************************************************************
  * Summary:
- *  Function to frees OTA event buffer
+ *  Function to frees OTA event buffer. The buffer is pushed back on the
+ *  lock-free free list of the event buffer pool without blocking.
  *
  * Parameters:
  *  pxBuffer:   Pointer to the event data structure.
@@ -938,16 +2138,14 @@ OtaMqttStatus_t mqttUnsubscribe( const char * pTopicFilter,
  *******************************************************************************/
 void otaEventBufferFree( OtaEventData_t * const pxBuffer )
 {
-    if(pdTRUE == xSemaphoreTake(bufferSemaphore, pdMS_TO_TICKS(CY_RTOS_NEVER_TIMEOUT)))
+    if( OtaBufferPool_Free( pxBuffer ) == true )
     {
-        pxBuffer->bufferUsed = false;
-        ( void )xSemaphoreGive(bufferSemaphore);
-        printf("otaEventBufferFree completed....!\n");
+        OTA_LOG_DEBUG(OTA_LOG_MODULE_DATA, "otaEventBufferFree completed.\n");
     }
     else
     {
-        printf("Failed to get buffer semaphore\n");
-        printf("otaEventBufferFree failed....!\n");
+        OTA_LOG_ERROR(OTA_LOG_MODULE_DATA, "otaEventBufferFree failed, buffer does not "
+                "belong to the pool or is already free.\n");
     }
 }
 
@@ -968,57 +2166,50 @@ void otaEventBufferFree( OtaEventData_t * const pxBuffer )
 void registerSubscriptionManagerCallback( const char * pTopicFilter,
         uint16_t topicFilterLength )
 {
-    bool isMatch = false;
-    MQTTStatus_t mqttStatus = MQTTSuccess;
     SubscriptionManagerStatus_t subscriptionStatus = SUBSCRIPTION_MANAGER_SUCCESS;
-
     uint16_t index = 0U;
 
-    /* For suppressing compiler-warning: unused variable. */
-    ( void ) mqttStatus;
-
-    /* Lookup table for OTA message string. */
-    static const char * const pWildCardTopicFilters[] =
+    /* Lookup table of the thing-specific OTA topic prefixes and the topic
+     * filters registered with the subscription manager for them. */
+    static const struct
+    {
+        const char * pPrefix;
+        uint16_t prefixLength;
+        const char * pFilter;
+        uint16_t filterLength;
+    } otaTopicFilters[] =
     {
-            OTA_TOPIC_PREFIX OTA_TOPIC_JOBS "/#",
-            OTA_TOPIC_PREFIX OTA_TOPIC_STREAM "/#"
+            { OTA_JOBS_TOPIC_PREFIX, OTA_TOPIC_LENGTH( OTA_JOBS_TOPIC_PREFIX ),
+              OTA_JOBS_TOPIC_PREFIX "#", OTA_TOPIC_LENGTH( OTA_JOBS_TOPIC_PREFIX "#" ) },
+            { OTA_STREAM_TOPIC_PREFIX, OTA_TOPIC_LENGTH( OTA_STREAM_TOPIC_PREFIX ),
+              OTA_STREAM_TOPIC_PREFIX "#", OTA_TOPIC_LENGTH( OTA_STREAM_TOPIC_PREFIX "#" ) }
     };
 
-    /* Match the input topic filter against the wild-card pattern of topics filters
+    /* Match the input topic filter against the prefixes of the topic filters
      * relevant for the OTA Update service to determine the type of topic filter. */
-    for( ; index < 2; index++ )
-    {
-        mqttStatus = MQTT_MatchTopic( pTopicFilter,
-                topicFilterLength,
-                pWildCardTopicFilters[ index ],
-                strlen( pWildCardTopicFilters[ index ] ),
-                &isMatch );
-        if(mqttStatus != MQTTSuccess)
-        {
-            printf("MQTT_MatchTopic failed....\n");
-        }
-        else
+    for( ; index < ( sizeof( otaTopicFilters ) / sizeof( otaTopicFilters[ 0 ] ) ); index++ )
+    {
+        if( ( topicFilterLength >= otaTopicFilters[ index ].prefixLength ) &&
+                ( memcmp( pTopicFilter, otaTopicFilters[ index ].pPrefix,
+                        otaTopicFilters[ index ].prefixLength ) == 0 ) )
         {
-            if(isMatch)
-            {
-                /* Register callback to subscription manager. */
-                subscriptionStatus = SubscriptionManager_RegisterCallback( pWildCardTopicFilters[ index ],
-                        strlen( pWildCardTopicFilters[ index ] ),
-                        otaMessageCallback[ index ] );
+            /* Register callback to subscription manager. */
+            subscriptionStatus = SubscriptionManager_RegisterCallback( otaTopicFilters[ index ].pFilter,
+                    otaTopicFilters[ index ].filterLength,
+                    otaMessageCallback[ index ] );
 
-                if(subscriptionStatus != SUBSCRIPTION_MANAGER_SUCCESS)
-                {
-                    printf("Failed to register a callback to subscription "
-                            "manager with error = %d.\n", subscriptionStatus);
-                }
-                else
-                {
-                    printf("Registered a callback to subscription manager "
-                            "successfully.\n");
-                }
-
-                break;
+            if(subscriptionStatus != SUBSCRIPTION_MANAGER_SUCCESS)
+            {
+                printf("Failed to register a callback to subscription "
+                        "manager with error = %d.\n", subscriptionStatus);
             }
+            else
+            {
+                printf("Registered a callback to subscription manager "
+                        "successfully.\n");
+            }
+
+            break;
         }
     }
 }
@@ -1041,8 +2232,6 @@ void registerSubscriptionManagerCallback( const char * pTopicFilter,
  *******************************************************************************/
 void mqttJobCallback( cy_mqtt_t handle, cy_mqtt_received_msg_info_t *pPublishInfo )
 {
-    OtaEventData_t * pData;
-    OtaEventMsg_t eventMsg = { 0 };
     jobMessageType_t jobMessageType = jobMessageTypeNextGetAccepted;
 
     if( (pPublishInfo == NULL) || (handle == NULL) )
@@ -1057,21 +2246,9 @@ void mqttJobCallback( cy_mqtt_t handle, cy_mqtt_received_msg_info_t *pPublishInf
         {
         case jobMessageTypeNextGetAccepted:
         case jobMessageTypeNextNotify:
-            pData = otaEventBufferGet();
-            if( pData != NULL )
-            {
-                memcpy( pData->data, pPublishInfo->payload, pPublishInfo->payload_len );
-                pData->dataLength = pPublishInfo->payload_len;
-                eventMsg.eventId = OtaAgentEventReceivedJobDocument;
-                eventMsg.pEventData = pData;
-
-                /* Send job document received event. */
-                OTA_SignalEvent( &eventMsg );
-            }
-            else
-            {
-                printf("No OTA data buffers available.\n");
-            }
+            /* Send job document received event. */
+            countDataPath( &otaDataPathStatistics.bytesReceived, pPublishInfo->payload_len );
+            ( void ) otaEventBufferLoan( pPublishInfo, OtaAgentEventReceivedJobDocument );
 
             break;
 
@@ -1099,31 +2276,34 @@ void mqttJobCallback( cy_mqtt_t handle, cy_mqtt_received_msg_info_t *pPublishInf
  *******************************************************************************/
 void mqttDataCallback( cy_mqtt_t handle, cy_mqtt_received_msg_info_t *pPublishInfo )
 {
-    OtaEventData_t * pData;
-    OtaEventMsg_t eventMsg = { 0 };
-
     if((pPublishInfo == NULL) || (handle == NULL))
     {
-        printf("Invalid input to mqttDataCallback....\n");
+        OTA_LOG_ERROR(OTA_LOG_MODULE_DATA, "Invalid input to mqttDataCallback.\n");
     }
     else
     {
-        printf("Received data message callback, size %u.\n", pPublishInfo->payload_len);
-
-        pData = otaEventBufferGet();
-        if( pData != NULL )
+        OTA_LOG_DEBUG(OTA_LOG_MODULE_DATA, "Received data message callback, size %u.\n",
+                (unsigned int)pPublishInfo->payload_len);
+        countDataPath( &otaDataPathStatistics.bytesReceived, pPublishInfo->payload_len );
+
+        /* Send file block received event. */
+#if ( OTA_BLOCK_DECODER_ENABLE == 1 )
+        if( stageDataBlock( pPublishInfo ) == true )
+#else
+        if( otaEventBufferLoan( pPublishInfo, OtaAgentEventReceivedFileBlock ) == true )
+#endif
         {
-            memcpy( pData->data, pPublishInfo->payload, pPublishInfo->payload_len );
-            pData->dataLength = pPublishInfo->payload_len;
-            eventMsg.eventId = OtaAgentEventReceivedFileBlock;
-            eventMsg.pEventData = pData;
-
-            /* Send job document received event. */
-            OTA_SignalEvent(&eventMsg);
+            OtaTelemetry_RecordBlockReceived( ( uint32_t ) pPublishInfo->payload_len );
+            OtaFlowControl_OnBlockReceived();
+            OtaStreamLanes_OnBlockReceived();
         }
         else
         {
-            printf("No OTA data buffers available.\n");
+#if ( OTA_BLOCK_DECODER_ENABLE == 0 )
+            OtaBlockRecovery_OnBlockDropped( NULL );
+#endif
+            OtaFlowControl_OnBlockDropped();
+            OtaStreamLanes_OnBlockDropped();
         }
     }
 }
@@ -1145,41 +2325,26 @@ void mqttDataCallback( cy_mqtt_t handle, cy_mqtt_received_msg_info_t *pPublishIn
 jobMessageType_t getJobMessageType( const char * pTopicName,
         uint16_t topicNameLength )
 {
-    uint16_t index = 0U;
-    MQTTStatus_t mqttStatus = MQTTSuccess;
-    bool isMatch = false;
+    const uint16_t prefixLength = OTA_TOPIC_LENGTH( OTA_JOBS_TOPIC_PREFIX );
     jobMessageType_t jobMessageIndex = jobMessageTypeMax;
 
-    /* For suppressing compiler-warning: unused variable. */
-    ( void ) mqttStatus;
-
-    /* Lookup table for OTA job message string. */
-    static const char * const pJobTopicFilters[ jobMessageTypeMax ] =
+    /* The job topics differ only in their suffix, so after one comparison of
+     * the common thing-specific prefix a length check and a single fixed-length
+     * comparison of the suffix identify the message type. */
+    if( ( topicNameLength > prefixLength ) &&
+            ( memcmp( pTopicName, OTA_JOBS_TOPIC_PREFIX, prefixLength ) == 0 ) )
     {
-            OTA_TOPIC_PREFIX OTA_TOPIC_JOBS "/$next/get/accepted",
-            OTA_TOPIC_PREFIX OTA_TOPIC_JOBS "/notify-next",
-    };
-
-    /* Match the input topic filter against the wild-card pattern of topics filters
-     * relevant for the OTA Update service to determine the type of topic filter. */
-    for( ; index < jobMessageTypeMax; index++ )
-    {
-        mqttStatus = MQTT_MatchTopic( pTopicName,
-                topicNameLength,
-                pJobTopicFilters[ index ],
-                strlen( pJobTopicFilters[ index ] ),
-                &isMatch );
-        if( mqttStatus != MQTTSuccess )
+        if( ( topicNameLength == OTA_TOPIC_LENGTH( OTA_JOBS_TOPIC_PREFIX OTA_JOB_SUFFIX_NEXT_GET_ACCEPTED ) ) &&
+                ( memcmp( &pTopicName[ prefixLength ], OTA_JOB_SUFFIX_NEXT_GET_ACCEPTED,
+                        OTA_TOPIC_LENGTH( OTA_JOB_SUFFIX_NEXT_GET_ACCEPTED ) ) == 0 ) )
         {
-            printf("MQTT_MatchTopic failed....\n");
+            jobMessageIndex = jobMessageTypeNextGetAccepted;
         }
-        else
+        else if( ( topicNameLength == OTA_TOPIC_LENGTH( OTA_JOBS_TOPIC_PREFIX OTA_JOB_SUFFIX_NOTIFY_NEXT ) ) &&
+                ( memcmp( &pTopicName[ prefixLength ], OTA_JOB_SUFFIX_NOTIFY_NEXT,
+                        OTA_TOPIC_LENGTH( OTA_JOB_SUFFIX_NOTIFY_NEXT ) ) == 0 ) )
         {
-            if( isMatch )
-            {
-                jobMessageIndex = (jobMessageType_t)index;
-                break;
-            }
+            jobMessageIndex = jobMessageTypeNextNotify;
         }
     }
 
@@ -1190,7 +2355,8 @@ jobMessageType_t getJobMessageType( const char * pTopicName,
  * Function Name: otaEventBufferGet()
  *******************************************************************************
  * Summary:
- *  Function retrieves unused OTA event buffer.
+ *  Function retrieves unused OTA event buffer from the lock-free event
+ *  buffer pool in constant time.
  *
  * Parameters:
  *  void
@@ -1201,29 +2367,264 @@ jobMessageType_t getJobMessageType( const char * pTopicName,
  *******************************************************************************/
 OtaEventData_t * otaEventBufferGet(void)
 {
-    uint32_t ulIndex = 0;
-    OtaEventData_t * pFreeBuffer = NULL;
+    /* Pop a buffer from the lock-free free list, never blocks. */
+    return OtaBufferPool_Get();
+}
 
-    if(pdTRUE == xSemaphoreTake(bufferSemaphore, pdMS_TO_TICKS(CY_RTOS_NEVER_TIMEOUT)))
+/*******************************************************************************
+ * Function Name: otaEventBufferLoan()
+ *******************************************************************************
+ * Summary:
+ *  Loans an event buffer holding a received payload to the OTA agent. The
+ *  payload is copied exactly once into a pool slot: with the MQTT dispatcher
+ *  the message already sits in the slot it was queued in and the slot is
+ *  taken over as it is, otherwise the payload is copied here. Ownership of
+ *  the slot moves to the OTA agent together with the event. The agent hands the slot back through the OtaJobEventProcessed
+ *  callback. If the event cannot be queued the loan is reclaimed and the slot
+ *  is returned to the pool right away instead of leaking.
+ *
+ * Parameters:
+ *  pPublishInfo:   MQTT packet holding the payload to hand over.
+ *  eventId:        OTA agent event to signal with the payload.
+ *
+ * Return:
+ *  true if the OTA agent took ownership of the payload, false otherwise.
+ *
+ *******************************************************************************/
+bool otaEventBufferLoan( const cy_mqtt_received_msg_info_t *pPublishInfo,
+        OtaEvent_t eventId )
+{
+    OtaEventData_t * pData = NULL;
+    OtaEventMsg_t eventMsg = { 0 };
+    bool loaned = false;
+
+#if ( MQTT_DISPATCHER_ENABLE == 1 )
+    if( ( pData = MqttDispatcher_TakeBuffer( pPublishInfo->payload ) ) != NULL )
+    {
+        pData->dataLength = pPublishInfo->payload_len;
+    }
+    else
+#endif
+    if( pPublishInfo->payload_len > sizeof( pData->data ) )
+    {
+        OTA_LOG_WARN(OTA_LOG_MODULE_DATA, "Payload of %u bytes exceeds the OTA data buffer size.\n",
+                (unsigned int)pPublishInfo->payload_len);
+        countDataPath( &otaDataPathStatistics.payloadsDropped, 1U );
+    }
+    else if( ( pData = otaEventBufferGet() ) == NULL )
+    {
+        OTA_LOG_WARN(OTA_LOG_MODULE_DATA, "No OTA data buffers available.\n");
+        countDataPath( &otaDataPathStatistics.payloadsDropped, 1U );
+    }
+    else
     {
-        for( ulIndex = 0; ulIndex < otaconfigMAX_NUM_OTA_DATA_BUFFERS; ulIndex++ )
+        memcpy( pData->data, pPublishInfo->payload, pPublishInfo->payload_len );
+        pData->dataLength = pPublishInfo->payload_len;
+        countDataPath( &otaDataPathStatistics.bytesCopied, pPublishInfo->payload_len );
+    }
+
+    if( pData != NULL )
+    {
+        eventMsg.eventId = eventId;
+        eventMsg.pEventData = pData;
+
+        if( eventId == OtaAgentEventReceivedFileBlock )
         {
-            if( eventBuffer[ ulIndex ].bufferUsed == false )
+            /* Stamp before signalling, the agent may process the block at once. */
+            OtaTelemetry_RecordBlockQueued( pData );
+        }
+
+        if( OTA_SignalEvent( &eventMsg ) == true )
+        {
+            /* The OTA agent owns the buffer until OtaJobEventProcessed. */
+            countDataPath( &otaDataPathStatistics.buffersLoaned, 1U );
+            loaned = true;
+        }
+        else
+        {
+            OTA_LOG_WARN(OTA_LOG_MODULE_DATA, "Failed to signal OTA agent, reclaiming event buffer.\n");
+            countDataPath( &otaDataPathStatistics.loansReclaimed, 1U );
+            countDataPath( &otaDataPathStatistics.payloadsDropped, 1U );
+            OtaTelemetry_RecordBlockReclaimed( pData );
+            otaEventBufferFree( pData );
+        }
+    }
+
+    return loaned;
+}
+
+#if ( OTA_BLOCK_DECODER_ENABLE == 1 )
+/*******************************************************************************
+ * Function Name: stageDataBlock()
+ *******************************************************************************
+ * Summary:
+ *  Decodes a received stream data message in place and copies the block
+ *  straight into the flash writer. Only the header of the block is
+ *  loaned to the OTA agent, which takes the block from the flash writer when
+ *  it processes the header. Blocks that are already staged are passed on as
+ *  well, so that the agent accounts them as it does any other duplicate.
+ *
+ * Parameters:
+ *  pPublishInfo:   MQTT packet holding the stream data message.
+ *
+ * Return:
+ *  true if the OTA agent took ownership of the block header, false otherwise.
+ *
+ *******************************************************************************/
+bool stageDataBlock( const cy_mqtt_received_msg_info_t *pPublishInfo )
+{
+    cy_mqtt_received_msg_info_t headerInfo = *pPublishInfo;
+    uint8_t header[ OTA_BLOCK_DECODER_HEADER_MAX_SIZE ];
+    uint8_t * pHeader = header;
+    OtaStreamBlock_t block;
+    int16_t staged;
+
+    if( OtaBlockDecoder_Decode( ( const uint8_t * ) pPublishInfo->payload,
+            pPublishInfo->payload_len, &block ) == false )
+    {
+        OTA_LOG_WARN(OTA_LOG_MODULE_DATA, "Malformed stream data message of %u bytes.\n",
+                (unsigned int)pPublishInfo->payload_len);
+        countDataPath( &otaDataPathStatistics.blocksRejected, 1U );
+        return false;
+    }
+
+    staged = ( block.payloadSize == block.blockSize ) ?
+            OtaFlashWriter_StageBlock( block.fileId, block.blockId, block.pPayload, block.payloadSize ) : -1;
+
+    if( staged < 0 )
+    {
+        OTA_LOG_WARN(OTA_LOG_MODULE_DATA, "Block %u of file %u could not be staged.\n",
+                (unsigned int)block.blockId, (unsigned int)block.fileId);
+        countDataPath( &otaDataPathStatistics.blocksRejected, 1U );
+        return false;
+    }
+
+    if( staged > 0 )
+    {
+        countDataPath( &otaDataPathStatistics.blocksStaged, 1U );
+    }
+    else
+    {
+        OtaStreamLanes_OnDuplicateBlock();
+    }
+
+#if ( OTA_FAST_RETRANSMIT_ENABLE == 1 ) && ( MQTT_DISPATCHER_ENABLE == 1 )
+    if( OtaFastRetransmit_OnBlockReceived( block.blockId ) == true )
+    {
+        publishRetransmitRequest();
+    }
+#endif
+
+#if ( MQTT_DISPATCHER_ENABLE == 1 )
+    /* The block is copied out, the header takes its place in the event buffer
+     * the message was queued in, which is then loaned without a copy. */
+    pHeader = ( uint8_t * ) pPublishInfo->payload;
+#endif
+    headerInfo.payload = ( const char * ) pHeader;
+    headerInfo.payload_len = OtaBlockDecoder_EncodeHeader( &block, pHeader, sizeof( header ) );
+
+    if( otaEventBufferLoan( &headerInfo, OtaAgentEventReceivedFileBlock ) == false )
+    {
+        /* The block is staged, only its header has to reach the agent. */
+        OtaBlockRecovery_OnBlockDropped( &block );
+        return false;
+    }
+
+    return true;
+}
+#endif /* ( OTA_BLOCK_DECODER_ENABLE == 1 ) */
+
+/*******************************************************************************
+ * Function Name: recoverDroppedBlocks()
+ *******************************************************************************
+ * Summary:
+ *  Recovers the blocks dropped while the event buffer pool was exhausted, as
+ *  soon as the OTA agent returns buffers rather than after its request timer.
+ *  Blocks staged in the flash writer are handed to the agent again by their
+ *  header while the pool is not under pressure. Blocks that were not staged
+ *  are requested again once the agent drained the pool, by firing its request
+ *  timer early.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void recoverDroppedBlocks( void )
+{
+    cy_mqtt_received_msg_info_t headerInfo = { 0 };
+    OtaBufferPoolStatistics_t poolStatistics = { 0 };
+    uint8_t header[ OTA_BLOCK_DECODER_HEADER_MAX_SIZE ];
+    OtaEventMsg_t eventMsg = { 0 };
+    OtaStreamBlock_t block;
+    bool staged;
+
+    while( ( OtaFlowControl_IsPoolUnderPressure() == false ) &&
+            ( OtaBlockRecovery_NextBlock( &block ) == true ) )
+    {
+        /* A block of an earlier file is no longer staged, the agent must not
+         * be handed its header. */
+        staged = OtaFlashWriter_IsBlockStaged( block.blockId );
+        if( staged == true )
+        {
+            headerInfo.payload = ( const char * ) header;
+            headerInfo.payload_len = OtaBlockDecoder_EncodeHeader( &block, header, sizeof( header ) );
+
+            if( otaEventBufferLoan( &headerInfo, OtaAgentEventReceivedFileBlock ) == false )
             {
-                eventBuffer[ ulIndex ].bufferUsed = true;
-                pFreeBuffer = &eventBuffer[ ulIndex ];
                 break;
             }
         }
 
-        (void)xSemaphoreGive(bufferSemaphore);
+        OtaBlockRecovery_OnBlockHandled( staged );
     }
-    else
+
+    OtaBufferPool_GetStatistics( &poolStatistics );
+
+    if( ( poolStatistics.inUse == 0U ) && ( OtaBlockRecovery_TakeRequest() == true ) )
+    {
+        eventMsg.eventId = OtaAgentEventRequestTimer;
+
+        if( OTA_SignalEvent( &eventMsg ) == false )
+        {
+            OTA_LOG_WARN(OTA_LOG_MODULE_DATA, "Failed to signal an early block request.\n");
+        }
+    }
+}
+
+/*******************************************************************************
+ * Function Name: otaEventReceive()
+ *******************************************************************************
+ * Summary:
+ *  OS event receive hook of the OTA agent. The agent calls it once it has
+ *  handled the previous event, so the agent state is settled at this point.
+ *  Notifies the supervisor loop when the state changed, then waits for the
+ *  next event.
+ *
+ * Parameters:
+ *  pEventCtx:  OTA event queue context.
+ *  pEventMsg:  Buffer receiving the event message.
+ *  timeout:    Time to wait for an event.
+ *
+ * Return:
+ *  OtaOsSuccess on success, other error code on failure.
+ *
+ *******************************************************************************/
+OtaOsStatus_t otaEventReceive( OtaEventContext_t * pEventCtx,
+        void * pEventMsg,
+        uint32_t timeout )
+{
+    OtaState_t state = OTA_GetState();
+
+    if( state != lastAgentState )
     {
-        printf("Failed to get buffer semaphore\n");
+        lastAgentState = state;
+        (void) xEventGroupSetBits(otaDemoEventGroup, OTA_DEMO_EVENT_AGENT_STATE_CHANGE);
     }
 
-    return pFreeBuffer;
+    return cy_awsport_ota_event_receive( pEventCtx, pEventMsg, timeout );
 }
 
 /*******************************************************************************
@@ -1244,6 +2645,12 @@ void otaThread( void * arg )
     /* Calling OTA agent task. */
     OTA_EventProcessingTask( (void *)arg );
     printf("OTA Agent stopped.\n");
+
+    /* Wake up the supervisor loop. */
+    (void) xEventGroupSetBits(otaDemoEventGroup, OTA_DEMO_EVENT_SHUTDOWN);
+
+    /* The supervisor deletes this thread. */
+    vTaskSuspend(NULL);
 }
 
 /*******************************************************************************
@@ -1333,7 +2740,9 @@ cy_rslt_t establishConnection(void)
     connect_info.client_id_len = CLIENT_IDENTIFIER_LENGTH;
     connect_info.keep_alive_sec = OTA_MQTT_KEEP_ALIVE_INTERVAL_SECONDS;
     connect_info.will_info = NULL;
-    connect_info.clean_session = true;
+    connect_info.clean_session = ( OTA_MQTT_PERSISTENT_SESSION == 0U );
+
+    otaConnectionStatistics.connectAttempts++;
 
     result = cy_mqtt_connect( mqtthandle, &connect_info );
     if(result == CY_RSLT_SUCCESS)
@@ -1342,9 +2751,33 @@ cy_rslt_t establishConnection(void)
         printf("MQTT broker %.*s.\n", AWS_IOT_ENDPOINT_LENGTH, AWS_IOT_ENDPOINT);
         mqttSessionEstablished = true;
         result = CY_RSLT_SUCCESS;
+        RetryBackoff_Reset(&reconnectBackoff);
+
+        /* cy_mqtt does not report the session present flag of CONNACK, so
+         * every topic is subscribed again on the new connection. */
+        memset( companionSubscribedAhead, 0x00, sizeof( companionSubscribedAhead ) );
+        memset( companionUnsubscribedAhead, 0x00, sizeof( companionUnsubscribedAhead ) );
+
+        if( mqttReconnecting == true )
+        {
+            otaConnectionStatistics.lastReconnectMs =
+                    ( uint32_t ) ( xTaskGetTickCount() - mqttDisconnectTick ) * portTICK_PERIOD_MS;
+            if( otaConnectionStatistics.lastReconnectMs > otaConnectionStatistics.maxReconnectMs )
+            {
+                otaConnectionStatistics.maxReconnectMs = otaConnectionStatistics.lastReconnectMs;
+            }
+            printf("Reconnected %u ms after the disconnect.\n",
+                    (unsigned int)otaConnectionStatistics.lastReconnectMs);
+            OtaTelemetry_RecordReconnect();
+            mqttReconnecting = false;
+        }
+
+        /* Let the supervisor loop start or resume the OTA agent. */
+        (void) xEventGroupSetBits(otaDemoEventGroup, OTA_DEMO_EVENT_CONNECT_COMPLETE);
     }
     else
     {
+        otaConnectionStatistics.connectFailures++;
         printf("Failed to Establish MQTT Connection...\n");
         printf("MQTT broker %.*s.\n", AWS_IOT_ENDPOINT_LENGTH, AWS_IOT_ENDPOINT);
     }
@@ -1400,9 +2833,10 @@ void disconnect(void)
  *  incoming MQTT subscription messages from the MQTT broker.
  *      1. In case of MQTT disconnection, the MQTT client task is communicated
  *       about the disconnection using a message queue.
- *      2. When an MQTT subscription message is received, the subscriber callback
- *       function implemented in subscriber_task.c is invoked to handle the
- *       incoming MQTT message.
+ *      2. When an MQTT subscription message is received, it is queued for the
+ *       MQTT dispatcher task, which invokes the subscription callbacks to
+ *       handle the incoming MQTT message. The message is copied into an OTA
+ *       event buffer that is later loaned to the OTA agent as it is.
  *
  * Parameters:
  *  mqtt_handle:    MQTT handle corresponding to the MQTT event (unused)
@@ -1454,23 +2888,27 @@ void mqtt_event_cb( cy_mqtt_t mqtt_handle, cy_mqtt_event_t event, void *user_dat
             break;
         }
 
-        if( pdFALSE == xSemaphoreGive(mqtt_discon_Semaphore))
-        {
-            printf("Disconnect notification semaphore post failed..!!!\n");
-        }
+        OtaTelemetry_RecordDisconnect();
+        (void) xEventGroupSetBits(otaDemoEventGroup, OTA_DEMO_EVENT_DISCONNECT);
     }
     break;
 
     case CY_MQTT_EVENT_TYPE_SUBSCRIPTION_MESSAGE_RECEIVE :
         /* Received MQTT messages on subscribed topic. */
-        printf("\nEvent : Received MQTT subscribed message receive event.\n");
         received_msg = &(event.data.pub_msg.received_message);
-        printf("Incoming Publish Topic Name: %.*s\n", received_msg->topic_len,
-                received_msg->topic);
-        printf("Incoming Publish message Packet Id is %u.\n", event.data.pub_msg.packet_id);
-        printf("Incoming Publish message Payload length is %u.\n",
-                (uint16_t) received_msg->payload_len);
+        OTA_LOG_DEBUG(OTA_LOG_MODULE_MQTT, "Incoming Publish Topic Name: %.*s, Packet Id %u, "
+                "Payload length %u.\n", received_msg->topic_len, received_msg->topic,
+                (unsigned int)event.data.pub_msg.packet_id,
+                (unsigned int)received_msg->payload_len);
+#if ( MQTT_DISPATCHER_ENABLE == 1 )
+        if( MqttDispatcher_Post(mqtt_handle, received_msg) == false )
+        {
+            OTA_LOG_WARN(OTA_LOG_MODULE_MQTT, "Dropped incoming publish of %u bytes, "
+                    "no dispatch buffer free.\n", (unsigned int)received_msg->payload_len);
+        }
+#else
         SubscriptionManager_DispatchHandler(mqtt_handle, received_msg);
+#endif
         break;
 
     default :
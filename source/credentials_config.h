@@ -59,8 +59,12 @@
 /* MAX connection retries to join WI-FI AP */
 #define MAX_CONNECTION_RETRIES                  (10u)
 
-/* Wait between Wi-Fi connection retries */
+/* Wait between Wi-Fi connection retries. The wait grows exponentially with
+ * random jitter from WIFI_CONN_RETRY_DELAY_MS up to
+ * WIFI_CONN_RETRY_MAX_DELAY_MS.
+ */
 #define WIFI_CONN_RETRY_DELAY_MS                (500)
+#define WIFI_CONN_RETRY_MAX_DELAY_MS            (8000)
 
 /* AWS IoT thing name */
 #define CLIENT_IDENTIFIER                       "Enter you AWS IoT thing name here"
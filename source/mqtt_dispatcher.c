@@ -0,0 +1,414 @@
+/********************************************************************************
+ * File Name: mqtt_dispatcher.c
+ *
+ * Description: Implementation of the dispatcher that queues received MQTT
+ * messages and runs their subscription callbacks on a dedicated task.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <string.h>
+
+/* RTOS includes. */
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+
+/* Include header for the OTA event buffer pool. */
+#include "ota_buffer_pool.h"
+
+/* Include header for the MQTT dispatcher. */
+#include "mqtt_dispatcher.h"
+
+/* A received message held in an OTA event buffer. The payload is copied out
+ * of the network buffer of the MQTT library, which is reused as soon as the
+ * receive callback returns, with the topic name right behind it. */
+typedef struct MqttDispatcherMessage
+{
+    cy_mqtt_t handle;
+    cy_mqtt_received_msg_info_t publishInfo;
+    TickType_t queuedTick;
+    OtaEventData_t * pBuffer;
+} MqttDispatcherMessage_t;
+
+/* Messages by the pool index of their buffer. A message is owned by whoever
+ * owns its buffer: the receive thread while filling it, the dispatch queue,
+ * or the dispatcher task until the handler returns. */
+static MqttDispatcherMessage_t messages[ otaconfigMAX_NUM_OTA_DATA_BUFFERS ];
+
+/* Pool indices of the messages waiting to be dispatched. */
+static QueueHandle_t dispatchQueue = NULL;
+
+/* Dispatcher task and the message it is running the handler for. */
+static TaskHandle_t dispatcherTaskHandle = NULL;
+static MqttDispatcherMessage_t * pDispatchedMessage = NULL;
+
+/* Handler run for every message. */
+static MqttDispatcherHandler_t dispatchHandler = NULL;
+
+/* Statistics of the dispatch queue. */
+static MqttDispatcherStatistics_t dispatcherStatistics;
+
+
+/*******************************************************************************
+ * Function Name: dispatcherTask()
+ *******************************************************************************
+ * Summary:
+ *  Runs the handler for the queued messages in arrival order and returns
+ *  their buffers to the pool, unless the handler took the buffer over.
+ *
+ * Parameters:
+ *  pParam: Unused.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+static void dispatcherTask( void * pParam )
+{
+    MqttDispatcherMessage_t * pMessage;
+    uint32_t queueDelayMs;
+    uint8_t bufferIndex;
+
+    ( void ) pParam;
+
+    for( ;; )
+    {
+        if( xQueueReceive( dispatchQueue, &bufferIndex, portMAX_DELAY ) != pdTRUE )
+        {
+            continue;
+        }
+
+        pMessage = &messages[ bufferIndex ];
+        queueDelayMs = ( xTaskGetTickCount() - pMessage->queuedTick ) * portTICK_PERIOD_MS;
+
+        pDispatchedMessage = pMessage;
+        dispatchHandler( pMessage->handle, &pMessage->publishInfo );
+
+        if( pDispatchedMessage != NULL )
+        {
+            ( void ) OtaBufferPool_Free( pMessage->pBuffer );
+            pDispatchedMessage = NULL;
+        }
+
+        taskENTER_CRITICAL();
+        dispatcherStatistics.messagesDispatched++;
+        dispatcherStatistics.queueDepth--;
+        if( queueDelayMs > dispatcherStatistics.maxQueueDelayMs )
+        {
+            dispatcherStatistics.maxQueueDelayMs = queueDelayMs;
+        }
+        taskEXIT_CRITICAL();
+    }
+}
+
+/*******************************************************************************
+ * Function Name: MqttDispatcher_Init()
+ *******************************************************************************
+ * Summary:
+ *  Creates the dispatch queue and the dispatcher task. The messages are held
+ *  in OTA event buffers, so the buffer pool must be initialized before the
+ *  first message is posted.
+ *
+ * Parameters:
+ *  handler: Handler to run for every message.
+ *
+ * Return:
+ *  true on success, false otherwise.
+ *
+ *******************************************************************************/
+bool MqttDispatcher_Init( MqttDispatcherHandler_t handler )
+{
+    if( handler == NULL )
+    {
+        return false;
+    }
+
+    dispatchHandler = handler;
+    memset( &dispatcherStatistics, 0x00, sizeof( dispatcherStatistics ) );
+
+    dispatchQueue = xQueueCreate( MQTT_DISPATCHER_QUEUE_LENGTH, sizeof( uint8_t ) );
+
+    if( dispatchQueue == NULL )
+    {
+        return false;
+    }
+
+    return ( xTaskCreate( dispatcherTask, "MQTT DISPATCHER TASK",
+            MQTT_DISPATCHER_TASK_STACK_SIZE, NULL,
+            MQTT_DISPATCHER_TASK_PRIORITY, &dispatcherTaskHandle ) == pdPASS );
+}
+
+/*******************************************************************************
+ * Function Name: takeQueuedBuffer()
+ *******************************************************************************
+ * Summary:
+ *  Takes a buffer from the pool while the dispatch queue has room. Only the
+ *  receive thread adds to the queue, so the room cannot shrink in between.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  OtaEventData_t: the buffer, or NULL if the queue is full or the pool empty.
+ *
+ *******************************************************************************/
+static OtaEventData_t * takeQueuedBuffer( void )
+{
+    return ( uxQueueSpacesAvailable( dispatchQueue ) > 0U ) ? OtaBufferPool_Get() : NULL;
+}
+
+/*******************************************************************************
+ * Function Name: takeBuffer()
+ *******************************************************************************
+ * Summary:
+ *  Takes a buffer for an arriving message. When the dispatch queue is full or
+ *  the pool is empty the overflow policy decides whether the message is
+ *  dropped, the buffer of the oldest queued message is reused in its favour,
+ *  or the receive thread waits for a buffer.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  OtaEventData_t: the buffer, or NULL if the arriving message must be dropped.
+ *
+ *******************************************************************************/
+static OtaEventData_t * takeBuffer( void )
+{
+#if ( MQTT_DISPATCHER_OVERFLOW_POLICY == MQTT_DISPATCHER_DROP_OLDEST )
+    uint8_t bufferIndex;
+#elif ( MQTT_DISPATCHER_OVERFLOW_POLICY == MQTT_DISPATCHER_WAIT )
+    TickType_t waitStart;
+#endif
+    OtaEventData_t * pBuffer = takeQueuedBuffer();
+
+#if ( MQTT_DISPATCHER_OVERFLOW_POLICY == MQTT_DISPATCHER_DROP_OLDEST )
+    if( ( pBuffer == NULL ) && ( xQueueReceive( dispatchQueue, &bufferIndex, 0U ) == pdTRUE ) )
+    {
+        /* The buffer is reused for the arriving message, the depth is unchanged. */
+        taskENTER_CRITICAL();
+        dispatcherStatistics.messagesDropped++;
+        dispatcherStatistics.queueDepth--;
+        taskEXIT_CRITICAL();
+
+        pBuffer = messages[ bufferIndex ].pBuffer;
+    }
+#elif ( MQTT_DISPATCHER_OVERFLOW_POLICY == MQTT_DISPATCHER_WAIT )
+    if( pBuffer == NULL )
+    {
+        /* Buffers come back from the dispatcher task and the OTA agent, poll
+         * the pool once per tick. */
+        waitStart = xTaskGetTickCount();
+        while( ( pBuffer == NULL ) &&
+                ( ( xTaskGetTickCount() - waitStart ) < pdMS_TO_TICKS( MQTT_DISPATCHER_WAIT_MS ) ) )
+        {
+            vTaskDelay( 1U );
+            pBuffer = takeQueuedBuffer();
+        }
+
+        taskENTER_CRITICAL();
+        dispatcherStatistics.overflowWaitMs += ( xTaskGetTickCount() - waitStart ) * portTICK_PERIOD_MS;
+        taskEXIT_CRITICAL();
+    }
+#endif
+
+    if( pBuffer == NULL )
+    {
+        taskENTER_CRITICAL();
+        dispatcherStatistics.messagesDropped++;
+        taskEXIT_CRITICAL();
+    }
+
+    return pBuffer;
+}
+
+/*******************************************************************************
+ * Function Name: MqttDispatcher_Post()
+ *******************************************************************************
+ * Summary:
+ *  Copies a received message into an OTA event buffer and puts the pool index
+ *  of the buffer on the dispatch queue. Called from the receive callback of
+ *  the MQTT library, which returns right away to keep draining the socket and
+ *  handling keep-alives; the handler runs later on the dispatcher task. This
+ *  is the only copy of the payload, the handler can loan the buffer to the
+ *  OTA agent as it is through MqttDispatcher_TakeBuffer().
+ *
+ * Parameters:
+ *  handle:         MQTT connection handle.
+ *  pPublishInfo:   Received message.
+ *
+ * Return:
+ *  true if the message was queued, false if it was dropped.
+ *
+ *******************************************************************************/
+bool MqttDispatcher_Post( cy_mqtt_t handle,
+        const cy_mqtt_received_msg_info_t * pPublishInfo )
+{
+    MqttDispatcherMessage_t * pMessage;
+    OtaEventData_t * pBuffer;
+    uint8_t bufferIndex;
+
+    if( ( pPublishInfo == NULL ) || ( dispatchQueue == NULL ) )
+    {
+        return false;
+    }
+
+    if( ( pPublishInfo->payload_len + pPublishInfo->topic_len ) > sizeof( pBuffer->data ) )
+    {
+        taskENTER_CRITICAL();
+        dispatcherStatistics.messagesOversized++;
+        taskEXIT_CRITICAL();
+
+        return false;
+    }
+
+    if( ( pBuffer = takeBuffer() ) == NULL )
+    {
+        return false;
+    }
+
+    bufferIndex = ( uint8_t ) OtaBufferPool_GetIndex( pBuffer );
+    pMessage = &messages[ bufferIndex ];
+    pMessage->handle = handle;
+    pMessage->publishInfo = *pPublishInfo;
+    pMessage->queuedTick = xTaskGetTickCount();
+    pMessage->pBuffer = pBuffer;
+
+    memcpy( pBuffer->data, pPublishInfo->payload, pPublishInfo->payload_len );
+    memcpy( &pBuffer->data[ pPublishInfo->payload_len ], pPublishInfo->topic, pPublishInfo->topic_len );
+    pBuffer->dataLength = pPublishInfo->payload_len;
+    pMessage->publishInfo.payload = ( const char * ) pBuffer->data;
+    pMessage->publishInfo.topic = ( const char * ) &pBuffer->data[ pPublishInfo->payload_len ];
+
+    taskENTER_CRITICAL();
+    dispatcherStatistics.messagesQueued++;
+    dispatcherStatistics.bytesCopied += pPublishInfo->payload_len;
+    dispatcherStatistics.queueDepth++;
+    if( dispatcherStatistics.queueDepth > dispatcherStatistics.queueHighWaterMark )
+    {
+        dispatcherStatistics.queueHighWaterMark = dispatcherStatistics.queueDepth;
+    }
+    taskEXIT_CRITICAL();
+
+    /* Room was checked when the buffer was taken, so this never waits. */
+    ( void ) xQueueSendToBack( dispatchQueue, &bufferIndex, 0U );
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: MqttDispatcher_TakeBuffer()
+ *******************************************************************************
+ * Summary:
+ *  Takes over the OTA event buffer of the message being dispatched, so that
+ *  the handler can loan it to the OTA agent without copying the payload
+ *  again. The dispatcher task then no longer returns the buffer to the pool.
+ *  Only the handler running on the dispatcher task gets the buffer, and only
+ *  for a payload starting at the beginning of the buffer; the handler may
+ *  have rewritten the payload in place.
+ *
+ * Parameters:
+ *  pPayload:   Payload the handler is about to loan.
+ *
+ * Return:
+ *  OtaEventData_t: the buffer holding the payload, NULL if the payload is
+ *  not the one of the dispatched message or the buffer was already taken.
+ *
+ *******************************************************************************/
+OtaEventData_t * MqttDispatcher_TakeBuffer( const char * pPayload )
+{
+    OtaEventData_t * pBuffer = NULL;
+
+    if( ( xTaskGetCurrentTaskHandle() == dispatcherTaskHandle ) &&
+            ( pDispatchedMessage != NULL ) &&
+            ( pPayload == ( const char * ) pDispatchedMessage->pBuffer->data ) )
+    {
+        pBuffer = pDispatchedMessage->pBuffer;
+        pDispatchedMessage = NULL;
+    }
+
+    return pBuffer;
+}
+
+/*******************************************************************************
+ * Function Name: MqttDispatcher_GetStatistics()
+ *******************************************************************************
+ * Summary:
+ *  Returns a snapshot of the dispatch queue statistics.
+ *
+ * Parameters:
+ *  pStatistics: Pointer to the structure receiving the statistics.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void MqttDispatcher_GetStatistics( MqttDispatcherStatistics_t * pStatistics )
+{
+    if( pStatistics != NULL )
+    {
+        taskENTER_CRITICAL();
+        *pStatistics = dispatcherStatistics;
+        taskEXIT_CRITICAL();
+    }
+}
+
+/*******************************************************************************
+ * Function Name: MqttDispatcher_ResetStatistics()
+ *******************************************************************************
+ * Summary:
+ *  Clears the counters at the end of a job. The current queue depth is kept
+ *  and becomes the new high-water mark.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void MqttDispatcher_ResetStatistics( void )
+{
+    uint32_t queueDepth;
+
+    taskENTER_CRITICAL();
+    queueDepth = dispatcherStatistics.queueDepth;
+    memset( &dispatcherStatistics, 0x00, sizeof( dispatcherStatistics ) );
+    dispatcherStatistics.queueDepth = queueDepth;
+    dispatcherStatistics.queueHighWaterMark = queueDepth;
+    taskEXIT_CRITICAL();
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,130 @@
+/********************************************************************************
+ * File Name: mqtt_dispatcher.h
+ *
+ * Description: Public API of the dispatcher that runs the subscription callbacks
+ * of received MQTT messages on a dedicated task.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef MQTT_DISPATCHER_H_
+#define MQTT_DISPATCHER_H_
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* MQTT include. */
+#include "cy_mqtt_api.h"
+
+/* OTA Library include. */
+#include "ota.h"
+
+
+
+/* Set to 1 to run the subscription callbacks on the dispatcher task instead
+ * of the receive thread of the MQTT library. */
+#ifndef MQTT_DISPATCHER_ENABLE
+#define MQTT_DISPATCHER_ENABLE              (1)
+#endif
+
+/* Overflow policies, applied when a message arrives while the dispatch queue
+ * is full or no OTA event buffer is free. Received messages are held in the
+ * buffers of the OTA event buffer pool, the queue only carries their pool
+ * indices. */
+#define MQTT_DISPATCHER_DROP_NEWEST         (0)     /* Drop the arriving message. */
+#define MQTT_DISPATCHER_DROP_OLDEST         (1)     /* Drop the oldest queued message. */
+#define MQTT_DISPATCHER_WAIT                (2)     /* Wait up to MQTT_DISPATCHER_WAIT_MS for a buffer. */
+
+#ifndef MQTT_DISPATCHER_OVERFLOW_POLICY
+#define MQTT_DISPATCHER_OVERFLOW_POLICY     MQTT_DISPATCHER_DROP_NEWEST
+#endif
+
+/* Longest time the receive thread waits for a buffer with the wait policy. */
+#ifndef MQTT_DISPATCHER_WAIT_MS
+#define MQTT_DISPATCHER_WAIT_MS             (100U)
+#endif
+
+/* Number of messages that can wait for the dispatcher task. */
+#ifndef MQTT_DISPATCHER_QUEUE_LENGTH
+#define MQTT_DISPATCHER_QUEUE_LENGTH        (3U)
+#endif
+
+#ifndef MQTT_DISPATCHER_TASK_STACK_SIZE
+#define MQTT_DISPATCHER_TASK_STACK_SIZE     (1024U * 4U)
+#endif
+
+#ifndef MQTT_DISPATCHER_TASK_PRIORITY
+#define MQTT_DISPATCHER_TASK_PRIORITY       (configMAX_PRIORITIES - 3)
+#endif
+
+#if ( MQTT_DISPATCHER_OVERFLOW_POLICY < MQTT_DISPATCHER_DROP_NEWEST ) || \
+    ( MQTT_DISPATCHER_OVERFLOW_POLICY > MQTT_DISPATCHER_WAIT )
+#error "MQTT_DISPATCHER_OVERFLOW_POLICY must be one of the MQTT_DISPATCHER_DROP_NEWEST, _DROP_OLDEST and _WAIT policies."
+#endif
+
+/* Handler run by the dispatcher task for every queued message. */
+typedef void (* MqttDispatcherHandler_t )( cy_mqtt_t handle,
+        cy_mqtt_received_msg_info_t * pPublishInfo );
+
+/* Statistics of the dispatch queue. */
+typedef struct MqttDispatcherStatistics
+{
+    uint32_t messagesQueued;        /* Messages put on the dispatch queue. */
+    uint32_t messagesDispatched;    /* Messages handed to the handler. */
+    uint32_t messagesDropped;       /* Messages dropped by the overflow policy. */
+    uint32_t messagesOversized;     /* Messages larger than an OTA event buffer. */
+    uint32_t bytesCopied;           /* Payload bytes copied out of the network buffer. */
+    uint32_t queueDepth;            /* Messages queued or being dispatched. */
+    uint32_t queueHighWaterMark;    /* Largest queue depth. */
+    uint32_t maxQueueDelayMs;       /* Longest time a message waited for the handler. */
+    uint32_t overflowWaitMs;        /* Time the receive thread waited with the wait policy. */
+} MqttDispatcherStatistics_t;
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+bool MqttDispatcher_Init( MqttDispatcherHandler_t handler );
+
+bool MqttDispatcher_Post( cy_mqtt_t handle,
+        const cy_mqtt_received_msg_info_t * pPublishInfo );
+
+OtaEventData_t * MqttDispatcher_TakeBuffer( const char * pPayload );
+
+void MqttDispatcher_GetStatistics( MqttDispatcherStatistics_t * pStatistics );
+
+void MqttDispatcher_ResetStatistics( void );
+
+
+#endif /* ifndef MQTT_DISPATCHER_H_ */
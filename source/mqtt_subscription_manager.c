@@ -45,28 +45,507 @@
 #include "mqtt_subscription_manager.h"
 
 /**
- * @brief Represents a registered record of the topic filter and its associated callback
- * in the subscription manager registry.
+ * @brief The default value for the maximum size of the callback registry in the
+ * subscription manager.
+ */
+#ifndef MAX_SUBSCRIPTION_CALLBACK_RECORDS
+#define MAX_SUBSCRIPTION_CALLBACK_RECORDS    5
+#endif
+
+/**
+ * @brief The default number of topic levels that can be stored in the topic
+ * filter trie. Every distinct level of every registered topic filter takes one
+ * node; levels shared by several filters (e.g. "$aws/things/+/") are stored once.
  */
-typedef struct SubscriptionManagerRecord
+#ifndef MAX_SUBSCRIPTION_TRIE_NODES
+#define MAX_SUBSCRIPTION_TRIE_NODES          ( MAX_SUBSCRIPTION_CALLBACK_RECORDS * 8 )
+#endif
+
+/* Topic level separator and wildcard characters. */
+#define TOPIC_LEVEL_SEPARATOR                '/'
+#define TOPIC_WILDCARD_SINGLE_LEVEL          '+'
+#define TOPIC_WILDCARD_MULTI_LEVEL           '#'
+
+/**
+ * @brief A node of the topic filter trie. Each node represents one level of
+ * one or more registered topic filters.
+ *
+ * Literal children of a node are kept in a sibling list, while the single-level
+ * ('+') and multi-level ('#') wildcard children are held in dedicated slots so
+ * that a dispatch only visits the branches that can match the incoming topic.
+ * A node terminates a registered topic filter when its callback is set.
+ */
+typedef struct SubscriptionTrieNode
 {
+    const char * pLevel;            /* Points into a registered topic filter reaching this node. */
+    uint16_t levelLength;
+    struct SubscriptionTrieNode * pParent;
+    struct SubscriptionTrieNode * pFirstChild;
+    struct SubscriptionTrieNode * pNextSibling;
+    struct SubscriptionTrieNode * pPlusChild;
+    struct SubscriptionTrieNode * pHashChild;
     const char * pTopicFilter;
     uint16_t topicFilterLength;
     SubscriptionManagerCallback_t callback;
-} SubscriptionManagerRecord_t;
+} SubscriptionTrieNode_t;
 
 /**
- * @brief The default value for the maximum size of the callback registry in the
- * subscription manager.
+ * @brief The node storage of the topic filter trie. Unused nodes are chained
+ * through their sibling pointer into a free list.
  */
-#ifndef MAX_SUBSCRIPTION_CALLBACK_RECORDS
-#define MAX_SUBSCRIPTION_CALLBACK_RECORDS    5
-#endif
+static SubscriptionTrieNode_t trieNodePool[ MAX_SUBSCRIPTION_TRIE_NODES ];
 
 /**
- * @brief The registry to store records of topic filters and their subscription callbacks.
+ * @brief The root of the topic filter trie. The root does not represent a level.
  */
-static SubscriptionManagerRecord_t callbackRecordList[ MAX_SUBSCRIPTION_CALLBACK_RECORDS ] = { 0 };
+static SubscriptionTrieNode_t trieRoot;
+
+/**
+ * @brief Head of the free list of trie nodes.
+ */
+static SubscriptionTrieNode_t * pFreeNodeList = NULL;
+
+/**
+ * @brief Flag indicating that the free list has been built.
+ */
+static bool trieInitialized = false;
+
+/**
+ * @brief Number of topic filters currently registered.
+ */
+static size_t registeredRecordCount = 0u;
+
+
+/*******************************************************************************
+ * Function Name: trieInit()
+ *******************************************************************************
+ * Summary:
+ * Builds the free list of trie nodes on first use.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+static void trieInit( void )
+{
+    size_t index;
+
+    if( trieInitialized == false )
+    {
+        memset( &trieRoot, 0x00, sizeof( trieRoot ) );
+        memset( trieNodePool, 0x00, sizeof( trieNodePool ) );
+
+        for( index = 0u; index < MAX_SUBSCRIPTION_TRIE_NODES; index++ )
+        {
+            trieNodePool[ index ].pNextSibling = pFreeNodeList;
+            pFreeNodeList = &trieNodePool[ index ];
+        }
+
+        trieInitialized = true;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: trieNodeAlloc()
+ *******************************************************************************
+ * Summary:
+ * Takes a node from the free list and links it under the given parent.
+ *
+ * Parameters:
+ *  pParent: The parent node of the new node.
+ *  pLevel: The topic level represented by the new node.
+ *  levelLength: The length of the topic level.
+ *
+ * Return:
+ *  Pointer to the new node, or NULL if the node pool is exhausted.
+ *
+ *******************************************************************************/
+static SubscriptionTrieNode_t * trieNodeAlloc( SubscriptionTrieNode_t * pParent,
+        const char * pLevel,
+        uint16_t levelLength )
+{
+    SubscriptionTrieNode_t * pNode = pFreeNodeList;
+
+    if( pNode != NULL )
+    {
+        pFreeNodeList = pNode->pNextSibling;
+        memset( pNode, 0x00, sizeof( SubscriptionTrieNode_t ) );
+
+        pNode->pLevel = pLevel;
+        pNode->levelLength = levelLength;
+        pNode->pParent = pParent;
+
+        if( ( levelLength == 1u ) && ( pLevel[ 0 ] == TOPIC_WILDCARD_SINGLE_LEVEL ) )
+        {
+            pParent->pPlusChild = pNode;
+        }
+        else if( ( levelLength == 1u ) && ( pLevel[ 0 ] == TOPIC_WILDCARD_MULTI_LEVEL ) )
+        {
+            pParent->pHashChild = pNode;
+        }
+        else
+        {
+            pNode->pNextSibling = pParent->pFirstChild;
+            pParent->pFirstChild = pNode;
+        }
+    }
+
+    return pNode;
+}
+
+
+/*******************************************************************************
+ * Function Name: trieFindChild()
+ *******************************************************************************
+ * Summary:
+ * Finds the child of a node that represents exactly the given filter level.
+ * Wildcard levels resolve to the dedicated wildcard slots of the node.
+ *
+ * Parameters:
+ *  pParent: The node whose children are searched.
+ *  pLevel: The topic filter level to look for.
+ *  levelLength: The length of the topic filter level.
+ *
+ * Return:
+ *  Pointer to the child node, or NULL if there is none.
+ *
+ *******************************************************************************/
+static SubscriptionTrieNode_t * trieFindChild( const SubscriptionTrieNode_t * pParent,
+        const char * pLevel,
+        uint16_t levelLength )
+{
+    SubscriptionTrieNode_t * pChild = NULL;
+
+    if( ( levelLength == 1u ) && ( pLevel[ 0 ] == TOPIC_WILDCARD_SINGLE_LEVEL ) )
+    {
+        pChild = pParent->pPlusChild;
+    }
+    else if( ( levelLength == 1u ) && ( pLevel[ 0 ] == TOPIC_WILDCARD_MULTI_LEVEL ) )
+    {
+        pChild = pParent->pHashChild;
+    }
+    else
+    {
+        for( pChild = pParent->pFirstChild; pChild != NULL; pChild = pChild->pNextSibling )
+        {
+            if( ( pChild->levelLength == levelLength ) &&
+                    ( memcmp( pChild->pLevel, pLevel, levelLength ) == 0 ) )
+            {
+                break;
+            }
+        }
+    }
+
+    return pChild;
+}
+
+
+/*******************************************************************************
+ * Function Name: triePrune()
+ *******************************************************************************
+ * Summary:
+ * Returns unused nodes to the free list, starting at the given node and walking
+ * up towards the root while the visited nodes neither terminate a topic filter
+ * nor have any children.
+ *
+ * Parameters:
+ *  pNode: The deepest node to consider for removal.
+ *
+ * Return:
+ *  The deepest node left in the trie on the path to the root.
+ *
+ *******************************************************************************/
+static SubscriptionTrieNode_t * triePrune( SubscriptionTrieNode_t * pNode )
+{
+    SubscriptionTrieNode_t * pParent;
+    SubscriptionTrieNode_t ** ppLink;
+
+    while( ( pNode != NULL ) && ( pNode != &trieRoot ) &&
+            ( pNode->callback == NULL ) && ( pNode->pFirstChild == NULL ) &&
+            ( pNode->pPlusChild == NULL ) && ( pNode->pHashChild == NULL ) )
+    {
+        pParent = pNode->pParent;
+
+        if( pParent->pPlusChild == pNode )
+        {
+            pParent->pPlusChild = NULL;
+        }
+        else if( pParent->pHashChild == pNode )
+        {
+            pParent->pHashChild = NULL;
+        }
+        else
+        {
+            /* Unlink the node from the sibling list of its parent. */
+            for( ppLink = &pParent->pFirstChild; *ppLink != NULL; ppLink = &( *ppLink )->pNextSibling )
+            {
+                if( *ppLink == pNode )
+                {
+                    *ppLink = pNode->pNextSibling;
+                    break;
+                }
+            }
+        }
+
+        pNode->pNextSibling = pFreeNodeList;
+        pFreeNodeList = pNode;
+
+        pNode = pParent;
+    }
+
+    return pNode;
+}
+
+
+/*******************************************************************************
+ * Function Name: trieRebaseLevels()
+ *******************************************************************************
+ * Summary:
+ * Nodes do not copy their level, they point into the topic filter of the
+ * registrant that created them. When that registrant is removed, the nodes it
+ * shares with other topic filters are pointed at the same level of a topic
+ * filter still registered below them, so that they never refer to the memory
+ * of the removed filter.
+ *
+ * Parameters:
+ *  pNode: The deepest node left in the trie on the path of the removed filter.
+ *  pOldFilter: The topic filter of the removed registrant.
+ *  oldFilterLength: The length of the removed topic filter.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+static void trieRebaseLevels( SubscriptionTrieNode_t * pNode,
+        const char * pOldFilter,
+        uint16_t oldFilterLength )
+{
+    SubscriptionTrieNode_t * pRegistered;
+
+    for( ; ( pNode != NULL ) && ( pNode != &trieRoot ); pNode = pNode->pParent )
+    {
+        if( ( pNode->pLevel < pOldFilter ) || ( pNode->pLevel >= &pOldFilter[ oldFilterLength ] ) )
+        {
+            continue;
+        }
+
+        /* Every node left in the trie leads to a registered topic filter, and
+         * the level sits at the same offset in all filters passing the node. */
+        pRegistered = pNode;
+        while( pRegistered->callback == NULL )
+        {
+            if( pRegistered->pFirstChild != NULL )
+            {
+                pRegistered = pRegistered->pFirstChild;
+            }
+            else if( pRegistered->pPlusChild != NULL )
+            {
+                pRegistered = pRegistered->pPlusChild;
+            }
+            else
+            {
+                pRegistered = pRegistered->pHashChild;
+            }
+        }
+
+        pNode->pLevel = &pRegistered->pTopicFilter[ pNode->pLevel - pOldFilter ];
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: isValidTopicFilter()
+ *******************************************************************************
+ * Summary:
+ * Checks that wildcard characters in a topic filter occupy a whole level and
+ * that the multi-level wildcard only appears as the last level.
+ *
+ * Parameters:
+ *  pTopicFilter: The topic filter to validate.
+ *  topicFilterLength: The length of the topic filter string.
+ *
+ * Return:
+ *  true if the topic filter is well formed, false otherwise.
+ *
+ *******************************************************************************/
+static bool isValidTopicFilter( const char * pTopicFilter,
+        uint16_t topicFilterLength )
+{
+    bool isValid = true;
+    uint16_t index;
+
+    for( index = 0u; ( index < topicFilterLength ) && ( isValid == true ); index++ )
+    {
+        if( ( pTopicFilter[ index ] == TOPIC_WILDCARD_SINGLE_LEVEL ) ||
+                ( pTopicFilter[ index ] == TOPIC_WILDCARD_MULTI_LEVEL ) )
+        {
+            /* The wildcard must be preceded and followed by a level separator
+             * or by the start/end of the filter. */
+            if( ( ( index > 0u ) && ( pTopicFilter[ index - 1u ] != TOPIC_LEVEL_SEPARATOR ) ) ||
+                    ( ( ( index + 1u ) < topicFilterLength ) &&
+                            ( pTopicFilter[ index + 1u ] != TOPIC_LEVEL_SEPARATOR ) ) )
+            {
+                isValid = false;
+            }
+
+            /* The multi-level wildcard must be the last character. */
+            if( ( pTopicFilter[ index ] == TOPIC_WILDCARD_MULTI_LEVEL ) &&
+                    ( ( index + 1u ) != topicFilterLength ) )
+            {
+                isValid = false;
+            }
+        }
+    }
+
+    return isValid;
+}
+
+
+/*******************************************************************************
+ * Function Name: nextLevelLength()
+ *******************************************************************************
+ * Summary:
+ * Returns the length of the topic level starting at the given position.
+ *
+ * Parameters:
+ *  pTopic: The topic name or filter.
+ *  topicLength: The length of the topic string.
+ *  start: The position at which the level starts.
+ *
+ * Return:
+ *  The number of characters up to the next level separator or the end of the topic.
+ *
+ *******************************************************************************/
+static uint16_t nextLevelLength( const char * pTopic,
+        uint16_t topicLength,
+        uint16_t start )
+{
+    uint16_t end = start;
+
+    while( ( end < topicLength ) && ( pTopic[ end ] != TOPIC_LEVEL_SEPARATOR ) )
+    {
+        end++;
+    }
+
+    return ( uint16_t ) ( end - start );
+}
+
+
+/*******************************************************************************
+ * Function Name: invokeNodeCallback()
+ *******************************************************************************
+ * Summary:
+ * Invokes the callback registered on a trie node, if any.
+ *
+ * Parameters:
+ *  pNode: The trie node matching the incoming topic.
+ *  handle: The handle associated with the MQTT connection.
+ *  pPublishInfo: The incoming PUBLISH message information.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+static void invokeNodeCallback( const SubscriptionTrieNode_t * pNode,
+        cy_mqtt_t handle,
+        cy_mqtt_received_msg_info_t * pPublishInfo )
+{
+    if( ( pNode != NULL ) && ( pNode->callback != NULL ) )
+    {
+        LogInfo( ( "Invoking subscription callback of matching topic filter: "
+                "TopicFilter=%.*s, TopicName=%.*s",
+                pNode->topicFilterLength,
+                pNode->pTopicFilter,
+                pPublishInfo->topic_len,
+                pPublishInfo->topic ) );
+
+        /* Invoke the callback associated with the record as the topics match. */
+        pNode->callback( handle, pPublishInfo );
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: trieDispatch()
+ *******************************************************************************
+ * Summary:
+ * Walks the trie level by level along the incoming topic name and invokes the
+ * callbacks of all topic filters matching the topic. Only the literal child
+ * equal to the current topic level and the wildcard children are followed, so
+ * the cost depends on the depth of the topic rather than the number of
+ * registered filters.
+ *
+ * Parameters:
+ *  pNode: The trie node matching the topic levels consumed so far.
+ *  levelStart: Position of the next topic level in the topic name.
+ *  handle: The handle associated with the MQTT connection.
+ *  pPublishInfo: The incoming PUBLISH message information.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+static void trieDispatch( const SubscriptionTrieNode_t * pNode,
+        uint16_t levelStart,
+        cy_mqtt_t handle,
+        cy_mqtt_received_msg_info_t * pPublishInfo )
+{
+    const char * pTopic = pPublishInfo->topic;
+    uint16_t topicLength = ( uint16_t ) pPublishInfo->topic_len;
+    uint16_t levelLength;
+    uint16_t nextStart;
+    bool isLastLevel;
+    const SubscriptionTrieNode_t * pChild;
+
+    levelLength = nextLevelLength( pTopic, topicLength, levelStart );
+    nextStart = ( uint16_t ) ( levelStart + levelLength + 1u );
+    isLastLevel = ( ( levelStart + levelLength ) >= topicLength );
+
+    /* Topics starting with '$' are not matched by wildcards in the first level. */
+    if( ( pNode != &trieRoot ) || ( pTopic[ 0 ] != '$' ) )
+    {
+        /* A multi-level wildcard matches this level and everything below it. */
+        invokeNodeCallback( pNode->pHashChild, handle, pPublishInfo );
+
+        if( pNode->pPlusChild != NULL )
+        {
+            if( isLastLevel == true )
+            {
+                invokeNodeCallback( pNode->pPlusChild, handle, pPublishInfo );
+
+                /* "a/+/#" also matches "a/b". */
+                invokeNodeCallback( pNode->pPlusChild->pHashChild, handle, pPublishInfo );
+            }
+            else
+            {
+                trieDispatch( pNode->pPlusChild, nextStart, handle, pPublishInfo );
+            }
+        }
+    }
+
+    for( pChild = pNode->pFirstChild; pChild != NULL; pChild = pChild->pNextSibling )
+    {
+        if( ( pChild->levelLength == levelLength ) &&
+                ( memcmp( pChild->pLevel, &pTopic[ levelStart ], levelLength ) == 0 ) )
+        {
+            if( isLastLevel == true )
+            {
+                invokeNodeCallback( pChild, handle, pPublishInfo );
+
+                /* "a/b/#" also matches "a/b". */
+                invokeNodeCallback( pChild->pHashChild, handle, pPublishInfo );
+            }
+            else
+            {
+                trieDispatch( pChild, nextStart, handle, pPublishInfo );
+            }
+
+            /* Literal siblings are unique, no other sibling can match. */
+            break;
+        }
+    }
+}
 
 
 /*******************************************************************************
@@ -88,33 +567,14 @@ static SubscriptionManagerRecord_t callbackRecordList[ MAX_SUBSCRIPTION_CALLBACK
 void SubscriptionManager_DispatchHandler( cy_mqtt_t handle,
         cy_mqtt_received_msg_info_t * pPublishInfo )
 {
-    bool matchStatus = false;
-    size_t listIndex = 0u;
-
     assert( pPublishInfo != NULL );
     assert( handle != NULL );
 
-    /* Iterate through record list to find matching topics, and invoke their callbacks. */
-    for( listIndex = 0; listIndex < MAX_SUBSCRIPTION_CALLBACK_RECORDS; listIndex++ )
+    if( ( trieInitialized == true ) && ( pPublishInfo->topic != NULL ) &&
+            ( pPublishInfo->topic_len != 0u ) )
     {
-        if( ( callbackRecordList[ listIndex ].pTopicFilter != NULL ) &&
-                ( MQTT_MatchTopic( pPublishInfo->topic,
-                        pPublishInfo->topic_len,
-                        callbackRecordList[ listIndex ].pTopicFilter,
-                        callbackRecordList[ listIndex ].topicFilterLength,
-                        &matchStatus ) == MQTTSuccess ) &&
-                        ( matchStatus == true ) )
-        {
-            LogInfo( ( "Invoking subscription callback of matching topic filter: "
-                    "TopicFilter=%.*s, TopicName=%.*s",
-                    callbackRecordList[ listIndex ].topicFilterLength,
-                    callbackRecordList[ listIndex ].pTopicFilter,
-                    pPublishInfo->topic,
-                    pPublishInfo->topic_len ) );
-
-            /* Invoke the callback associated with the record as the topics match. */
-            callbackRecordList[ listIndex ].callback( handle, pPublishInfo );
-        }
+        /* Walk the topic filter trie to find matching topics, and invoke their callbacks. */
+        trieDispatch( &trieRoot, 0u, handle, pPublishInfo );
     }
 }
 
@@ -127,7 +587,8 @@ void SubscriptionManager_DispatchHandler( cy_mqtt_t handle,
  *
  * The callback will be invoked when an incoming PUBLISH message is received on
  * a topic that matches the topic filter, @a pTopicFilter. The subscription manager
- * accepts wildcard topic filters.
+ * accepts wildcard topic filters. The topic filter string is referenced by the
+ * registry and must remain valid until the callback is removed.
  *
  * Parameters:
  *  pTopicFilter: The topic filter to register the callback for.
@@ -135,7 +596,8 @@ void SubscriptionManager_DispatchHandler( cy_mqtt_t handle,
  *  callback: The callback to be registered for the topic filter.
  *
  * Return:
- *  void
+ *  SubscriptionManagerStatus_t: SUBSCRIPTION_MANAGER_SUCCESS on success, error
+ *  status otherwise.
  *
  *******************************************************************************/
 SubscriptionManagerStatus_t SubscriptionManager_RegisterCallback( const char * pTopicFilter,
@@ -146,44 +608,22 @@ SubscriptionManagerStatus_t SubscriptionManager_RegisterCallback( const char * p
     assert( topicFilterLength != 0 );
     assert( callback != NULL );
 
-    SubscriptionManagerStatus_t returnStatus;
-    size_t availableIndex = MAX_SUBSCRIPTION_CALLBACK_RECORDS;
-    bool recordExists = false;
-    size_t index = 0u;
+    SubscriptionManagerStatus_t returnStatus = SUBSCRIPTION_MANAGER_SUCCESS;
+    SubscriptionTrieNode_t * pNode = &trieRoot;
+    SubscriptionTrieNode_t * pChild = NULL;
+    uint16_t levelStart = 0u;
+    uint16_t levelLength = 0u;
 
-    /* Search for the first available spot in the list to store the record, and also check if
-     * a record for the topic filter already exists. */
-    while( ( recordExists == false ) && ( index < MAX_SUBSCRIPTION_CALLBACK_RECORDS ) )
-    {
-        /* Check if the index represents an empty spot in the registry. If we had already
-         * found an empty spot in the list, we will not update it. */
-        if( ( availableIndex == MAX_SUBSCRIPTION_CALLBACK_RECORDS ) &&
-                ( callbackRecordList[ index ].pTopicFilter == NULL ) )
-        {
-            availableIndex = index;
-        }
-
-        /* Check if the current record's topic filter in the registry matches the topic filter
-         * we are trying to register. */
-        else if( ( callbackRecordList[ index ].topicFilterLength == topicFilterLength ) &&
-                ( strncmp( pTopicFilter, callbackRecordList[ index ].pTopicFilter,
-                        topicFilterLength ) == 0 ) )
-        {
-            recordExists = true;
-        }
+    trieInit();
 
-        index++;
-    }
-
-    if( recordExists == true )
+    if( isValidTopicFilter( pTopicFilter, topicFilterLength ) == false )
     {
-        /* The record for the topic filter already exists. */
-        LogError( ( "Failed to register callback: Record for topic filter "
-                "already exists: TopicFilter=%.*s", topicFilterLength, pTopicFilter ) );
+        LogError( ( "Failed to register callback: Invalid topic filter: "
+                "TopicFilter=%.*s", topicFilterLength, pTopicFilter ) );
 
-        returnStatus = SUBSCRIPTION_MANAGER_RECORD_EXISTS;
+        returnStatus = SUBSCRIPTION_MANAGER_INVALID_FILTER;
     }
-    else if( availableIndex == MAX_SUBSCRIPTION_CALLBACK_RECORDS )
+    else if( registeredRecordCount >= MAX_SUBSCRIPTION_CALLBACK_RECORDS )
     {
         /* The registry is full. */
         LogError( ( "Unable to register callback: Registry list is full: "
@@ -194,15 +634,57 @@ SubscriptionManagerStatus_t SubscriptionManager_RegisterCallback( const char * p
     }
     else
     {
-        callbackRecordList[ availableIndex ].pTopicFilter = pTopicFilter;
-        callbackRecordList[ availableIndex ].topicFilterLength = topicFilterLength;
-        callbackRecordList[ availableIndex ].callback = callback;
+        /* Walk down the trie one level at a time, creating the missing levels. */
+        while( ( levelStart <= topicFilterLength ) && ( returnStatus == SUBSCRIPTION_MANAGER_SUCCESS ) )
+        {
+            levelLength = nextLevelLength( pTopicFilter, topicFilterLength, levelStart );
 
-        returnStatus = SUBSCRIPTION_MANAGER_SUCCESS;
+            pChild = trieFindChild( pNode, &pTopicFilter[ levelStart ], levelLength );
+            if( pChild == NULL )
+            {
+                pChild = trieNodeAlloc( pNode, &pTopicFilter[ levelStart ], levelLength );
+            }
 
-        LogDebug( ( "Added callback to registry: TopicFilter=%.*s",
-                topicFilterLength,
-                pTopicFilter ) );
+            if( pChild == NULL )
+            {
+                LogError( ( "Unable to register callback: Topic filter trie is full: "
+                        "TopicFilter=%.*s, MaxTrieNodes=%u", topicFilterLength,
+                        pTopicFilter, MAX_SUBSCRIPTION_TRIE_NODES ) );
+
+                /* Release the levels created for this topic filter. */
+                ( void ) triePrune( pNode );
+                returnStatus = SUBSCRIPTION_MANAGER_REGISTRY_FULL;
+            }
+            else
+            {
+                pNode = pChild;
+                levelStart = ( uint16_t ) ( levelStart + levelLength + 1u );
+            }
+        }
+
+        if( returnStatus != SUBSCRIPTION_MANAGER_SUCCESS )
+        {
+            /* Error already reported. */
+        }
+        else if( pNode->callback != NULL )
+        {
+            /* The record for the topic filter already exists. */
+            LogError( ( "Failed to register callback: Record for topic filter "
+                    "already exists: TopicFilter=%.*s", topicFilterLength, pTopicFilter ) );
+
+            returnStatus = SUBSCRIPTION_MANAGER_RECORD_EXISTS;
+        }
+        else
+        {
+            pNode->pTopicFilter = pTopicFilter;
+            pNode->topicFilterLength = topicFilterLength;
+            pNode->callback = callback;
+            registeredRecordCount++;
+
+            LogDebug( ( "Added callback to registry: TopicFilter=%.*s",
+                    topicFilterLength,
+                    pTopicFilter ) );
+        }
     }
 
     return returnStatus;
@@ -229,31 +711,34 @@ void SubscriptionManager_RemoveCallback( const char * pTopicFilter,
     assert( pTopicFilter != NULL );
     assert( topicFilterLength != 0 );
 
-    size_t index;
-    SubscriptionManagerRecord_t * pRecord = NULL;
+    SubscriptionTrieNode_t * pNode = &trieRoot;
+    const char * pRegisteredFilter;
+    uint16_t registeredFilterLength;
+    uint16_t levelStart = 0u;
+    uint16_t levelLength = 0u;
 
-    /* Iterate through the records list to find the matching record. */
-    for( index = 0; index < MAX_SUBSCRIPTION_CALLBACK_RECORDS; index++ )
-    {
-        pRecord = &callbackRecordList[ index ];
+    trieInit();
 
-        /* Only match the non-empty records. */
-        if( pRecord->pTopicFilter != NULL )
-        {
-            if( ( topicFilterLength == pRecord->topicFilterLength ) &&
-                    ( strncmp( pTopicFilter, pRecord->pTopicFilter, topicFilterLength ) == 0 ) )
-            {
-                break;
-            }
-        }
+    /* Walk down the trie to find the node terminating the topic filter. */
+    while( ( pNode != NULL ) && ( levelStart <= topicFilterLength ) )
+    {
+        levelLength = nextLevelLength( pTopicFilter, topicFilterLength, levelStart );
+        pNode = trieFindChild( pNode, &pTopicFilter[ levelStart ], levelLength );
+        levelStart = ( uint16_t ) ( levelStart + levelLength + 1u );
     }
 
-    /* Delete the record by clearing the found entry in the records list. */
-    if( index < MAX_SUBSCRIPTION_CALLBACK_RECORDS )
+    /* Delete the record and release the levels no longer used by any filter. */
+    if( ( pNode != NULL ) && ( pNode->callback != NULL ) )
     {
-        pRecord->pTopicFilter = NULL;
-        pRecord->topicFilterLength = 0u;
-        pRecord->callback = NULL;
+        pRegisteredFilter = pNode->pTopicFilter;
+        registeredFilterLength = pNode->topicFilterLength;
+
+        pNode->pTopicFilter = NULL;
+        pNode->topicFilterLength = 0u;
+        pNode->callback = NULL;
+        registeredRecordCount--;
+
+        trieRebaseLevels( triePrune( pNode ), pRegisteredFilter, registeredFilterLength );
 
         LogDebug( ( "Deleted callback record for topic filter: TopicFilter=%.*s",
                 topicFilterLength,
@@ -64,7 +64,14 @@ typedef enum SubscriptionManagerStatus
      * @brief Failure return value due to an already existing record in the
      * registry for a new callback registration's requested topic filter.
      */
-    SUBSCRIPTION_MANAGER_RECORD_EXISTS = 3
+    SUBSCRIPTION_MANAGER_RECORD_EXISTS = 3,
+
+    /**
+     * @brief Failure return value due to a malformed topic filter, i.e. a
+     * wildcard that does not occupy a whole topic level or a multi-level
+     * wildcard that is not the last level.
+     */
+    SUBSCRIPTION_MANAGER_INVALID_FILTER = 4
 } SubscriptionManagerStatus_t;
 
 
@@ -0,0 +1,428 @@
+/********************************************************************************
+ * File Name: ota_block_decoder.c
+ *
+ * Description: Implementation of an in-place decoder of the CBOR stream data
+ * messages that carry the OTA file blocks.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <string.h>
+
+/* Include header for the stream block decoder. */
+#include "ota_block_decoder.h"
+
+/* CBOR major types used by stream data messages. */
+#define CBOR_MAJOR_UNSIGNED                 (0U)
+#define CBOR_MAJOR_NEGATIVE                 (1U)
+#define CBOR_MAJOR_BYTE_STRING              (2U)
+#define CBOR_MAJOR_TEXT_STRING              (3U)
+#define CBOR_MAJOR_MAP                      (5U)
+
+/* Additional information values of the initial byte of a data item. */
+#define CBOR_INFO_ONE_BYTE                  (24U)
+#define CBOR_INFO_EIGHT_BYTES               (27U)
+
+/* Keys of the stream data message fields, set in the found mask once seen. */
+#define BLOCK_FIELD_FILE_ID                 (0x01U)
+#define BLOCK_FIELD_BLOCK_ID                (0x02U)
+#define BLOCK_FIELD_BLOCK_SIZE              (0x04U)
+#define BLOCK_FIELD_PAYLOAD                 (0x08U)
+#define BLOCK_FIELD_ALL                     (0x0FU)
+
+/* Position of the decoder within a message. */
+typedef struct BlockDecoderCursor
+{
+    const uint8_t * pData;
+    size_t remaining;
+} BlockDecoderCursor_t;
+
+
+/*******************************************************************************
+ * Function Name: readHead()
+ *******************************************************************************
+ * Summary:
+ *  Reads the initial byte and the argument of the next CBOR data item.
+ *  Indefinite lengths are not used by the stream and are rejected.
+ *
+ * Parameters:
+ *  pCursor:    Decoder position, advanced past the head.
+ *  pMajorType: Receives the major type of the item.
+ *  pArgument:  Receives the value, length or count of the item.
+ *
+ * Return:
+ *  true if a well-formed head was read, false otherwise.
+ *
+ *******************************************************************************/
+static bool readHead( BlockDecoderCursor_t * pCursor,
+        uint8_t * pMajorType,
+        uint64_t * pArgument )
+{
+    uint8_t info;
+    size_t argumentSize;
+    size_t index;
+
+    if( pCursor->remaining == 0U )
+    {
+        return false;
+    }
+
+    *pMajorType = ( uint8_t ) ( pCursor->pData[ 0 ] >> 5 );
+    info = ( uint8_t ) ( pCursor->pData[ 0 ] & 0x1FU );
+    pCursor->pData++;
+    pCursor->remaining--;
+
+    if( info < CBOR_INFO_ONE_BYTE )
+    {
+        *pArgument = info;
+        return true;
+    }
+
+    if( info > CBOR_INFO_EIGHT_BYTES )
+    {
+        return false;
+    }
+
+    argumentSize = ( size_t ) 1U << ( info - CBOR_INFO_ONE_BYTE );
+    if( pCursor->remaining < argumentSize )
+    {
+        return false;
+    }
+
+    *pArgument = 0U;
+    for( index = 0U; index < argumentSize; index++ )
+    {
+        *pArgument = ( *pArgument << 8 ) | pCursor->pData[ index ];
+    }
+
+    pCursor->pData += argumentSize;
+    pCursor->remaining -= argumentSize;
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: readString()
+ *******************************************************************************
+ * Summary:
+ *  Returns the contents of a byte or text string of the given length in place
+ *  and advances past them.
+ *
+ * Parameters:
+ *  pCursor:    Decoder position, advanced past the string.
+ *  length:     Length of the string from its head.
+ *  ppString:   Receives a pointer to the string within the message.
+ *
+ * Return:
+ *  true if the message holds the whole string, false otherwise.
+ *
+ *******************************************************************************/
+static bool readString( BlockDecoderCursor_t * pCursor,
+        uint64_t length,
+        const uint8_t ** ppString )
+{
+    if( length > pCursor->remaining )
+    {
+        return false;
+    }
+
+    *ppString = pCursor->pData;
+    pCursor->pData += ( size_t ) length;
+    pCursor->remaining -= ( size_t ) length;
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: readField()
+ *******************************************************************************
+ * Summary:
+ *  Reads the value of one map entry. The integer fields must fit in 32 bits
+ *  and the payload must be a byte string; values of unknown keys are skipped
+ *  when they are integers or strings.
+ *
+ * Parameters:
+ *  pCursor:    Decoder position, advanced past the value.
+ *  key:        Single character key of the entry, 0 for other keys.
+ *  pBlock:     Block receiving the field.
+ *  pFound:     Mask of the fields seen so far, updated.
+ *
+ * Return:
+ *  true if the value was read, false if the message is malformed.
+ *
+ *******************************************************************************/
+static bool readField( BlockDecoderCursor_t * pCursor,
+        char key,
+        OtaStreamBlock_t * pBlock,
+        uint8_t * pFound )
+{
+    const uint8_t * pString = NULL;
+    uint64_t argument = 0U;
+    uint8_t majorType = 0U;
+    uint32_t * pValue = NULL;
+    uint8_t field = 0U;
+
+    if( readHead( pCursor, &majorType, &argument ) == false )
+    {
+        return false;
+    }
+
+    switch( key )
+    {
+        case 'f':
+            pValue = &pBlock->fileId;
+            field = BLOCK_FIELD_FILE_ID;
+            break;
+
+        case 'i':
+            pValue = &pBlock->blockId;
+            field = BLOCK_FIELD_BLOCK_ID;
+            break;
+
+        case 'l':
+            pValue = &pBlock->blockSize;
+            field = BLOCK_FIELD_BLOCK_SIZE;
+            break;
+
+        case 'p':
+            field = BLOCK_FIELD_PAYLOAD;
+            break;
+
+        default:
+            break;
+    }
+
+    if( ( *pFound & field ) != 0U )
+    {
+        /* Duplicate key. */
+        return false;
+    }
+
+    if( pValue != NULL )
+    {
+        /* The OTA agent takes these fields as signed 32-bit values. */
+        if( ( majorType != CBOR_MAJOR_UNSIGNED ) || ( argument > ( uint64_t ) INT32_MAX ) )
+        {
+            return false;
+        }
+
+        *pValue = ( uint32_t ) argument;
+    }
+    else if( field == BLOCK_FIELD_PAYLOAD )
+    {
+        if( ( majorType != CBOR_MAJOR_BYTE_STRING ) ||
+                ( readString( pCursor, argument, &pBlock->pPayload ) == false ) )
+        {
+            return false;
+        }
+
+        pBlock->payloadSize = ( uint32_t ) argument;
+    }
+    else if( ( majorType == CBOR_MAJOR_BYTE_STRING ) || ( majorType == CBOR_MAJOR_TEXT_STRING ) )
+    {
+        if( readString( pCursor, argument, &pString ) == false )
+        {
+            return false;
+        }
+    }
+    else if( ( majorType != CBOR_MAJOR_UNSIGNED ) && ( majorType != CBOR_MAJOR_NEGATIVE ) )
+    {
+        return false;
+    }
+
+    *pFound |= field;
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: OtaBlockDecoder_Decode()
+ *******************************************************************************
+ * Summary:
+ *  Decodes a stream data message in place. The message is a CBOR map holding
+ *  the file index "f", the block index "i", the block size "l" and the block
+ *  data "p". Nothing is copied: the payload of the block points into the
+ *  message, which must stay valid while the payload is used.
+ *
+ * Parameters:
+ *  pMessage:       Received stream data message.
+ *  messageSize:    Size of the message.
+ *  pBlock:         Block receiving the decoded fields.
+ *
+ * Return:
+ *  true if the message holds all fields of a block, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaBlockDecoder_Decode( const uint8_t * pMessage,
+        size_t messageSize,
+        OtaStreamBlock_t * pBlock )
+{
+    BlockDecoderCursor_t cursor;
+    const uint8_t * pKey = NULL;
+    uint64_t entries = 0U;
+    uint64_t keyLength = 0U;
+    uint8_t majorType = 0U;
+    uint8_t found = 0U;
+    char key;
+
+    if( ( pMessage == NULL ) || ( pBlock == NULL ) )
+    {
+        return false;
+    }
+
+    memset( pBlock, 0x00, sizeof( OtaStreamBlock_t ) );
+    cursor.pData = pMessage;
+    cursor.remaining = messageSize;
+
+    if( ( readHead( &cursor, &majorType, &entries ) == false ) || ( majorType != CBOR_MAJOR_MAP ) )
+    {
+        return false;
+    }
+
+    for( ; entries > 0U; entries-- )
+    {
+        if( ( readHead( &cursor, &majorType, &keyLength ) == false ) ||
+                ( majorType != CBOR_MAJOR_TEXT_STRING ) ||
+                ( readString( &cursor, keyLength, &pKey ) == false ) )
+        {
+            return false;
+        }
+
+        key = ( keyLength == 1U ) ? ( char ) pKey[ 0 ] : '\0';
+
+        if( readField( &cursor, key, pBlock, &found ) == false )
+        {
+            return false;
+        }
+    }
+
+    return ( found == BLOCK_FIELD_ALL );
+}
+
+/*******************************************************************************
+ * Function Name: encodeField()
+ *******************************************************************************
+ * Summary:
+ *  Appends a map entry with a single character key and an unsigned value in
+ *  its shortest encoding.
+ *
+ * Parameters:
+ *  pBuffer:    Output buffer, at least nine bytes.
+ *  key:        Key of the entry.
+ *  value:      Value of the entry.
+ *
+ * Return:
+ *  Number of bytes written.
+ *
+ *******************************************************************************/
+static size_t encodeField( uint8_t * pBuffer,
+        char key,
+        uint32_t value )
+{
+    size_t length = 0U;
+    size_t valueSize;
+
+    pBuffer[ length++ ] = ( uint8_t ) ( ( CBOR_MAJOR_TEXT_STRING << 5 ) | 1U );
+    pBuffer[ length++ ] = ( uint8_t ) key;
+
+    if( value < CBOR_INFO_ONE_BYTE )
+    {
+        pBuffer[ length++ ] = ( uint8_t ) value;
+        return length;
+    }
+
+    if( value <= 0xFFU )
+    {
+        pBuffer[ length++ ] = ( uint8_t ) CBOR_INFO_ONE_BYTE;
+        valueSize = 1U;
+    }
+    else if( value <= 0xFFFFU )
+    {
+        pBuffer[ length++ ] = ( uint8_t ) ( CBOR_INFO_ONE_BYTE + 1U );
+        valueSize = 2U;
+    }
+    else
+    {
+        pBuffer[ length++ ] = ( uint8_t ) ( CBOR_INFO_ONE_BYTE + 2U );
+        valueSize = 4U;
+    }
+
+    for( ; valueSize > 0U; valueSize-- )
+    {
+        pBuffer[ length++ ] = ( uint8_t ) ( value >> ( 8U * ( valueSize - 1U ) ) );
+    }
+
+    return length;
+}
+
+/*******************************************************************************
+ * Function Name: OtaBlockDecoder_EncodeHeader()
+ *******************************************************************************
+ * Summary:
+ *  Encodes the header of a block as a stream data message with an empty
+ *  payload. The OTA agent takes the block size from the "l" field, so it
+ *  processes such a message like the full block.
+ *
+ * Parameters:
+ *  pBlock:     Block whose header is encoded.
+ *  pBuffer:    Output buffer.
+ *  bufferSize: Size of the output buffer.
+ *
+ * Return:
+ *  Size of the encoded message, 0 if the buffer is too small.
+ *
+ *******************************************************************************/
+size_t OtaBlockDecoder_EncodeHeader( const OtaStreamBlock_t * pBlock,
+        uint8_t * pBuffer,
+        size_t bufferSize )
+{
+    size_t length = 0U;
+
+    if( ( pBlock == NULL ) || ( pBuffer == NULL ) || ( bufferSize < OTA_BLOCK_DECODER_HEADER_MAX_SIZE ) )
+    {
+        return 0U;
+    }
+
+    pBuffer[ length++ ] = ( uint8_t ) ( ( CBOR_MAJOR_MAP << 5 ) | 4U );
+    length += encodeField( &pBuffer[ length ], 'f', pBlock->fileId );
+    length += encodeField( &pBuffer[ length ], 'i', pBlock->blockId );
+    length += encodeField( &pBuffer[ length ], 'l', pBlock->blockSize );
+    pBuffer[ length++ ] = ( uint8_t ) ( ( CBOR_MAJOR_TEXT_STRING << 5 ) | 1U );
+    pBuffer[ length++ ] = ( uint8_t ) 'p';
+    pBuffer[ length++ ] = ( uint8_t ) ( CBOR_MAJOR_BYTE_STRING << 5 );
+
+    return length;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,87 @@
+/********************************************************************************
+ * File Name: ota_block_decoder.h
+ *
+ * Description: Public API of the in-place decoder of the stream data messages
+ * that carry the OTA file blocks.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef OTA_BLOCK_DECODER_H_
+#define OTA_BLOCK_DECODER_H_
+
+/* Standard includes. */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* OTA Library include. */
+#include "ota_config.h"
+
+
+/* Set to 1 to decode stream data messages in the MQTT network buffer and copy
+ * the block payload straight into the flash writer. The OTA agent is handed
+ * the block header only and takes the block from the flash writer, so it
+ * neither copies the payload nor needs a decode buffer of a whole block. */
+#ifndef OTA_BLOCK_DECODER_ENABLE
+#define OTA_BLOCK_DECODER_ENABLE            (1)
+#endif
+
+/* Largest encoded block header: a map of four entries whose three integers
+ * take up to five bytes each, followed by an empty payload. */
+#define OTA_BLOCK_DECODER_HEADER_MAX_SIZE   (25U)
+
+/* Fields of a stream data message. The payload points into the message. */
+typedef struct OtaStreamBlock
+{
+    uint32_t fileId;                /* File index within the job. */
+    uint32_t blockId;               /* Index of the block in the file. */
+    uint32_t blockSize;             /* Block size announced by the stream. */
+    const uint8_t * pPayload;       /* Block data, within the decoded message. */
+    uint32_t payloadSize;           /* Number of bytes of block data. */
+} OtaStreamBlock_t;
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+bool OtaBlockDecoder_Decode( const uint8_t * pMessage,
+        size_t messageSize,
+        OtaStreamBlock_t * pBlock );
+
+size_t OtaBlockDecoder_EncodeHeader( const OtaStreamBlock_t * pBlock,
+        uint8_t * pBuffer,
+        size_t bufferSize );
+
+
+#endif /* ifndef OTA_BLOCK_DECODER_H_ */
@@ -0,0 +1,305 @@
+/********************************************************************************
+ * File Name: ota_block_recovery.c
+ *
+ * Description: Implementation of the recovery of file blocks dropped while the
+ * OTA event buffer pool is exhausted.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <string.h>
+
+/* RTOS includes. */
+#include <FreeRTOS.h>
+#include <task.h>
+
+/* Include header for the recovery of dropped blocks. */
+#include "ota_block_recovery.h"
+
+/* Recovery state of the current job. */
+typedef struct OtaBlockRecovery
+{
+    OtaStreamBlock_t blocks[ OTA_BLOCK_RECOVERY_MAX_BLOCKS ];   /* Headers of dropped blocks, payload unused. */
+    uint32_t head;                  /* Oldest dropped block. */
+    uint32_t count;                 /* Dropped blocks waiting for recovery. */
+    bool requestPending;            /* A dropped block can only be recovered by a request. */
+    bool stalled;                   /* Dropped blocks wait for recovery since stallTick. */
+    TickType_t stallTick;
+    OtaBlockRecoveryStatistics_t statistics;
+} OtaBlockRecovery_t;
+
+/* State of the current job. */
+static OtaBlockRecovery_t blockRecovery;
+
+
+/*******************************************************************************
+ * Function Name: endStallIfRecovered()
+ *******************************************************************************
+ * Summary:
+ *  Accounts the stall time once no dropped block is waiting any more. Must be
+ *  called inside a critical section.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+static void endStallIfRecovered( void )
+{
+    if( ( blockRecovery.stalled == true ) && ( blockRecovery.count == 0U ) &&
+            ( blockRecovery.requestPending == false ) )
+    {
+        blockRecovery.statistics.stallMs +=
+                ( xTaskGetTickCount() - blockRecovery.stallTick ) * portTICK_PERIOD_MS;
+        blockRecovery.stalled = false;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: OtaBlockRecovery_Reset()
+ *******************************************************************************
+ * Summary:
+ *  Forgets the dropped blocks and clears the statistics for a new job.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaBlockRecovery_Reset( void )
+{
+    taskENTER_CRITICAL();
+    memset( &blockRecovery, 0x00, sizeof( blockRecovery ) );
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaBlockRecovery_OnBlockDropped()
+ *******************************************************************************
+ * Summary:
+ *  Records a block that could not be handed to the OTA agent for lack of an
+ *  event buffer. A block already staged in the flash writer is kept by its
+ *  header and handed to the agent again without being downloaded again;
+ *  other blocks, and staged blocks beyond the capacity of the record, need a
+ *  new stream request.
+ *
+ * Parameters:
+ *  pBlock: Header of the staged block, NULL if the block was not staged.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaBlockRecovery_OnBlockDropped( const OtaStreamBlock_t * pBlock )
+{
+    OtaStreamBlock_t * pEntry;
+
+    taskENTER_CRITICAL();
+
+    blockRecovery.statistics.blocksDropped++;
+
+    if( blockRecovery.stalled == false )
+    {
+        blockRecovery.stalled = true;
+        blockRecovery.stallTick = xTaskGetTickCount();
+    }
+
+    if( ( pBlock != NULL ) && ( blockRecovery.count < OTA_BLOCK_RECOVERY_MAX_BLOCKS ) )
+    {
+        pEntry = &blockRecovery.blocks[ ( blockRecovery.head + blockRecovery.count ) % OTA_BLOCK_RECOVERY_MAX_BLOCKS ];
+        *pEntry = *pBlock;
+        pEntry->pPayload = NULL;
+        pEntry->payloadSize = 0U;
+        blockRecovery.count++;
+    }
+    else
+    {
+        blockRecovery.requestPending = true;
+    }
+
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaBlockRecovery_NextBlock()
+ *******************************************************************************
+ * Summary:
+ *  Returns the oldest dropped block that can be handed to the OTA agent
+ *  again. The block stays recorded until OtaBlockRecovery_OnBlockHandled is
+ *  called.
+ *
+ * Parameters:
+ *  pBlock: Receives the header of the block.
+ *
+ * Return:
+ *  true if a block is waiting, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaBlockRecovery_NextBlock( OtaStreamBlock_t * pBlock )
+{
+    bool waiting = false;
+
+    taskENTER_CRITICAL();
+
+    if( ( pBlock != NULL ) && ( blockRecovery.count > 0U ) )
+    {
+        *pBlock = blockRecovery.blocks[ blockRecovery.head ];
+        waiting = true;
+    }
+
+    taskEXIT_CRITICAL();
+
+    return waiting;
+}
+
+/*******************************************************************************
+ * Function Name: OtaBlockRecovery_OnBlockHandled()
+ *******************************************************************************
+ * Summary:
+ *  Forgets the block returned by OtaBlockRecovery_NextBlock once the OTA
+ *  agent took it, or once it turned out to be no longer staged.
+ *
+ * Parameters:
+ *  redelivered: true if the OTA agent took the block.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaBlockRecovery_OnBlockHandled( bool redelivered )
+{
+    taskENTER_CRITICAL();
+
+    if( blockRecovery.count > 0U )
+    {
+        blockRecovery.head = ( blockRecovery.head + 1U ) % OTA_BLOCK_RECOVERY_MAX_BLOCKS;
+        blockRecovery.count--;
+        if( redelivered == true )
+        {
+            blockRecovery.statistics.blocksRedelivered++;
+        }
+        endStallIfRecovered();
+    }
+
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaBlockRecovery_TakeRequest()
+ *******************************************************************************
+ * Summary:
+ *  Checks whether dropped blocks wait for a stream request. Returns true once
+ *  per batch of such drops; the caller then makes the OTA agent request the
+ *  missing blocks without waiting for its request timer.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  true if a stream request is to be sent, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaBlockRecovery_TakeRequest( void )
+{
+    bool requestPending;
+
+    taskENTER_CRITICAL();
+
+    requestPending = blockRecovery.requestPending;
+    if( requestPending == true )
+    {
+        blockRecovery.requestPending = false;
+        blockRecovery.statistics.earlyRequests++;
+        endStallIfRecovered();
+    }
+
+    taskEXIT_CRITICAL();
+
+    return requestPending;
+}
+
+/*******************************************************************************
+ * Function Name: OtaBlockRecovery_OnRequestPaused()
+ *******************************************************************************
+ * Summary:
+ *  Counts a stream request held back because the event buffer pool is under
+ *  pressure.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaBlockRecovery_OnRequestPaused( void )
+{
+    taskENTER_CRITICAL();
+    blockRecovery.statistics.requestsPaused++;
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaBlockRecovery_GetStatistics()
+ *******************************************************************************
+ * Summary:
+ *  Returns a snapshot of the recovery statistics of the current job. A stall
+ *  still in progress is included up to now.
+ *
+ * Parameters:
+ *  pStatistics: Pointer to the structure receiving the statistics.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaBlockRecovery_GetStatistics( OtaBlockRecoveryStatistics_t * pStatistics )
+{
+    if( pStatistics != NULL )
+    {
+        taskENTER_CRITICAL();
+        *pStatistics = blockRecovery.statistics;
+        if( blockRecovery.stalled == true )
+        {
+            pStatistics->stallMs += ( xTaskGetTickCount() - blockRecovery.stallTick ) * portTICK_PERIOD_MS;
+        }
+        taskEXIT_CRITICAL();
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,87 @@
+/********************************************************************************
+ * File Name: ota_block_recovery.h
+ *
+ * Description: Public API of the recovery of file blocks dropped while the OTA
+ * event buffer pool is exhausted.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef OTA_BLOCK_RECOVERY_H_
+#define OTA_BLOCK_RECOVERY_H_
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Include header for the stream block decoder. */
+#include "ota_block_decoder.h"
+
+
+/* Number of dropped blocks whose header is kept to hand the block to the OTA
+ * agent again once event buffers are free. Blocks dropped beyond that are
+ * recovered by an early stream request instead. */
+#ifndef OTA_BLOCK_RECOVERY_MAX_BLOCKS
+#define OTA_BLOCK_RECOVERY_MAX_BLOCKS       (16U)
+#endif
+
+/* Statistics of the recovery of dropped blocks for the current job. */
+typedef struct OtaBlockRecoveryStatistics
+{
+    uint32_t blocksDropped;         /* Blocks dropped for lack of an event buffer. */
+    uint32_t blocksRedelivered;     /* Staged blocks handed to the OTA agent again. */
+    uint32_t earlyRequests;         /* Stream requests sent ahead of the request timer. */
+    uint32_t requestsPaused;        /* Lane requests held back under pool pressure. */
+    uint32_t stallMs;               /* Time from a drop until all dropped blocks were recovered. */
+} OtaBlockRecoveryStatistics_t;
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+void OtaBlockRecovery_Reset( void );
+
+void OtaBlockRecovery_OnBlockDropped( const OtaStreamBlock_t * pBlock );
+
+bool OtaBlockRecovery_NextBlock( OtaStreamBlock_t * pBlock );
+
+void OtaBlockRecovery_OnBlockHandled( bool redelivered );
+
+bool OtaBlockRecovery_TakeRequest( void );
+
+void OtaBlockRecovery_OnRequestPaused( void );
+
+void OtaBlockRecovery_GetStatistics( OtaBlockRecoveryStatistics_t * pStatistics );
+
+
+#endif /* ifndef OTA_BLOCK_RECOVERY_H_ */
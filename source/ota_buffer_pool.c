@@ -0,0 +1,287 @@
+/********************************************************************************
+ * File Name: ota_buffer_pool.c
+ *
+ * Description: Implementation of a lock-free pool of OTA event buffers shared
+ * by the MQTT receive path and the OTA agent.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <string.h>
+#include <stdatomic.h>
+
+/* Include header for the OTA event buffer pool. */
+#include "ota_buffer_pool.h"
+
+/* Index value marking the end of the free list. */
+#define OTA_BUFFER_POOL_NIL                 ( 0xFFFFU )
+
+/* Helpers to pack and unpack the free list head. The lower 16 bits hold the
+ * index of the first free buffer, the upper 16 bits hold a modification tag
+ * which is incremented on every update so that a compare-and-swap never
+ * succeeds on a head that was popped and pushed back in between (ABA). */
+#define OTA_BUFFER_POOL_HEAD( tag, index )  ( ( ( ( uint32_t ) ( tag ) ) << 16 ) | ( ( uint32_t ) ( index ) & 0xFFFFU ) )
+#define OTA_BUFFER_POOL_HEAD_INDEX( head )  ( ( uint16_t ) ( ( head ) & 0xFFFFU ) )
+#define OTA_BUFFER_POOL_HEAD_TAG( head )    ( ( uint16_t ) ( ( head ) >> 16 ) )
+
+#if ( otaconfigMAX_NUM_OTA_DATA_BUFFERS >= OTA_BUFFER_POOL_NIL )
+#error "otaconfigMAX_NUM_OTA_DATA_BUFFERS exceeds the capacity of the OTA buffer pool."
+#endif
+
+/* A job document and a file block must be able to be in flight together. */
+#if ( otaconfigMAX_NUM_OTA_DATA_BUFFERS < 2 )
+#error "OTA_DATA_BUFFER_MEMORY_SIZE holds less than two OTA event buffers of the selected block size."
+#endif
+
+/* Event buffer storage. */
+static OtaEventData_t eventBuffer[ otaconfigMAX_NUM_OTA_DATA_BUFFERS ];
+
+/* Link of every buffer to the next free buffer. Only meaningful while the
+ * buffer is on the free list. */
+static _Atomic uint16_t nextFreeIndex[ otaconfigMAX_NUM_OTA_DATA_BUFFERS ];
+
+/* Ownership flag of every buffer, used to reject double frees. */
+static atomic_bool bufferAllocated[ otaconfigMAX_NUM_OTA_DATA_BUFFERS ];
+
+/* Tagged head of the free list. */
+static _Atomic uint32_t freeListHead = OTA_BUFFER_POOL_HEAD( 0U, OTA_BUFFER_POOL_NIL );
+
+/* Pool statistics. */
+static _Atomic uint32_t buffersInUse = 0U;
+static _Atomic uint32_t buffersHighWaterMark = 0U;
+static _Atomic uint32_t allocationCount = 0U;
+static _Atomic uint32_t allocationFailureCount = 0U;
+static _Atomic uint32_t invalidFreeCount = 0U;
+
+
+/*******************************************************************************
+ * Function Name: OtaBufferPool_Init()
+ *******************************************************************************
+ * Summary:
+ *  Puts all event buffers on the free list and clears the pool statistics.
+ *  Must be called before the MQTT callbacks or the OTA agent use the pool.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaBufferPool_Init( void )
+{
+    uint16_t index;
+
+    memset( eventBuffer, 0x00, sizeof( eventBuffer ) );
+
+    for( index = 0U; index < otaconfigMAX_NUM_OTA_DATA_BUFFERS; index++ )
+    {
+        atomic_store( &nextFreeIndex[ index ],
+                ( uint16_t ) ( ( ( index + 1U ) < otaconfigMAX_NUM_OTA_DATA_BUFFERS ) ?
+                        ( index + 1U ) : OTA_BUFFER_POOL_NIL ) );
+        atomic_store( &bufferAllocated[ index ], false );
+    }
+
+    atomic_store( &freeListHead, OTA_BUFFER_POOL_HEAD( 0U, 0U ) );
+    atomic_store( &buffersInUse, 0U );
+    atomic_store( &buffersHighWaterMark, 0U );
+    atomic_store( &allocationCount, 0U );
+    atomic_store( &allocationFailureCount, 0U );
+    atomic_store( &invalidFreeCount, 0U );
+}
+
+/*******************************************************************************
+ * Function Name: OtaBufferPool_Get()
+ *******************************************************************************
+ * Summary:
+ *  Pops an event buffer from the lock-free free list in constant time. Safe to
+ *  call concurrently from the MQTT receive path and the OTA agent, never blocks.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  OtaEventData_t: pointer to a free event buffer, NULL if the pool is empty.
+ *
+ *******************************************************************************/
+OtaEventData_t * OtaBufferPool_Get( void )
+{
+    OtaEventData_t * pBuffer = NULL;
+    uint32_t head = atomic_load( &freeListHead );
+    uint32_t newHead;
+    uint32_t inUse;
+    uint32_t highWaterMark;
+    uint16_t index;
+
+    do
+    {
+        index = OTA_BUFFER_POOL_HEAD_INDEX( head );
+        if( index == OTA_BUFFER_POOL_NIL )
+        {
+            break;
+        }
+
+        newHead = OTA_BUFFER_POOL_HEAD( OTA_BUFFER_POOL_HEAD_TAG( head ) + 1U,
+                atomic_load( &nextFreeIndex[ index ] ) );
+    } while( !atomic_compare_exchange_weak( &freeListHead, &head, newHead ) );
+
+    if( index == OTA_BUFFER_POOL_NIL )
+    {
+        atomic_fetch_add( &allocationFailureCount, 1U );
+    }
+    else
+    {
+        atomic_store( &bufferAllocated[ index ], true );
+        pBuffer = &eventBuffer[ index ];
+        pBuffer->bufferUsed = true;
+
+        atomic_fetch_add( &allocationCount, 1U );
+        inUse = atomic_fetch_add( &buffersInUse, 1U ) + 1U;
+
+        /* Raise the high-water mark if this allocation exceeds it. */
+        highWaterMark = atomic_load( &buffersHighWaterMark );
+        while( ( inUse > highWaterMark ) &&
+                !atomic_compare_exchange_weak( &buffersHighWaterMark, &highWaterMark, inUse ) )
+        {
+        }
+    }
+
+    return pBuffer;
+}
+
+/*******************************************************************************
+ * Function Name: OtaBufferPool_Free()
+ *******************************************************************************
+ * Summary:
+ *  Pushes an event buffer back on the lock-free free list in constant time.
+ *  Pointers that do not belong to the pool and buffers that are already free
+ *  are rejected and counted.
+ *
+ * Parameters:
+ *  pBuffer: Pointer to the event buffer to release.
+ *
+ * Return:
+ *  true if the buffer was returned to the pool, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaBufferPool_Free( OtaEventData_t * pBuffer )
+{
+    bool status = false;
+    uint32_t head;
+    uint32_t newHead;
+    uint16_t index;
+
+    if( ( pBuffer >= &eventBuffer[ 0 ] ) &&
+            ( pBuffer < &eventBuffer[ otaconfigMAX_NUM_OTA_DATA_BUFFERS ] ) )
+    {
+        index = ( uint16_t ) ( pBuffer - &eventBuffer[ 0 ] );
+
+        if( atomic_exchange( &bufferAllocated[ index ], false ) == true )
+        {
+            pBuffer->bufferUsed = false;
+            atomic_fetch_sub( &buffersInUse, 1U );
+
+            head = atomic_load( &freeListHead );
+            do
+            {
+                atomic_store( &nextFreeIndex[ index ], OTA_BUFFER_POOL_HEAD_INDEX( head ) );
+                newHead = OTA_BUFFER_POOL_HEAD( OTA_BUFFER_POOL_HEAD_TAG( head ) + 1U, index );
+            } while( !atomic_compare_exchange_weak( &freeListHead, &head, newHead ) );
+
+            status = true;
+        }
+    }
+
+    if( status == false )
+    {
+        atomic_fetch_add( &invalidFreeCount, 1U );
+    }
+
+    return status;
+}
+
+/*******************************************************************************
+ * Function Name: OtaBufferPool_GetIndex()
+ *******************************************************************************
+ * Summary:
+ *  Returns the position of an event buffer in the pool, e.g. to keep per
+ *  buffer bookkeeping in a side table.
+ *
+ * Parameters:
+ *  pBuffer: Pointer to the event buffer.
+ *
+ * Return:
+ *  Index of the buffer, or -1 if the buffer does not belong to the pool.
+ *
+ *******************************************************************************/
+int32_t OtaBufferPool_GetIndex( const OtaEventData_t * pBuffer )
+{
+    int32_t index = -1;
+
+    if( ( pBuffer >= &eventBuffer[ 0 ] ) &&
+            ( pBuffer < &eventBuffer[ otaconfigMAX_NUM_OTA_DATA_BUFFERS ] ) )
+    {
+        index = ( int32_t ) ( pBuffer - &eventBuffer[ 0 ] );
+    }
+
+    return index;
+}
+
+/*******************************************************************************
+ * Function Name: OtaBufferPool_GetStatistics()
+ *******************************************************************************
+ * Summary:
+ *  Returns a snapshot of the pool statistics.
+ *
+ * Parameters:
+ *  pStatistics: Pointer to the structure receiving the statistics.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaBufferPool_GetStatistics( OtaBufferPoolStatistics_t * pStatistics )
+{
+    if( pStatistics != NULL )
+    {
+        pStatistics->capacity = otaconfigMAX_NUM_OTA_DATA_BUFFERS;
+        pStatistics->inUse = atomic_load( &buffersInUse );
+        pStatistics->highWaterMark = atomic_load( &buffersHighWaterMark );
+        pStatistics->allocations = atomic_load( &allocationCount );
+        pStatistics->allocationFailures = atomic_load( &allocationFailureCount );
+        pStatistics->invalidFrees = atomic_load( &invalidFreeCount );
+    }
+}
+
+/* [] END OF FILE */
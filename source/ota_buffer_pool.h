@@ -0,0 +1,78 @@
+/********************************************************************************
+ * File Name: ota_buffer_pool.h
+ *
+ * Description: The API of a lock-free pool of OTA event buffers shared by the
+ * MQTT receive path and the OTA agent.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef OTA_BUFFER_POOL_H_
+#define OTA_BUFFER_POOL_H_
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* OTA Library include. */
+#include "ota.h"
+#include "ota_config.h"
+
+
+/* Statistics of the OTA event buffer pool. */
+typedef struct OtaBufferPoolStatistics
+{
+    uint32_t capacity;              /* Number of buffers in the pool. */
+    uint32_t inUse;                 /* Number of buffers currently allocated. */
+    uint32_t highWaterMark;         /* Largest number of buffers allocated at the same time. */
+    uint32_t allocations;           /* Number of successful allocations. */
+    uint32_t allocationFailures;    /* Number of allocations that found the pool empty. */
+    uint32_t invalidFrees;          /* Number of frees of foreign or already free buffers. */
+} OtaBufferPoolStatistics_t;
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+void OtaBufferPool_Init( void );
+
+OtaEventData_t * OtaBufferPool_Get( void );
+
+bool OtaBufferPool_Free( OtaEventData_t * pBuffer );
+
+int32_t OtaBufferPool_GetIndex( const OtaEventData_t * pBuffer );
+
+void OtaBufferPool_GetStatistics( OtaBufferPoolStatistics_t * pStatistics );
+
+
+#endif /* ifndef OTA_BUFFER_POOL_H_ */
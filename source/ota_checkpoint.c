@@ -0,0 +1,412 @@
+/********************************************************************************
+ * File Name: ota_checkpoint.c
+ *
+ * Description: Implementation of the OTA download checkpoint. Checkpoints are
+ * appended as records to two alternating erase sectors in external flash.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Include header for the OTA download checkpoint. */
+#include "ota_checkpoint.h"
+
+#if ( OTA_CHECKPOINT_ENABLE == 1 )
+
+/* Serial flash include. */
+#include "cy_serial_flash_qspi.h"
+
+/* Marks a checkpoint record ("OTAC"). */
+#define CHECKPOINT_MAGIC                    ( 0x4F544143UL )
+
+/* Value of an erased record header word. */
+#define CHECKPOINT_ERASED_WORD              ( 0xFFFFFFFFUL )
+
+/* Number of erase sectors the records are appended to in turn. */
+#define CHECKPOINT_NUM_SECTORS              (2U)
+
+/* A checkpoint record as stored in flash. */
+typedef struct OtaCheckpointRecord
+{
+    uint32_t magic;
+    uint32_t sequence;
+    OtaCheckpoint_t checkpoint;
+    uint32_t crc;
+} OtaCheckpointRecord_t;
+
+_Static_assert( sizeof( OtaCheckpointRecord_t ) <= OTA_CHECKPOINT_RECORD_SIZE,
+        "OTA checkpoint record does not fit in OTA_CHECKPOINT_RECORD_SIZE" );
+
+/* Layout of the checkpoint area, found by OtaCheckpoint_Init(). */
+static uint32_t areaAddress = 0U;
+static uint32_t sectorSize = 0U;
+static uint32_t recordsPerSector = 0U;
+
+/* Append position: sector and record slot of the next record. */
+static uint32_t activeSector = 0U;
+static uint32_t nextSlot = 0U;
+
+/* Sequence number of the newest record. */
+static uint32_t lastSequence = 0U;
+
+/* Newest valid record, kept in RAM. */
+static OtaCheckpointRecord_t latestRecord;
+static bool latestValid = false;
+
+
+/*******************************************************************************
+ * Function Name: crc32()
+ *******************************************************************************
+ * Summary:
+ *  Computes the CRC-32 (IEEE 802.3) of a buffer.
+ *
+ * Parameters:
+ *  pData:  Data to checksum.
+ *  length: Number of bytes.
+ *
+ * Return:
+ *  The CRC-32 of the data.
+ *
+ *******************************************************************************/
+static uint32_t crc32( const uint8_t * pData,
+        size_t length )
+{
+    uint32_t crc = 0xFFFFFFFFUL;
+    uint8_t bit;
+
+    while( length-- > 0U )
+    {
+        crc ^= *pData++;
+        for( bit = 0U; bit < 8U; bit++ )
+        {
+            crc = ( crc >> 1 ) ^ ( 0xEDB88320UL & ( 0U - ( crc & 1U ) ) );
+        }
+    }
+
+    return ~crc;
+}
+
+/*******************************************************************************
+ * Function Name: OtaCheckpoint_BlockCrc()
+ *******************************************************************************
+ * Summary:
+ *  Computes the CRC-16 (CCITT) of a file block, in one go or in pieces. A
+ *  block is checked against its CRC before a resumed download trusts it.
+ *
+ * Parameters:
+ *  crc:    OTA_CHECKPOINT_BLOCK_CRC_INIT, or the CRC of the preceding piece.
+ *  pData:  Data to checksum.
+ *  length: Number of bytes.
+ *
+ * Return:
+ *  The CRC of the data so far.
+ *
+ *******************************************************************************/
+uint16_t OtaCheckpoint_BlockCrc( uint16_t crc,
+        const uint8_t * pData,
+        size_t length )
+{
+    uint8_t bit;
+
+    while( length-- > 0U )
+    {
+        crc ^= ( uint16_t ) ( ( uint16_t ) *pData++ << 8 );
+        for( bit = 0U; bit < 8U; bit++ )
+        {
+            crc = ( uint16_t ) ( ( crc << 1 ) ^ ( 0x1021U & ( 0U - ( ( crc >> 15 ) & 1U ) ) ) );
+        }
+    }
+
+    return crc;
+}
+
+/*******************************************************************************
+ * Function Name: recordAddress()
+ *******************************************************************************
+ * Summary:
+ *  Returns the flash address of a record slot.
+ *
+ * Parameters:
+ *  sector: Sector of the checkpoint area.
+ *  slot:   Record slot in the sector.
+ *
+ * Return:
+ *  The flash address of the slot.
+ *
+ *******************************************************************************/
+static uint32_t recordAddress( uint32_t sector,
+        uint32_t slot )
+{
+    return areaAddress + ( sector * sectorSize ) + ( slot * OTA_CHECKPOINT_RECORD_SIZE );
+}
+
+/*******************************************************************************
+ * Function Name: OtaCheckpoint_Init()
+ *******************************************************************************
+ * Summary:
+ *  Scans the checkpoint area for the newest valid record and the position to
+ *  append the next one. Records are appended to one sector until it is full;
+ *  the other sector is then erased and used next, so every sector is erased
+ *  once per recordsPerSector checkpoints.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  true on success, false if the checkpoint area cannot be used.
+ *
+ *******************************************************************************/
+bool OtaCheckpoint_Init( void )
+{
+    static OtaCheckpointRecord_t record;
+    uint32_t sector;
+    uint32_t slot;
+    uint32_t firstFree[ CHECKPOINT_NUM_SECTORS ];
+
+    sectorSize = ( uint32_t ) cy_serial_flash_qspi_get_erase_size( OTA_CHECKPOINT_FLASH_ADDRESS );
+    if( sectorSize != 0U )
+    {
+        areaAddress = ( ( OTA_CHECKPOINT_FLASH_ADDRESS + sectorSize - 1U ) / sectorSize ) * sectorSize;
+    }
+
+    if( ( sectorSize < OTA_CHECKPOINT_RECORD_SIZE ) ||
+            ( ( areaAddress + ( CHECKPOINT_NUM_SECTORS * sectorSize ) ) >
+            ( uint32_t ) cy_serial_flash_qspi_get_size() ) )
+    {
+        printf("OTA checkpoint area at 0x%08X is not usable.\n",
+                (unsigned int)OTA_CHECKPOINT_FLASH_ADDRESS);
+        sectorSize = 0U;
+        return false;
+    }
+
+    recordsPerSector = sectorSize / OTA_CHECKPOINT_RECORD_SIZE;
+    latestValid = false;
+    lastSequence = 0U;
+    activeSector = 0U;
+
+    for( sector = 0U; sector < CHECKPOINT_NUM_SECTORS; sector++ )
+    {
+        firstFree[ sector ] = recordsPerSector;
+
+        for( slot = 0U; slot < recordsPerSector; slot++ )
+        {
+            if( cy_serial_flash_qspi_read( recordAddress( sector, slot ), sizeof( record ),
+                    ( uint8_t * ) &record ) != CY_RSLT_SUCCESS )
+            {
+                return false;
+            }
+
+            if( record.magic == CHECKPOINT_ERASED_WORD )
+            {
+                /* Records are appended in order, the rest of the sector is free. */
+                firstFree[ sector ] = slot;
+                break;
+            }
+
+            /* Torn or foreign records are skipped. */
+            if( ( record.magic == CHECKPOINT_MAGIC ) &&
+                    ( record.crc == crc32( ( const uint8_t * ) &record, offsetof( OtaCheckpointRecord_t, crc ) ) ) &&
+                    ( ( latestValid == false ) || ( record.sequence > lastSequence ) ) )
+            {
+                latestRecord = record;
+                latestValid = true;
+                lastSequence = record.sequence;
+                activeSector = sector;
+            }
+        }
+    }
+
+    nextSlot = firstFree[ activeSector ];
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: OtaCheckpoint_Describe()
+ *******************************************************************************
+ * Summary:
+ *  Fills in the identity of the file being received and clears its progress.
+ *
+ * Parameters:
+ *  pCheckpoint:    Checkpoint to fill in.
+ *  pFileContext:   OTA file context.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaCheckpoint_Describe( OtaCheckpoint_t * pCheckpoint,
+        const OtaFileContext_t * pFileContext )
+{
+    memset( pCheckpoint, 0x00, sizeof( OtaCheckpoint_t ) );
+
+    pCheckpoint->fileSize = pFileContext->fileSize;
+    pCheckpoint->serverFileId = pFileContext->serverFileID;
+    pCheckpoint->numBlocks = ( pFileContext->fileSize + ( otaconfigFILE_BLOCK_SIZE - 1U ) ) / otaconfigFILE_BLOCK_SIZE;
+
+    if( pFileContext->pJobName != NULL )
+    {
+        strncpy( pCheckpoint->jobName, ( const char * ) pFileContext->pJobName,
+                sizeof( pCheckpoint->jobName ) - 1U );
+    }
+
+    if( pFileContext->pStreamName != NULL )
+    {
+        strncpy( pCheckpoint->streamName, ( const char * ) pFileContext->pStreamName,
+                sizeof( pCheckpoint->streamName ) - 1U );
+    }
+}
+
+/*******************************************************************************
+ * Function Name: OtaCheckpoint_Save()
+ *******************************************************************************
+ * Summary:
+ *  Appends a checkpoint record to the checkpoint area.
+ *
+ * Parameters:
+ *  pCheckpoint: Checkpoint to save.
+ *
+ * Return:
+ *  true on success, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaCheckpoint_Save( const OtaCheckpoint_t * pCheckpoint )
+{
+    static OtaCheckpointRecord_t record;
+
+    if( sectorSize == 0U )
+    {
+        return false;
+    }
+
+    if( nextSlot >= recordsPerSector )
+    {
+        /* Continue in the other sector. */
+        activeSector = ( activeSector + 1U ) % CHECKPOINT_NUM_SECTORS;
+        nextSlot = 0U;
+        if( cy_serial_flash_qspi_erase( recordAddress( activeSector, 0U ), sectorSize ) != CY_RSLT_SUCCESS )
+        {
+            return false;
+        }
+    }
+
+    record.magic = CHECKPOINT_MAGIC;
+    record.sequence = lastSequence + 1U;
+    record.checkpoint = *pCheckpoint;
+    record.crc = crc32( ( const uint8_t * ) &record, offsetof( OtaCheckpointRecord_t, crc ) );
+
+    if( cy_serial_flash_qspi_write( recordAddress( activeSector, nextSlot ), sizeof( record ),
+            ( const uint8_t * ) &record ) != CY_RSLT_SUCCESS )
+    {
+        /* Skip the slot, it may be partially programmed. */
+        nextSlot++;
+        return false;
+    }
+
+    nextSlot++;
+    lastSequence = record.sequence;
+    latestRecord = record;
+    latestValid = true;
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: OtaCheckpoint_Load()
+ *******************************************************************************
+ * Summary:
+ *  Returns the newest checkpoint if it belongs to the given file.
+ *
+ * Parameters:
+ *  pFileContext:   OTA file context of the file being received.
+ *  pCheckpoint:    Receives the checkpoint.
+ *
+ * Return:
+ *  true if a checkpoint of this file was found, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaCheckpoint_Load( const OtaFileContext_t * pFileContext,
+        OtaCheckpoint_t * pCheckpoint )
+{
+    OtaCheckpoint_Describe( pCheckpoint, pFileContext );
+
+    if( ( latestValid == false ) || ( latestRecord.checkpoint.numBlocks == 0U ) ||
+            ( latestRecord.checkpoint.numBlocks != pCheckpoint->numBlocks ) ||
+            ( latestRecord.checkpoint.fileSize != pCheckpoint->fileSize ) ||
+            ( latestRecord.checkpoint.serverFileId != pCheckpoint->serverFileId ) ||
+            ( strncmp( latestRecord.checkpoint.jobName, pCheckpoint->jobName, OTA_CHECKPOINT_MAX_NAME_LENGTH ) != 0 ) ||
+            ( strncmp( latestRecord.checkpoint.streamName, pCheckpoint->streamName, OTA_CHECKPOINT_MAX_NAME_LENGTH ) != 0 ) )
+    {
+        return false;
+    }
+
+    memcpy( pCheckpoint->durableBitmap, latestRecord.checkpoint.durableBitmap,
+            sizeof( pCheckpoint->durableBitmap ) );
+    memcpy( pCheckpoint->blockCrcs, latestRecord.checkpoint.blockCrcs,
+            sizeof( pCheckpoint->blockCrcs ) );
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: OtaCheckpoint_Clear()
+ *******************************************************************************
+ * Summary:
+ *  Invalidates the checkpoint once the file is closed or aborted, by appending
+ *  an empty record.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaCheckpoint_Clear( void )
+{
+    static OtaCheckpoint_t emptyCheckpoint;
+
+    if( ( latestValid == true ) && ( latestRecord.checkpoint.numBlocks != 0U ) )
+    {
+        memset( &emptyCheckpoint, 0x00, sizeof( emptyCheckpoint ) );
+        ( void ) OtaCheckpoint_Save( &emptyCheckpoint );
+    }
+}
+
+#endif /* ( OTA_CHECKPOINT_ENABLE == 1 ) */
+
+/* [] END OF FILE */
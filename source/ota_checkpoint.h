@@ -0,0 +1,121 @@
+/********************************************************************************
+ * File Name: ota_checkpoint.h
+ *
+ * Description: The API of the OTA download checkpoint that persists the progress
+ * of a download so that it resumes after a reset.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef OTA_CHECKPOINT_H_
+#define OTA_CHECKPOINT_H_
+
+/* Standard includes. */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* OTA Library include. */
+#include "ota.h"
+
+/* OTA flash writer include, for the size of the durable block bitmap. */
+#include "ota_flash_writer.h"
+
+
+/* Set to 1 to checkpoint the download progress to flash so that a download
+ * interrupted by a reset resumes with the missing blocks only. Requires the
+ * checkpoint area in external flash. */
+#ifndef OTA_CHECKPOINT_ENABLE
+#ifdef CY_BOOT_USE_EXTERNAL_FLASH
+#define OTA_CHECKPOINT_ENABLE               (1U)
+#else
+#define OTA_CHECKPOINT_ENABLE               (0U)
+#endif
+#endif
+
+/* Start of the checkpoint area in external flash, rounded up to an erase
+ * sector. The area spans two erase sectors and by default follows the
+ * secondary slot. */
+#ifndef OTA_CHECKPOINT_FLASH_ADDRESS
+#define OTA_CHECKPOINT_FLASH_ADDRESS        ( CY_BOOT_SECONDARY_1_START + CY_BOOT_SECONDARY_1_SIZE )
+#endif
+
+/* Number of newly durable blocks after which a checkpoint is written. */
+#ifndef OTA_CHECKPOINT_BLOCK_INTERVAL
+#define OTA_CHECKPOINT_BLOCK_INTERVAL       (16U)
+#endif
+
+/* Flash space taken by one checkpoint record, a multiple of the program page.
+ * Most of it holds the CRCs of the durable blocks. */
+#define OTA_CHECKPOINT_RECORD_SIZE          (2560U)
+
+/* Initial value of the CRC of a block. */
+#define OTA_CHECKPOINT_BLOCK_CRC_INIT       (0xFFFFU)
+
+/* Maximum length of the job and stream names kept in a checkpoint. */
+#define OTA_CHECKPOINT_MAX_NAME_LENGTH      (64U)
+
+/* Identity and progress of the file being received. */
+typedef struct OtaCheckpoint
+{
+    uint32_t fileSize;
+    uint32_t serverFileId;
+    uint32_t numBlocks;
+    char jobName[ OTA_CHECKPOINT_MAX_NAME_LENGTH ];
+    char streamName[ OTA_CHECKPOINT_MAX_NAME_LENGTH ];
+    uint8_t durableBitmap[ ( OTA_FLASH_WRITER_MAX_FILE_BLOCKS + 7U ) / 8U ];
+    uint16_t blockCrcs[ OTA_FLASH_WRITER_MAX_FILE_BLOCKS ];    /* CRC of every durable block. */
+} OtaCheckpoint_t;
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+bool OtaCheckpoint_Init( void );
+
+void OtaCheckpoint_Describe( OtaCheckpoint_t * pCheckpoint,
+        const OtaFileContext_t * pFileContext );
+
+bool OtaCheckpoint_Save( const OtaCheckpoint_t * pCheckpoint );
+
+bool OtaCheckpoint_Load( const OtaFileContext_t * pFileContext,
+        OtaCheckpoint_t * pCheckpoint );
+
+void OtaCheckpoint_Clear( void );
+
+uint16_t OtaCheckpoint_BlockCrc( uint16_t crc,
+        const uint8_t * pData,
+        size_t length );
+
+
+#endif /* ifndef OTA_CHECKPOINT_H_ */
@@ -0,0 +1,365 @@
+/********************************************************************************
+ * File Name: ota_decompress.c
+ *
+ * Description: Implementation of the streaming LZSS decompression stage.
+ * Decompresses an update file as it is received, with a fixed window of
+ * history as the only buffer.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* Include header for the decompression stage. */
+#include "ota_decompress.h"
+
+/* Stream header: magic, format version, log2 of the window used by the
+ * compressor, two reserved bytes and the size of the original file, little
+ * endian.
+ *
+ * The header is followed by groups of a flag byte and eight tokens, least
+ * significant flag first. A set flag marks a literal byte. A clear flag marks
+ * a two byte little endian match: the low window bits hold the distance minus
+ * one, the remaining bits the length minus OTA_DECOMPRESS_MIN_MATCH. */
+#define STREAM_MAGIC                    "OTAZ"
+#define STREAM_MAGIC_LENGTH             (4U)
+#define STREAM_VERSION                  (1U)
+#define STREAM_HEADER_SIZE              (12U)
+#define STREAM_MIN_WINDOW_BITS          (8U)
+
+/* Shortest match, shorter runs are coded as literals. */
+#define OTA_DECOMPRESS_MIN_MATCH        (3U)
+
+/* Parser states. */
+typedef enum DecompressState
+{
+    DECOMPRESS_STATE_HEADER = 0,
+    DECOMPRESS_STATE_FLAGS,
+    DECOMPRESS_STATE_TOKEN,
+    DECOMPRESS_STATE_MATCH,
+    DECOMPRESS_STATE_DONE,
+    DECOMPRESS_STATE_ERROR
+} DecompressState_t;
+
+/* State of the file being decompressed. */
+typedef struct OtaDecompress
+{
+    DecompressState_t state;
+    OtaDecompressOutput_t output;
+    uint8_t header[ STREAM_HEADER_SIZE ];
+    uint32_t headerLength;
+    uint32_t windowBits;            /* Window of the compressor. */
+    uint32_t originalSize;
+    uint32_t produced;              /* Bytes decompressed. */
+    uint32_t flushed;               /* Bytes handed to the output. */
+    uint8_t flags;                  /* Remaining flags of the group. */
+    uint8_t flagCount;
+    uint8_t matchLow;               /* First byte of a match token. */
+    uint8_t window[ OTA_DECOMPRESS_WINDOW_SIZE ];
+    OtaDecompressStatistics_t statistics;
+} OtaDecompress_t;
+
+/* File being decompressed. Only accessed from the flash writer task, and
+ * from the OTA agent while the writer is idle. */
+static OtaDecompress_t decompress;
+
+
+/*******************************************************************************
+ * Function Name: putByte()
+ *******************************************************************************
+ * Summary:
+ *  Appends a decompressed byte to the window. The output receives the window
+ *  half by half as it fills, so no separate output buffer is needed.
+ *
+ * Parameters:
+ *  value: Decompressed byte.
+ *
+ * Return:
+ *  true on success, false if the output failed.
+ *
+ *******************************************************************************/
+static bool putByte( uint8_t value )
+{
+    bool status = true;
+
+    decompress.window[ decompress.produced % OTA_DECOMPRESS_WINDOW_SIZE ] = value;
+    decompress.produced++;
+
+    if( ( ( decompress.produced % OTA_DECOMPRESS_CHUNK_SIZE ) == 0U ) ||
+            ( decompress.produced == decompress.originalSize ) )
+    {
+        status = decompress.output( &decompress.window[ decompress.flushed % OTA_DECOMPRESS_WINDOW_SIZE ],
+                decompress.produced - decompress.flushed );
+        decompress.statistics.outputBytes += decompress.produced - decompress.flushed;
+        decompress.flushed = decompress.produced;
+    }
+
+    return status;
+}
+
+/*******************************************************************************
+ * Function Name: checkHeader()
+ *******************************************************************************
+ * Summary:
+ *  Validates the stream header.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  true if the stream can be decompressed, false otherwise.
+ *
+ *******************************************************************************/
+static bool checkHeader( void )
+{
+    decompress.windowBits = decompress.header[ STREAM_MAGIC_LENGTH + 1U ];
+    decompress.originalSize = ( ( uint32_t ) decompress.header[ 8 ] ) |
+            ( ( uint32_t ) decompress.header[ 9 ] << 8 ) |
+            ( ( uint32_t ) decompress.header[ 10 ] << 16 ) |
+            ( ( uint32_t ) decompress.header[ 11 ] << 24 );
+    decompress.statistics.originalSize = decompress.originalSize;
+
+    if( ( memcmp( decompress.header, STREAM_MAGIC, STREAM_MAGIC_LENGTH ) != 0 ) ||
+            ( decompress.header[ STREAM_MAGIC_LENGTH ] != STREAM_VERSION ) )
+    {
+        printf("Update file is not a compressed stream of a supported version.\n");
+        return false;
+    }
+
+    if( ( decompress.windowBits < STREAM_MIN_WINDOW_BITS ) ||
+            ( decompress.windowBits > OTA_DECOMPRESS_WINDOW_BITS ) || ( decompress.originalSize == 0U ) )
+    {
+        printf("Compressed stream needs a %u byte window, %u bytes available.\n",
+                (unsigned int)( 1UL << decompress.windowBits ), (unsigned int)OTA_DECOMPRESS_WINDOW_SIZE);
+        return false;
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: nextToken()
+ *******************************************************************************
+ * Summary:
+ *  Consumes the flag of the decoded token and selects the next state.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  The next parser state.
+ *
+ *******************************************************************************/
+static DecompressState_t nextToken( void )
+{
+    decompress.flags >>= 1;
+    decompress.flagCount--;
+
+    if( decompress.produced == decompress.originalSize )
+    {
+        return DECOMPRESS_STATE_DONE;
+    }
+
+    return ( decompress.flagCount == 0U ) ? DECOMPRESS_STATE_FLAGS : DECOMPRESS_STATE_TOKEN;
+}
+
+/*******************************************************************************
+ * Function Name: processByte()
+ *******************************************************************************
+ * Summary:
+ *  Advances the decompressor by one byte of the compressed stream.
+ *
+ * Parameters:
+ *  value: Compressed byte.
+ *
+ * Return:
+ *  The next parser state.
+ *
+ *******************************************************************************/
+static DecompressState_t processByte( uint8_t value )
+{
+    uint32_t token;
+    uint32_t distance;
+    uint32_t length;
+
+    switch( decompress.state )
+    {
+    case DECOMPRESS_STATE_HEADER:
+        decompress.header[ decompress.headerLength++ ] = value;
+        if( decompress.headerLength < STREAM_HEADER_SIZE )
+        {
+            return DECOMPRESS_STATE_HEADER;
+        }
+        return ( checkHeader() == true ) ? DECOMPRESS_STATE_FLAGS : DECOMPRESS_STATE_ERROR;
+
+    case DECOMPRESS_STATE_FLAGS:
+        decompress.flags = value;
+        decompress.flagCount = 8U;
+        return DECOMPRESS_STATE_TOKEN;
+
+    case DECOMPRESS_STATE_TOKEN:
+        if( ( decompress.flags & 1U ) == 0U )
+        {
+            decompress.matchLow = value;
+            return DECOMPRESS_STATE_MATCH;
+        }
+
+        decompress.statistics.literals++;
+        return ( putByte( value ) == true ) ? nextToken() : DECOMPRESS_STATE_ERROR;
+
+    case DECOMPRESS_STATE_MATCH:
+        token = ( uint32_t ) decompress.matchLow | ( ( uint32_t ) value << 8 );
+        distance = ( token & ( ( 1UL << decompress.windowBits ) - 1U ) ) + 1U;
+        length = ( token >> decompress.windowBits ) + OTA_DECOMPRESS_MIN_MATCH;
+
+        if( ( distance > decompress.produced ) ||
+                ( length > ( decompress.originalSize - decompress.produced ) ) )
+        {
+            printf("Compressed stream holds an invalid match.\n");
+            return DECOMPRESS_STATE_ERROR;
+        }
+
+        decompress.statistics.matches++;
+        while( length-- > 0U )
+        {
+            if( putByte( decompress.window[ ( decompress.produced - distance ) % OTA_DECOMPRESS_WINDOW_SIZE ] ) == false )
+            {
+                return DECOMPRESS_STATE_ERROR;
+            }
+        }
+        return nextToken();
+
+    case DECOMPRESS_STATE_DONE:
+        printf("Compressed stream continues past the end of the file.\n");
+        return DECOMPRESS_STATE_ERROR;
+
+    default:
+        return DECOMPRESS_STATE_ERROR;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: OtaDecompress_Begin()
+ *******************************************************************************
+ * Summary:
+ *  Prepares to decompress a file.
+ *
+ * Parameters:
+ *  output: Receives the decompressed data in order, in chunks of
+ *          OTA_DECOMPRESS_CHUNK_SIZE except for the last one.
+ *
+ * Return:
+ *  true on success, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaDecompress_Begin( OtaDecompressOutput_t output )
+{
+    memset( &decompress, 0x00, sizeof( decompress ) );
+
+    decompress.output = output;
+    decompress.state = ( output != NULL ) ? DECOMPRESS_STATE_HEADER : DECOMPRESS_STATE_ERROR;
+
+    return ( output != NULL );
+}
+
+/*******************************************************************************
+ * Function Name: OtaDecompress_Process()
+ *******************************************************************************
+ * Summary:
+ *  Decompresses the next bytes of the file. Must be fed the file in order.
+ *
+ * Parameters:
+ *  pData:  Next bytes of the compressed file.
+ *  length: Number of bytes.
+ *
+ * Return:
+ *  true on success, false if the stream is invalid or the output failed.
+ *
+ *******************************************************************************/
+bool OtaDecompress_Process( const uint8_t * pData,
+        uint32_t length )
+{
+    uint32_t index;
+
+    for( index = 0U; ( index < length ) && ( decompress.state != DECOMPRESS_STATE_ERROR ); index++ )
+    {
+        decompress.state = processByte( pData[ index ] );
+    }
+
+    decompress.statistics.compressedBytes += index;
+
+    return ( decompress.state != DECOMPRESS_STATE_ERROR );
+}
+
+/*******************************************************************************
+ * Function Name: OtaDecompress_End()
+ *******************************************************************************
+ * Summary:
+ *  Ends decompressing the file.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  true if the whole file was decompressed, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaDecompress_End( void )
+{
+    return ( decompress.state == DECOMPRESS_STATE_DONE );
+}
+
+/*******************************************************************************
+ * Function Name: OtaDecompress_GetStatistics()
+ *******************************************************************************
+ * Summary:
+ *  Returns the statistics of the last decompressed file.
+ *
+ * Parameters:
+ *  pStatistics: Pointer to the structure receiving the statistics.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaDecompress_GetStatistics( OtaDecompressStatistics_t * pStatistics )
+{
+    if( pStatistics != NULL )
+    {
+        *pStatistics = decompress.statistics;
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,97 @@
+/********************************************************************************
+ * File Name: ota_decompress.h
+ *
+ * Description: Defines the API of the streaming LZSS decompression stage
+ * applied to compressed update files.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef OTA_DECOMPRESS_H_
+#define OTA_DECOMPRESS_H_
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/* Suffix of the update file name marking a compressed file. */
+#ifndef OTA_DECOMPRESS_FILE_SUFFIX
+#define OTA_DECOMPRESS_FILE_SUFFIX      ".lz"
+#endif
+
+/* Log2 of the size of the history window. Files compressed with a larger
+ * window are rejected. Half of the window is handed to the output at a time,
+ * which must be a multiple of the flash row size. */
+#ifndef OTA_DECOMPRESS_WINDOW_BITS
+#define OTA_DECOMPRESS_WINDOW_BITS      (10U)
+#endif
+
+#if ( OTA_DECOMPRESS_WINDOW_BITS < 10U ) || ( OTA_DECOMPRESS_WINDOW_BITS > 12U )
+#error "OTA_DECOMPRESS_WINDOW_BITS must be between 10 and 12."
+#endif
+
+#define OTA_DECOMPRESS_WINDOW_SIZE      ( 1UL << OTA_DECOMPRESS_WINDOW_BITS )
+
+/* Bytes handed to the output at a time. Only the last chunk is shorter. */
+#define OTA_DECOMPRESS_CHUNK_SIZE       ( OTA_DECOMPRESS_WINDOW_SIZE / 2U )
+
+/* Receives the decompressed data in order. */
+typedef bool (* OtaDecompressOutput_t)( const uint8_t * pData,
+        uint32_t length );
+
+/* Statistics of the file being decompressed. */
+typedef struct OtaDecompressStatistics
+{
+    uint32_t compressedBytes;       /* Compressed bytes consumed. */
+    uint32_t outputBytes;           /* Decompressed bytes handed to the output. */
+    uint32_t originalSize;          /* Size of the file before compression. */
+    uint32_t literals;              /* Literal tokens decoded. */
+    uint32_t matches;               /* Match tokens decoded. */
+} OtaDecompressStatistics_t;
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+bool OtaDecompress_Begin( OtaDecompressOutput_t output );
+
+bool OtaDecompress_Process( const uint8_t * pData,
+        uint32_t length );
+
+bool OtaDecompress_End( void );
+
+void OtaDecompress_GetStatistics( OtaDecompressStatistics_t * pStatistics );
+
+
+#endif /* ifndef OTA_DECOMPRESS_H_ */
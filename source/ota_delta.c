@@ -0,0 +1,670 @@
+/********************************************************************************
+ * File Name: ota_delta.c
+ *
+ * Description: Implementation of the delta update stage. Applies a binary patch
+ * as it is received, reading the running image from the primary slot and
+ * programming the rebuilt image to the secondary slot.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* OTA PAL include. */
+#include "cy_ota_storage.h"
+
+/* MCUboot flash map, to read the image running in the primary slot. */
+#include "sysflash/sysflash.h"
+#include "flash_map_backend/flash_map_backend.h"
+
+/* Include header for the delta update stage. */
+#include "ota_delta.h"
+
+/* Patch header: magic, format version and three reserved bytes, followed by
+ * the size and CRC-32 of the image the patch applies to and the size of the
+ * image it rebuilds, all little endian.
+ *
+ * The header is followed by records until the image is complete. A record
+ * holds three varints: the length of its add section, the length of its
+ * insert section and the zigzag encoded seek in the running image applied
+ * after the record. The add section rebuilds bytes as the sum of the running
+ * image and a difference; it is coded as pairs of a run of zero differences
+ * and a count of difference bytes that follow. The insert section holds new
+ * bytes verbatim. */
+#define PATCH_MAGIC                     "OTAD"
+#define PATCH_MAGIC_LENGTH              (4U)
+#define PATCH_VERSION                   (1U)
+#define PATCH_HEADER_SIZE               (20U)
+
+/* Largest shift of a varint group, a varint holds at most 32 bits. */
+#define VARINT_MAX_SHIFT                (28U)
+
+/* Parser states, one per field of the patch. */
+typedef enum PatchState
+{
+    PATCH_STATE_HEADER = 0,
+    PATCH_STATE_ADD_LENGTH,
+    PATCH_STATE_INSERT_LENGTH,
+    PATCH_STATE_SEEK,
+    PATCH_STATE_ZERO_RUN,
+    PATCH_STATE_LITERAL_COUNT,
+    PATCH_STATE_LITERAL,
+    PATCH_STATE_INSERT,
+    PATCH_STATE_DONE,
+    PATCH_STATE_ERROR
+} PatchState_t;
+
+/* State of the patch being applied. */
+typedef struct OtaDelta
+{
+    PatchState_t state;
+    OtaFileContext_t * pFileContext;
+    const struct flash_area * pOldArea;
+    uint32_t imageLimit;            /* Bytes of the secondary slot the image may use. */
+    uint8_t header[ PATCH_HEADER_SIZE ];
+    uint32_t headerLength;
+    uint32_t varint;                /* Varint being decoded. */
+    uint32_t varintShift;
+    uint32_t oldSize;
+    uint32_t newSize;
+    uint32_t oldPosition;           /* Next byte of the running image. */
+    uint32_t addRemaining;          /* Bytes left in the add section. */
+    uint32_t insertLength;          /* Length of the insert section. */
+    int32_t seek;                   /* Seek applied after the record. */
+    uint32_t zeroRun;               /* Last run of zero differences. */
+    uint32_t runRemaining;          /* Bytes left in the literal or insert run. */
+    uint32_t produced;              /* Bytes of the image rebuilt. */
+    uint32_t outputOffset;          /* Image offset of the output chunk. */
+    uint32_t outputLength;          /* Bytes in the output chunk. */
+    uint32_t oldCacheOffset;
+    uint32_t oldCacheLength;
+    uint8_t output[ OTA_DELTA_OUTPUT_CHUNK_SIZE ];
+    uint8_t oldCache[ OTA_DELTA_OLD_CACHE_SIZE ];
+    OtaDeltaStatistics_t statistics;
+} OtaDelta_t;
+
+/* Patch being applied. Only accessed from the flash writer task, and from
+ * the OTA agent while the writer is idle. */
+static OtaDelta_t delta;
+
+
+/*******************************************************************************
+ * Function Name: readLittleEndian32()
+ *******************************************************************************
+ * Summary:
+ *  Reads a little endian 32-bit value.
+ *
+ * Parameters:
+ *  pData: Pointer to the value.
+ *
+ * Return:
+ *  The value.
+ *
+ *******************************************************************************/
+static uint32_t readLittleEndian32( const uint8_t * pData )
+{
+    return ( ( uint32_t ) pData[ 0 ] ) | ( ( uint32_t ) pData[ 1 ] << 8 ) |
+            ( ( uint32_t ) pData[ 2 ] << 16 ) | ( ( uint32_t ) pData[ 3 ] << 24 );
+}
+
+/*******************************************************************************
+ * Function Name: crc32Update()
+ *******************************************************************************
+ * Summary:
+ *  Continues a CRC-32 (IEEE 802.3) over more data. Start with 0xFFFFFFFF and
+ *  invert the final value.
+ *
+ * Parameters:
+ *  crc:    CRC of the data so far.
+ *  pData:  Data to add.
+ *  length: Number of bytes to add.
+ *
+ * Return:
+ *  The updated CRC.
+ *
+ *******************************************************************************/
+static uint32_t crc32Update( uint32_t crc,
+        const uint8_t * pData,
+        uint32_t length )
+{
+    uint32_t bit;
+
+    while( length-- > 0U )
+    {
+        crc ^= *pData++;
+        for( bit = 0U; bit < 8U; bit++ )
+        {
+            crc = ( crc >> 1 ) ^ ( 0xEDB88320UL & ( 0U - ( crc & 1U ) ) );
+        }
+    }
+
+    return crc;
+}
+
+/*******************************************************************************
+ * Function Name: readOldByte()
+ *******************************************************************************
+ * Summary:
+ *  Reads the next byte of the running image through the read cache.
+ *
+ * Parameters:
+ *  pByte: Receives the byte.
+ *
+ * Return:
+ *  true on success, false past the end of the running image or on a read
+ *  error.
+ *
+ *******************************************************************************/
+static bool readOldByte( uint8_t * pByte )
+{
+    uint32_t length;
+
+    if( delta.oldPosition >= delta.oldSize )
+    {
+        return false;
+    }
+
+    if( ( delta.oldPosition < delta.oldCacheOffset ) ||
+            ( delta.oldPosition >= ( delta.oldCacheOffset + delta.oldCacheLength ) ) )
+    {
+        length = delta.oldSize - delta.oldPosition;
+        if( length > sizeof( delta.oldCache ) )
+        {
+            length = sizeof( delta.oldCache );
+        }
+
+        if( flash_area_read( delta.pOldArea, delta.oldPosition, delta.oldCache, length ) != 0 )
+        {
+            delta.oldCacheLength = 0U;
+            return false;
+        }
+
+        delta.oldCacheOffset = delta.oldPosition;
+        delta.oldCacheLength = length;
+        delta.statistics.oldBytesRead += length;
+    }
+
+    *pByte = delta.oldCache[ delta.oldPosition - delta.oldCacheOffset ];
+    delta.oldPosition++;
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: emitByte()
+ *******************************************************************************
+ * Summary:
+ *  Appends a byte to the rebuilt image. Full chunks and the last chunk of the
+ *  image are programmed through the OTA PAL; the last chunk is padded with
+ *  the erased value to keep every write a whole number of flash rows.
+ *
+ * Parameters:
+ *  value: Byte of the rebuilt image.
+ *
+ * Return:
+ *  true on success, false if the image overruns its size or a write fails.
+ *
+ *******************************************************************************/
+static bool emitByte( uint8_t value )
+{
+    if( delta.produced >= delta.newSize )
+    {
+        printf("Delta patch rebuilds more than %u bytes.\n", (unsigned int)delta.newSize);
+        return false;
+    }
+
+    delta.output[ delta.outputLength++ ] = value;
+    delta.produced++;
+
+    if( ( delta.outputLength == sizeof( delta.output ) ) || ( delta.produced == delta.newSize ) )
+    {
+        delta.statistics.imageBytes += delta.outputLength;
+
+        memset( &delta.output[ delta.outputLength ], flash_area_erased_val( delta.pOldArea ),
+                sizeof( delta.output ) - delta.outputLength );
+
+        if( cy_awsport_ota_flash_write_block( delta.pFileContext, delta.outputOffset,
+                delta.output, sizeof( delta.output ) ) != ( int16_t ) sizeof( delta.output ) )
+        {
+            printf("Failed to program the rebuilt image at offset %u.\n",
+                    (unsigned int)delta.outputOffset);
+            return false;
+        }
+
+        delta.outputOffset += sizeof( delta.output );
+        delta.outputLength = 0U;
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: checkHeader()
+ *******************************************************************************
+ * Summary:
+ *  Validates the patch header and checks that the running image is the one
+ *  the patch was made against.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  true if the patch applies to the running image, false otherwise.
+ *
+ *******************************************************************************/
+static bool checkHeader( void )
+{
+    uint32_t oldCrc = 0xFFFFFFFFUL;
+    uint32_t offset;
+    uint32_t length;
+
+    if( ( memcmp( delta.header, PATCH_MAGIC, PATCH_MAGIC_LENGTH ) != 0 ) ||
+            ( delta.header[ PATCH_MAGIC_LENGTH ] != PATCH_VERSION ) )
+    {
+        printf("Update file is not a delta patch of a supported version.\n");
+        return false;
+    }
+
+    delta.oldSize = readLittleEndian32( &delta.header[ 8 ] );
+    delta.newSize = readLittleEndian32( &delta.header[ 16 ] );
+    delta.statistics.imageSize = delta.newSize;
+
+    if( ( delta.oldSize > delta.pOldArea->fa_size ) || ( delta.newSize == 0U ) ||
+            ( delta.newSize > ( delta.imageLimit - ( delta.imageLimit % OTA_DELTA_OUTPUT_CHUNK_SIZE ) ) ) )
+    {
+        printf("Delta patch sizes do not fit the image slots: old %u, new %u bytes.\n",
+                (unsigned int)delta.oldSize, (unsigned int)delta.newSize);
+        return false;
+    }
+
+    for( offset = 0U; offset < delta.oldSize; offset += length )
+    {
+        length = delta.oldSize - offset;
+        if( length > sizeof( delta.oldCache ) )
+        {
+            length = sizeof( delta.oldCache );
+        }
+
+        if( flash_area_read( delta.pOldArea, offset, delta.oldCache, length ) != 0 )
+        {
+            return false;
+        }
+
+        oldCrc = crc32Update( oldCrc, delta.oldCache, length );
+    }
+
+    delta.oldCacheLength = 0U;
+
+    if( ~oldCrc != readLittleEndian32( &delta.header[ 12 ] ) )
+    {
+        printf("Delta patch was made against a different image than the running one.\n");
+        return false;
+    }
+
+    printf("Applying delta patch: %u byte image rebuilt from the %u byte running image.\n",
+            (unsigned int)delta.newSize, (unsigned int)delta.oldSize);
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: decodeVarint()
+ *******************************************************************************
+ * Summary:
+ *  Adds a byte to the varint being decoded, seven bits per byte, least
+ *  significant group first.
+ *
+ * Parameters:
+ *  value:      Byte of the patch.
+ *  pComplete:  Set to true once the last byte of the varint was added.
+ *
+ * Return:
+ *  true on success, false if the varint exceeds 32 bits.
+ *
+ *******************************************************************************/
+static bool decodeVarint( uint8_t value,
+        bool * pComplete )
+{
+    delta.varint |= ( uint32_t ) ( value & 0x7FU ) << delta.varintShift;
+    *pComplete = ( ( value & 0x80U ) == 0U );
+
+    if( *pComplete == false )
+    {
+        delta.varintShift += 7U;
+        if( delta.varintShift > VARINT_MAX_SHIFT )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: finishSection()
+ *******************************************************************************
+ * Summary:
+ *  Selects the next state once a run of the current record is complete, and
+ *  applies the seek at the end of the record.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  The next parser state.
+ *
+ *******************************************************************************/
+static PatchState_t finishSection( void )
+{
+    int64_t position;
+
+    if( delta.addRemaining > 0U )
+    {
+        return PATCH_STATE_ZERO_RUN;
+    }
+
+    if( delta.insertLength > 0U )
+    {
+        delta.runRemaining = delta.insertLength;
+        delta.insertLength = 0U;
+        return PATCH_STATE_INSERT;
+    }
+
+    position = ( int64_t ) delta.oldPosition + delta.seek;
+    if( ( position < 0 ) || ( position > ( int64_t ) delta.oldSize ) )
+    {
+        printf("Delta patch seeks outside of the running image.\n");
+        return PATCH_STATE_ERROR;
+    }
+
+    delta.oldPosition = ( uint32_t ) position;
+    delta.statistics.records++;
+
+    return ( delta.produced == delta.newSize ) ? PATCH_STATE_DONE : PATCH_STATE_ADD_LENGTH;
+}
+
+/*******************************************************************************
+ * Function Name: processByte()
+ *******************************************************************************
+ * Summary:
+ *  Advances the patch parser by one byte.
+ *
+ * Parameters:
+ *  value: Byte of the patch.
+ *
+ * Return:
+ *  The next parser state.
+ *
+ *******************************************************************************/
+static PatchState_t processByte( uint8_t value )
+{
+    PatchState_t state = delta.state;
+    bool complete = false;
+    uint8_t oldValue = 0U;
+    uint32_t count;
+
+    switch( state )
+    {
+    case PATCH_STATE_HEADER:
+        delta.header[ delta.headerLength++ ] = value;
+        if( delta.headerLength == PATCH_HEADER_SIZE )
+        {
+            state = ( checkHeader() == true ) ? PATCH_STATE_ADD_LENGTH : PATCH_STATE_ERROR;
+        }
+        return state;
+
+    case PATCH_STATE_LITERAL:
+        if( ( readOldByte( &oldValue ) == false ) || ( emitByte( ( uint8_t ) ( oldValue + value ) ) == false ) )
+        {
+            return PATCH_STATE_ERROR;
+        }
+        delta.addRemaining--;
+        return ( --delta.runRemaining == 0U ) ? finishSection() : state;
+
+    case PATCH_STATE_INSERT:
+        if( emitByte( value ) == false )
+        {
+            return PATCH_STATE_ERROR;
+        }
+        return ( --delta.runRemaining == 0U ) ? finishSection() : state;
+
+    case PATCH_STATE_DONE:
+        printf("Delta patch continues past the end of the image.\n");
+        return PATCH_STATE_ERROR;
+
+    case PATCH_STATE_ERROR:
+        return state;
+
+    default:
+        break;
+    }
+
+    /* All other fields are varints. */
+    if( decodeVarint( value, &complete ) == false )
+    {
+        return PATCH_STATE_ERROR;
+    }
+
+    if( complete == false )
+    {
+        return state;
+    }
+
+    count = delta.varint;
+    delta.varint = 0U;
+    delta.varintShift = 0U;
+
+    switch( state )
+    {
+    case PATCH_STATE_ADD_LENGTH:
+        delta.addRemaining = count;
+        state = PATCH_STATE_INSERT_LENGTH;
+        break;
+
+    case PATCH_STATE_INSERT_LENGTH:
+        delta.insertLength = count;
+        if( ( ( delta.addRemaining == 0U ) && ( count == 0U ) ) ||
+                ( ( ( uint64_t ) delta.addRemaining + count ) > ( delta.newSize - delta.produced ) ) )
+        {
+            printf("Delta patch record does not fit the image.\n");
+            state = PATCH_STATE_ERROR;
+        }
+        else
+        {
+            state = PATCH_STATE_SEEK;
+        }
+        break;
+
+    case PATCH_STATE_SEEK:
+        delta.seek = ( int32_t ) ( count >> 1 ) ^ -( int32_t ) ( count & 1U );
+        state = finishSection();
+        break;
+
+    case PATCH_STATE_ZERO_RUN:
+        if( count > delta.addRemaining )
+        {
+            state = PATCH_STATE_ERROR;
+            break;
+        }
+
+        /* Unchanged bytes are copied from the running image. */
+        delta.zeroRun = count;
+        delta.addRemaining -= count;
+        state = PATCH_STATE_LITERAL_COUNT;
+        while( count-- > 0U )
+        {
+            if( ( readOldByte( &oldValue ) == false ) || ( emitByte( oldValue ) == false ) )
+            {
+                state = PATCH_STATE_ERROR;
+                break;
+            }
+        }
+        break;
+
+    case PATCH_STATE_LITERAL_COUNT:
+        if( ( count > delta.addRemaining ) || ( ( count == 0U ) && ( delta.zeroRun == 0U ) ) )
+        {
+            state = PATCH_STATE_ERROR;
+        }
+        else if( count == 0U )
+        {
+            state = finishSection();
+        }
+        else
+        {
+            delta.runRemaining = count;
+            state = PATCH_STATE_LITERAL;
+        }
+        break;
+
+    default:
+        state = PATCH_STATE_ERROR;
+        break;
+    }
+
+    return state;
+}
+
+/*******************************************************************************
+ * Function Name: OtaDelta_Begin()
+ *******************************************************************************
+ * Summary:
+ *  Prepares to rebuild an image from a patch. The image is programmed from
+ *  the start of the secondary slot, which must already be erased.
+ *
+ * Parameters:
+ *  pFileContext:   OTA file context of the patch, used to program the image.
+ *  imageLimit:     Bytes at the start of the secondary slot the image may use.
+ *
+ * Return:
+ *  true on success, false if the running image cannot be read.
+ *
+ *******************************************************************************/
+bool OtaDelta_Begin( OtaFileContext_t * pFileContext,
+        uint32_t imageLimit )
+{
+    memset( &delta, 0x00, sizeof( delta ) );
+
+    if( flash_area_open( FLASH_AREA_IMAGE_PRIMARY( 0 ), &delta.pOldArea ) != 0 )
+    {
+        delta.pOldArea = NULL;
+        delta.state = PATCH_STATE_ERROR;
+        return false;
+    }
+
+    delta.pFileContext = pFileContext;
+    delta.imageLimit = imageLimit;
+    delta.state = PATCH_STATE_HEADER;
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: OtaDelta_Process()
+ *******************************************************************************
+ * Summary:
+ *  Applies the next bytes of the patch. Must be fed the patch in order; the
+ *  rebuilt image is programmed as it is produced, so memory use does not
+ *  depend on the image size.
+ *
+ * Parameters:
+ *  pData:  Next bytes of the patch.
+ *  length: Number of bytes.
+ *
+ * Return:
+ *  true on success, false if the patch is invalid or cannot be applied.
+ *
+ *******************************************************************************/
+bool OtaDelta_Process( const uint8_t * pData,
+        uint32_t length )
+{
+    uint32_t index;
+
+    for( index = 0U; ( index < length ) && ( delta.state != PATCH_STATE_ERROR ); index++ )
+    {
+        delta.state = processByte( pData[ index ] );
+    }
+
+    delta.statistics.patchBytes += index;
+
+    return ( delta.state != PATCH_STATE_ERROR );
+}
+
+/*******************************************************************************
+ * Function Name: OtaDelta_End()
+ *******************************************************************************
+ * Summary:
+ *  Ends applying the patch and releases the running image.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  true if the image was completely rebuilt, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaDelta_End( void )
+{
+    if( delta.pOldArea != NULL )
+    {
+        flash_area_close( delta.pOldArea );
+        delta.pOldArea = NULL;
+    }
+
+    return ( delta.state == PATCH_STATE_DONE );
+}
+
+/*******************************************************************************
+ * Function Name: OtaDelta_GetStatistics()
+ *******************************************************************************
+ * Summary:
+ *  Returns the statistics of the last patch.
+ *
+ * Parameters:
+ *  pStatistics: Pointer to the structure receiving the statistics.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaDelta_GetStatistics( OtaDeltaStatistics_t * pStatistics )
+{
+    if( pStatistics != NULL )
+    {
+        *pStatistics = delta.statistics;
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,92 @@
+/********************************************************************************
+ * File Name: ota_delta.h
+ *
+ * Description: The API of the delta update stage, which rebuilds an update image
+ * from a binary patch and the image running in the primary slot.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef OTA_DELTA_H_
+#define OTA_DELTA_H_
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* OTA Library include. */
+#include "ota.h"
+
+
+/* Suffix of the update file name marking a patch against the running image. */
+#ifndef OTA_DELTA_FILE_SUFFIX
+#define OTA_DELTA_FILE_SUFFIX           ".delta"
+#endif
+
+/* Size of the buffer collecting the rebuilt image before it is programmed.
+ * Must be a multiple of the flash row size. */
+#ifndef OTA_DELTA_OUTPUT_CHUNK_SIZE
+#define OTA_DELTA_OUTPUT_CHUNK_SIZE     (512U)
+#endif
+
+/* Size of the read cache of the running image. */
+#ifndef OTA_DELTA_OLD_CACHE_SIZE
+#define OTA_DELTA_OLD_CACHE_SIZE        (256U)
+#endif
+
+/* Statistics of the patch being applied. */
+typedef struct OtaDeltaStatistics
+{
+    uint32_t patchBytes;            /* Patch bytes consumed. */
+    uint32_t imageBytes;            /* Bytes of the rebuilt image programmed. */
+    uint32_t imageSize;             /* Size of the image the patch rebuilds. */
+    uint32_t oldBytesRead;          /* Bytes read from the running image. */
+    uint32_t records;               /* Patch records applied. */
+} OtaDeltaStatistics_t;
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+bool OtaDelta_Begin( OtaFileContext_t * pFileContext,
+        uint32_t imageLimit );
+
+bool OtaDelta_Process( const uint8_t * pData,
+        uint32_t length );
+
+bool OtaDelta_End( void );
+
+void OtaDelta_GetStatistics( OtaDeltaStatistics_t * pStatistics );
+
+
+#endif /* ifndef OTA_DELTA_H_ */
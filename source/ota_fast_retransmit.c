@@ -0,0 +1,400 @@
+/********************************************************************************
+ * File Name: ota_fast_retransmit.c
+ *
+ * Description: Implementation of the requests for stream blocks found
+ * missing while later blocks of the same request arrive.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <string.h>
+
+/* RTOS includes. */
+#include <FreeRTOS.h>
+#include <task.h>
+
+/* Include header for the flow controller. */
+#include "ota_flow_control.h"
+
+/* Include header for the stream lanes. */
+#include "ota_stream_lanes.h"
+
+/* Include header for the fast retransmit. */
+#include "ota_fast_retransmit.h"
+
+/* Largest number of blocks tracked, one bit each. */
+#define OTA_FAST_RETRANSMIT_BITMAP_SIZE     ( OTA_MAX_BLOCK_BITMAP_SIZE )
+#define OTA_FAST_RETRANSMIT_MAX_BLOCKS      ( OTA_FAST_RETRANSMIT_BITMAP_SIZE * 8U )
+
+/* Blocks asked for by one stream request of the current round. */
+typedef struct OtaFastRetransmitRange
+{
+    uint32_t firstBlock;            /* Lowest block of the request. */
+    uint32_t lastBlock;             /* Highest block of the request. */
+    uint32_t scanBlock;             /* Blocks below were already checked for gaps. */
+} OtaFastRetransmitRange_t;
+
+/* Fast retransmit state of the current job. */
+typedef struct OtaFastRetransmit
+{
+    uint8_t pending[ OTA_FAST_RETRANSMIT_BITMAP_SIZE ];         /* Requested blocks not received yet. */
+    uint8_t gaps[ OTA_FAST_RETRANSMIT_BITMAP_SIZE ];            /* Missing blocks waiting to be asked for. */
+    uint8_t retransmitted[ OTA_FAST_RETRANSMIT_BITMAP_SIZE ];   /* Missing blocks asked for in this round. */
+    OtaFastRetransmitRange_t ranges[ OTA_STREAM_LANES_MAX ];
+    uint32_t numRanges;
+    uint32_t gapCount;
+    TickType_t gapTick;             /* Time the oldest open gap was found. */
+    OtaFastRetransmitStatistics_t statistics;
+} OtaFastRetransmit_t;
+
+/* State of the current job. */
+static OtaFastRetransmit_t fastRetransmit;
+
+
+/*******************************************************************************
+ * Function Name: getDelayTicks()
+ *******************************************************************************
+ * Summary:
+ *  Returns the time a gap is left open before the missing blocks are asked
+ *  for, a quarter of the smoothed RTT within the configured bounds. Blocks
+ *  arriving out of order are received within that time on their own.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  TickType_t: delay in ticks.
+ *
+ *******************************************************************************/
+static TickType_t getDelayTicks( void )
+{
+    OtaFlowControlStatistics_t flowStatistics;
+    uint32_t delayMs;
+
+    OtaFlowControl_GetStatistics( &flowStatistics );
+
+    delayMs = flowStatistics.smoothedRttMs / 4U;
+    if( delayMs < OTA_FAST_RETRANSMIT_MIN_DELAY_MS )
+    {
+        delayMs = OTA_FAST_RETRANSMIT_MIN_DELAY_MS;
+    }
+    else if( delayMs > OTA_FAST_RETRANSMIT_MAX_DELAY_MS )
+    {
+        delayMs = OTA_FAST_RETRANSMIT_MAX_DELAY_MS;
+    }
+
+    return pdMS_TO_TICKS( delayMs );
+}
+
+/*******************************************************************************
+ * Function Name: OtaFastRetransmit_Reset()
+ *******************************************************************************
+ * Summary:
+ *  Forgets the requested blocks and clears the statistics for a new job.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaFastRetransmit_Reset( void )
+{
+    taskENTER_CRITICAL();
+    memset( &fastRetransmit, 0x00, sizeof( fastRetransmit ) );
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaFastRetransmit_OnRequest()
+ *******************************************************************************
+ * Summary:
+ *  Starts a new round with the blocks asked for by the stream request of the
+ *  OTA agent and the lane requests sent after it. Each request asks for the
+ *  next numBlocks missing blocks of the bitmap. Gaps of the previous round
+ *  are dropped, the agent asks for the blocks still missing itself.
+ *
+ * Parameters:
+ *  pBitmap:    Missing blocks of the file, one bit per block.
+ *  bitmapSize: Size of the bitmap.
+ *  numBlocks:  Number of blocks asked for per request.
+ *  requests:   Number of requests sent in this round.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaFastRetransmit_OnRequest( const uint8_t * pBitmap,
+        size_t bitmapSize,
+        uint32_t numBlocks,
+        uint32_t requests )
+{
+    OtaFastRetransmitRange_t * pRange = NULL;
+    uint32_t blockIndex;
+    uint32_t blocksInRange = 0U;
+    uint32_t numRanges = 0U;
+
+    if( ( pBitmap == NULL ) || ( numBlocks == 0U ) )
+    {
+        return;
+    }
+
+    if( bitmapSize > OTA_FAST_RETRANSMIT_BITMAP_SIZE )
+    {
+        bitmapSize = OTA_FAST_RETRANSMIT_BITMAP_SIZE;
+    }
+
+    if( requests > OTA_STREAM_LANES_MAX )
+    {
+        requests = OTA_STREAM_LANES_MAX;
+    }
+
+    taskENTER_CRITICAL();
+
+    memset( fastRetransmit.pending, 0x00, sizeof( fastRetransmit.pending ) );
+    memset( fastRetransmit.gaps, 0x00, sizeof( fastRetransmit.gaps ) );
+    memset( fastRetransmit.retransmitted, 0x00, sizeof( fastRetransmit.retransmitted ) );
+    fastRetransmit.gapCount = 0U;
+
+    for( blockIndex = 0U; blockIndex < ( bitmapSize * 8U ); blockIndex++ )
+    {
+        if( ( pBitmap[ blockIndex / 8U ] & ( 1U << ( blockIndex % 8U ) ) ) == 0U )
+        {
+            continue;
+        }
+
+        if( ( pRange == NULL ) || ( blocksInRange == numBlocks ) )
+        {
+            if( numRanges == requests )
+            {
+                break;
+            }
+
+            pRange = &fastRetransmit.ranges[ numRanges++ ];
+            pRange->firstBlock = blockIndex;
+            pRange->scanBlock = blockIndex;
+            blocksInRange = 0U;
+        }
+
+        pRange->lastBlock = blockIndex;
+        blocksInRange++;
+        fastRetransmit.pending[ blockIndex / 8U ] |= ( uint8_t ) ( 1U << ( blockIndex % 8U ) );
+    }
+
+    fastRetransmit.numRanges = numRanges;
+
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaFastRetransmit_OnBlockReceived()
+ *******************************************************************************
+ * Summary:
+ *  Records a block received from the stream. Blocks of the same request that
+ *  are still missing more than OTA_FAST_RETRANSMIT_REORDER_BLOCKS blocks
+ *  behind it are recorded as gaps.
+ *
+ * Parameters:
+ *  blockIndex: Index of the block in the file.
+ *
+ * Return:
+ *  true if gaps are open for longer than the retransmit delay and should be
+ *  asked for with OtaFastRetransmit_TakeRequest(), false otherwise.
+ *
+ *******************************************************************************/
+bool OtaFastRetransmit_OnBlockReceived( uint32_t blockIndex )
+{
+    OtaFastRetransmitRange_t * pRange = NULL;
+    TickType_t delayTicks;
+    uint32_t scanEnd;
+    uint32_t index;
+    uint8_t blockMask;
+    bool requestDue;
+
+    if( blockIndex >= OTA_FAST_RETRANSMIT_MAX_BLOCKS )
+    {
+        return false;
+    }
+
+    delayTicks = getDelayTicks();
+    blockMask = ( uint8_t ) ( 1U << ( blockIndex % 8U ) );
+
+    taskENTER_CRITICAL();
+
+    if( ( fastRetransmit.retransmitted[ blockIndex / 8U ] & blockMask ) != 0U )
+    {
+        fastRetransmit.retransmitted[ blockIndex / 8U ] &= ( uint8_t ) ~blockMask;
+        fastRetransmit.statistics.blocksRecovered++;
+    }
+
+    if( ( fastRetransmit.gaps[ blockIndex / 8U ] & blockMask ) != 0U )
+    {
+        fastRetransmit.gaps[ blockIndex / 8U ] &= ( uint8_t ) ~blockMask;
+        fastRetransmit.gapCount--;
+        fastRetransmit.statistics.gapsFilled++;
+    }
+
+    fastRetransmit.pending[ blockIndex / 8U ] &= ( uint8_t ) ~blockMask;
+
+    for( index = 0U; index < fastRetransmit.numRanges; index++ )
+    {
+        if( ( blockIndex >= fastRetransmit.ranges[ index ].firstBlock ) &&
+                ( blockIndex <= fastRetransmit.ranges[ index ].lastBlock ) )
+        {
+            pRange = &fastRetransmit.ranges[ index ];
+            break;
+        }
+    }
+
+    /* Blocks of a request are sent in order, a block still missing well
+     * behind the received one was lost. */
+    if( ( pRange != NULL ) && ( blockIndex >= OTA_FAST_RETRANSMIT_REORDER_BLOCKS ) )
+    {
+        scanEnd = blockIndex - OTA_FAST_RETRANSMIT_REORDER_BLOCKS;
+
+        for( index = pRange->scanBlock; index < scanEnd; index++ )
+        {
+            blockMask = ( uint8_t ) ( 1U << ( index % 8U ) );
+            if( ( ( fastRetransmit.pending[ index / 8U ] & blockMask ) != 0U ) &&
+                    ( ( fastRetransmit.gaps[ index / 8U ] & blockMask ) == 0U ) &&
+                    ( ( fastRetransmit.retransmitted[ index / 8U ] & blockMask ) == 0U ) )
+            {
+                if( fastRetransmit.gapCount == 0U )
+                {
+                    fastRetransmit.gapTick = xTaskGetTickCount();
+                }
+
+                fastRetransmit.gaps[ index / 8U ] |= blockMask;
+                fastRetransmit.gapCount++;
+                fastRetransmit.statistics.gapsDetected++;
+            }
+        }
+
+        if( scanEnd > pRange->scanBlock )
+        {
+            pRange->scanBlock = scanEnd;
+        }
+    }
+
+    requestDue = ( fastRetransmit.gapCount > 0U ) &&
+            ( ( xTaskGetTickCount() - fastRetransmit.gapTick ) >= delayTicks );
+
+    taskEXIT_CRITICAL();
+
+    return requestDue;
+}
+
+/*******************************************************************************
+ * Function Name: OtaFastRetransmit_TakeRequest()
+ *******************************************************************************
+ * Summary:
+ *  Takes the open gaps as the blocks of a stream request. Each block is only
+ *  asked for once per round, blocks lost again are left to the next stream
+ *  request of the OTA agent.
+ *
+ * Parameters:
+ *  pBitmap:    Receives the blocks to ask for, one bit per block.
+ *  bitmapSize: Size of the bitmap buffer, at least OTA_MAX_BLOCK_BITMAP_SIZE.
+ *  pNumBlocks: Receives the number of blocks to ask for.
+ *
+ * Return:
+ *  true if blocks are to be asked for, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaFastRetransmit_TakeRequest( uint8_t * pBitmap,
+        size_t bitmapSize,
+        uint32_t * pNumBlocks )
+{
+    uint32_t numBlocks;
+    size_t byteIndex;
+
+    if( ( pBitmap == NULL ) || ( bitmapSize < OTA_FAST_RETRANSMIT_BITMAP_SIZE ) ||
+            ( pNumBlocks == NULL ) )
+    {
+        return false;
+    }
+
+    memset( pBitmap, 0x00, bitmapSize );
+
+    taskENTER_CRITICAL();
+
+    numBlocks = fastRetransmit.gapCount;
+
+    for( byteIndex = 0U; byteIndex < OTA_FAST_RETRANSMIT_BITMAP_SIZE; byteIndex++ )
+    {
+        pBitmap[ byteIndex ] = fastRetransmit.gaps[ byteIndex ];
+        fastRetransmit.retransmitted[ byteIndex ] |= fastRetransmit.gaps[ byteIndex ];
+        fastRetransmit.gaps[ byteIndex ] = 0U;
+    }
+
+    fastRetransmit.gapCount = 0U;
+
+    if( numBlocks > 0U )
+    {
+        fastRetransmit.statistics.requests++;
+        fastRetransmit.statistics.blocksRequested += numBlocks;
+    }
+
+    taskEXIT_CRITICAL();
+
+    *pNumBlocks = numBlocks;
+
+    return ( numBlocks > 0U );
+}
+
+/*******************************************************************************
+ * Function Name: OtaFastRetransmit_GetStatistics()
+ *******************************************************************************
+ * Summary:
+ *  Returns a snapshot of the fast retransmit statistics.
+ *
+ * Parameters:
+ *  pStatistics: Pointer to the structure receiving the statistics.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaFastRetransmit_GetStatistics( OtaFastRetransmitStatistics_t * pStatistics )
+{
+    if( pStatistics != NULL )
+    {
+        taskENTER_CRITICAL();
+        *pStatistics = fastRetransmit.statistics;
+        taskEXIT_CRITICAL();
+    }
+}
+
+/* [] END OF FILE */
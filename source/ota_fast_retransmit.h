@@ -0,0 +1,105 @@
+/********************************************************************************
+ * File Name: ota_fast_retransmit.h
+ *
+ * Description: Interface of the requests for stream blocks found missing
+ * while later blocks of the same request arrive.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef OTA_FAST_RETRANSMIT_H_
+#define OTA_FAST_RETRANSMIT_H_
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* OTA Library include. */
+#include "ota.h"
+
+
+/* Enables the requests for blocks found missing while later blocks of the
+ * same request arrive. The blocks are spotted on the receive path, so the
+ * stream block decoder and the MQTT dispatcher must be enabled as well. */
+#ifndef OTA_FAST_RETRANSMIT_ENABLE
+#define OTA_FAST_RETRANSMIT_ENABLE          (1)
+#endif
+
+/* Number of later blocks that must arrive before a block is considered lost
+ * rather than reordered. */
+#ifndef OTA_FAST_RETRANSMIT_REORDER_BLOCKS
+#define OTA_FAST_RETRANSMIT_REORDER_BLOCKS  (1U)
+#endif
+
+/* Bounds of the time a gap is left open before the missing blocks are asked
+ * for. Within the bounds the delay is a quarter of the smoothed RTT. */
+#ifndef OTA_FAST_RETRANSMIT_MIN_DELAY_MS
+#define OTA_FAST_RETRANSMIT_MIN_DELAY_MS    (20U)
+#endif
+
+#ifndef OTA_FAST_RETRANSMIT_MAX_DELAY_MS
+#define OTA_FAST_RETRANSMIT_MAX_DELAY_MS    (500U)
+#endif
+
+/* Statistics of the fast retransmit of the current job. */
+typedef struct OtaFastRetransmitStatistics
+{
+    uint32_t gapsDetected;          /* Blocks found missing behind later blocks. */
+    uint32_t gapsFilled;            /* Missing blocks that arrived late on their own. */
+    uint32_t requests;              /* Requests sent for missing blocks. */
+    uint32_t blocksRequested;       /* Blocks asked for by these requests. */
+    uint32_t blocksRecovered;       /* Blocks received after they were asked for again. */
+} OtaFastRetransmitStatistics_t;
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+void OtaFastRetransmit_Reset( void );
+
+void OtaFastRetransmit_OnRequest( const uint8_t * pBitmap,
+        size_t bitmapSize,
+        uint32_t numBlocks,
+        uint32_t requests );
+
+bool OtaFastRetransmit_OnBlockReceived( uint32_t blockIndex );
+
+bool OtaFastRetransmit_TakeRequest( uint8_t * pBitmap,
+        size_t bitmapSize,
+        uint32_t * pNumBlocks );
+
+void OtaFastRetransmit_GetStatistics( OtaFastRetransmitStatistics_t * pStatistics );
+
+
+#endif /* ifndef OTA_FAST_RETRANSMIT_H_ */
@@ -0,0 +1,1348 @@
+/********************************************************************************
+ * File Name: ota_flash_writer.c
+ *
+ * Description: Implementation of the write-behind flash writer. File blocks are
+ * staged and merged into extents by the OTA agent and programmed to flash by a
+ * dedicated task.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* RTOS includes. */
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+#include <semphr.h>
+
+/* OTA PAL include. */
+#include "cy_ota_storage.h"
+
+/* Include header for the OTA flash writer. */
+#include "ota_flash_writer.h"
+
+/* Include header for the OTA download checkpoint. */
+#include "ota_checkpoint.h"
+
+/* Include header for the delta update stage. */
+#include "ota_delta.h"
+
+/* Include header for the decompression stage. */
+#include "ota_decompress.h"
+
+/* Include header for the incremental image digest. */
+#include "ota_image_hash.h"
+
+/* MCUboot flash map, to reopen a partially written secondary slot and to
+ * read back a staged file. */
+#include "sysflash/sysflash.h"
+#include "flash_map_backend/flash_map_backend.h"
+
+/* Bytes of the file read back from flash at a time. */
+#define STAGED_READ_BACK_SIZE               (256U)
+
+#if ( OTA_CHECKPOINT_ENABLE == 1 )
+/* Bytes of a checkpointed block read back at a time to check it against its
+ * CRC. */
+#define RESUME_READ_SIZE                    (256U)
+#endif
+
+/* Marks the absence of a slot being filled. */
+#define NO_SLOT                             ( 0xFFU )
+
+/* A staging slot holding a run of adjacent file blocks. */
+typedef struct OtaFlashWriterSlot
+{
+    uint32_t offset;
+    uint32_t length;
+    uint8_t data[ OTA_FLASH_WRITER_EXTENT_SIZE ];
+} OtaFlashWriterSlot_t;
+
+/* Staging slots shared by the fillers and the writer task. A slot is owned
+ * by whoever holds its index: the free queue, the filler while filling it, the
+ * write queue or the writer task. */
+static OtaFlashWriterSlot_t slots[ OTA_FLASH_WRITER_NUM_SLOTS ];
+
+/* Indices of free slots and of slots waiting to be programmed. */
+static QueueHandle_t freeSlotQueue = NULL;
+static QueueHandle_t writeSlotQueue = NULL;
+
+/* Given by the writer task after each completed write. */
+static SemaphoreHandle_t writeDoneSemaphore = NULL;
+
+/* Serializes the filling of slots by the OTA agent and by the MQTT receive
+ * path. */
+static SemaphoreHandle_t fillMutex = NULL;
+
+/* Slot being filled, NO_SLOT if none. Only accessed with fillMutex held. */
+static uint8_t fillingSlot = NO_SLOT;
+
+/* File being received. */
+static OtaFileContext_t * pWriterFileContext = NULL;
+
+/* Set while the file accepts blocks from the receive path, between a
+ * successful create and the close or abort. Only accessed with fillMutex
+ * held. */
+static bool fileOpen = false;
+
+/* Slots handed to the writer task and not yet completed. */
+static volatile uint32_t writesOutstanding = 0U;
+
+/* Set by the writer task when a PAL write fails. */
+static volatile bool writeFailed = false;
+
+/* One bit per file block, set once the block is programmed to flash. */
+static uint8_t durableBitmap[ ( OTA_FLASH_WRITER_MAX_FILE_BLOCKS + 7U ) / 8U ];
+
+/* One bit per file block, set once the block is copied into a slot. Only
+ * accessed with fillMutex held. */
+static uint8_t stagedBitmap[ ( OTA_FLASH_WRITER_MAX_FILE_BLOCKS + 7U ) / 8U ];
+
+/* Statistics of the current file. */
+static OtaFlashWriterStatistics_t writerStatistics;
+
+/* Set when the current file is a delta patch or is compressed. Such a file
+ * is staged at the end of the secondary slot and passed in order through the
+ * decompression and delta stages by the writer task, which programs the
+ * resulting image from the start of the slot. */
+static bool patchFile = false;
+static bool compressedFile = false;
+static bool stagedFile = false;
+
+/* Offset of the file in the secondary slot. */
+static uint32_t stageOffset = 0U;
+
+/* Set when the file is passed in order through the image digest or the
+ * stages of a staged file. */
+static bool inOrderFile = false;
+
+/* Bytes of the file processed in order. Only accessed from the writer task
+ * while blocks are received. */
+static uint32_t bytesFed = 0U;
+
+/* Bytes of the decompressed image programmed, when no delta stage follows
+ * the decompression stage. */
+static uint32_t imageOffset = 0U;
+
+/* View of the secondary slot starting at the staged file. Handed to the PAL
+ * on close, so that the signature of the job is checked against the file as
+ * it was received; MCUboot validates the resulting image on the next boot. */
+static struct flash_area stagedArea;
+
+#if ( OTA_CHECKPOINT_ENABLE == 1 )
+/* Checkpoint of the current file, only updated by the writer task while
+ * blocks are received. */
+static OtaCheckpoint_t checkpoint;
+
+/* Blocks made durable since the last checkpoint. */
+static uint32_t blocksSinceCheckpoint = 0U;
+#endif
+
+
+/*******************************************************************************
+ * Function Name: markDurable()
+ *******************************************************************************
+ * Summary:
+ *  Marks the blocks covered by a programmed slot as durable. Must be called
+ *  inside a critical section.
+ *
+ * Parameters:
+ *  offset: File offset of the slot.
+ *  length: Number of bytes programmed.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+static void markDurable( uint32_t offset,
+        uint32_t length )
+{
+    uint32_t blockIndex = offset / otaconfigFILE_BLOCK_SIZE;
+    uint32_t lastBlock = ( offset + length - 1U ) / otaconfigFILE_BLOCK_SIZE;
+
+    for( ; ( blockIndex <= lastBlock ) && ( blockIndex < OTA_FLASH_WRITER_MAX_FILE_BLOCKS ); blockIndex++ )
+    {
+        durableBitmap[ blockIndex / 8U ] |= ( uint8_t ) ( 1U << ( blockIndex % 8U ) );
+        writerStatistics.blocksDurable++;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: writeImage()
+ *******************************************************************************
+ * Summary:
+ *  Output of the decompression stage when no delta stage follows. Programs
+ *  the next chunk of the image from the start of the secondary slot; the last
+ *  chunk is padded with the erased value to keep whole flash rows.
+ *
+ * Parameters:
+ *  pData:  Next bytes of the image.
+ *  length: Number of bytes, OTA_DECOMPRESS_CHUNK_SIZE except for the last
+ *          chunk.
+ *
+ * Return:
+ *  true on success, false if the image does not fit or the write failed.
+ *
+ *******************************************************************************/
+static bool writeImage( const uint8_t * pData,
+        uint32_t length )
+{
+    uint8_t lastChunk[ OTA_DECOMPRESS_CHUNK_SIZE ];
+    const struct flash_area * pArea = ( const struct flash_area * ) pWriterFileContext->pFile;
+
+    if( ( imageOffset + OTA_DECOMPRESS_CHUNK_SIZE ) > stageOffset )
+    {
+        printf("Decompressed image does not fit below the staged file.\n");
+        return false;
+    }
+
+    if( length < OTA_DECOMPRESS_CHUNK_SIZE )
+    {
+        memcpy( lastChunk, pData, length );
+        memset( &lastChunk[ length ], flash_area_erased_val( pArea ), sizeof( lastChunk ) - length );
+        pData = lastChunk;
+    }
+
+    if( cy_awsport_ota_flash_write_block( pWriterFileContext, imageOffset,
+            ( uint8_t * ) pData, OTA_DECOMPRESS_CHUNK_SIZE ) != ( int16_t ) OTA_DECOMPRESS_CHUNK_SIZE )
+    {
+        printf("Failed to program the decompressed image at offset %u.\n", (unsigned int)imageOffset);
+        return false;
+    }
+
+    imageOffset += OTA_DECOMPRESS_CHUNK_SIZE;
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: processInOrder()
+ *******************************************************************************
+ * Summary:
+ *  Adds the next bytes of the file to the image digest and passes them to the
+ *  first stage of a staged file: the decompression stage for a compressed
+ *  file, the delta stage otherwise.
+ *
+ * Parameters:
+ *  pData:  Next bytes of the file.
+ *  length: Number of bytes.
+ *
+ * Return:
+ *  true on success, false otherwise.
+ *
+ *******************************************************************************/
+static bool processInOrder( const uint8_t * pData,
+        uint32_t length )
+{
+#if ( OTA_IMAGE_HASH_ENABLE == 1 )
+    OtaImageHash_Update( pData, length );
+#endif
+
+    if( stagedFile == false )
+    {
+        return true;
+    }
+
+    if( compressedFile == true )
+    {
+        return OtaDecompress_Process( pData, length );
+    }
+
+    return OtaDelta_Process( pData, length );
+}
+
+/*******************************************************************************
+ * Function Name: feedInOrder()
+ *******************************************************************************
+ * Summary:
+ *  Processes the programmed slot if it continues the file processed so far.
+ *  Blocks programmed earlier out of order which now continue the file are
+ *  read back from the secondary slot; the durable block bitmap serves as the
+ *  reorder structure, so only those blocks are ever read back.
+ *
+ * Parameters:
+ *  pSlot: Slot just programmed to flash.
+ *
+ * Return:
+ *  true on success, false if the file cannot be processed.
+ *
+ *******************************************************************************/
+static bool feedInOrder( const OtaFlashWriterSlot_t * pSlot )
+{
+    uint8_t readBack[ STAGED_READ_BACK_SIZE ];
+    uint32_t fileSize = pWriterFileContext->fileSize;
+    uint32_t length;
+
+    if( pSlot->offset == bytesFed )
+    {
+        if( processInOrder( pSlot->data, pSlot->length ) == false )
+        {
+            return false;
+        }
+
+        bytesFed += pSlot->length;
+    }
+
+    while( ( bytesFed < fileSize ) &&
+            ( OtaFlashWriter_IsBlockDurable( bytesFed / otaconfigFILE_BLOCK_SIZE ) == true ) )
+    {
+        length = otaconfigFILE_BLOCK_SIZE - ( bytesFed % otaconfigFILE_BLOCK_SIZE );
+        if( length > sizeof( readBack ) )
+        {
+            length = sizeof( readBack );
+        }
+        if( length > ( fileSize - bytesFed ) )
+        {
+            length = fileSize - bytesFed;
+        }
+
+        if( ( flash_area_read( ( const struct flash_area * ) pWriterFileContext->pFile,
+                stageOffset + bytesFed, readBack, length ) != 0 ) ||
+                ( processInOrder( readBack, length ) == false ) )
+        {
+            return false;
+        }
+
+        bytesFed += length;
+
+        taskENTER_CRITICAL();
+        writerStatistics.bytesReadBack += length;
+        taskEXIT_CRITICAL();
+    }
+
+    taskENTER_CRITICAL();
+    writerStatistics.bytesInOrder = bytesFed;
+    taskEXIT_CRITICAL();
+
+    return true;
+}
+
+#if ( OTA_CHECKPOINT_ENABLE == 1 )
+/*******************************************************************************
+ * Function Name: recordBlockCrcs()
+ *******************************************************************************
+ * Summary:
+ *  Records the CRCs of the blocks of a programmed slot in the checkpoint, so
+ *  that a resumed download can tell complete blocks from torn ones.
+ *
+ * Parameters:
+ *  pSlot: Programmed slot.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+static void recordBlockCrcs( const OtaFlashWriterSlot_t * pSlot )
+{
+    uint32_t position;
+    uint32_t length;
+    uint32_t blockIndex;
+
+    for( position = 0U; position < pSlot->length; position += otaconfigFILE_BLOCK_SIZE )
+    {
+        blockIndex = ( pSlot->offset + position ) / otaconfigFILE_BLOCK_SIZE;
+        length = pSlot->length - position;
+        if( length > otaconfigFILE_BLOCK_SIZE )
+        {
+            length = otaconfigFILE_BLOCK_SIZE;
+        }
+
+        if( blockIndex < OTA_FLASH_WRITER_MAX_FILE_BLOCKS )
+        {
+            checkpoint.blockCrcs[ blockIndex ] = OtaCheckpoint_BlockCrc( OTA_CHECKPOINT_BLOCK_CRC_INIT,
+                    &pSlot->data[ position ], length );
+        }
+    }
+}
+#endif /* ( OTA_CHECKPOINT_ENABLE == 1 ) */
+
+/*******************************************************************************
+ * Function Name: flashWriterTask()
+ *******************************************************************************
+ * Summary:
+ *  Programs the queued slots to flash through the OTA PAL, marks their blocks
+ *  durable and returns the slots to the free queue.
+ *
+ * Parameters:
+ *  pParam: Unused.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+static void flashWriterTask( void * pParam )
+{
+    uint8_t slotIndex;
+    OtaFlashWriterSlot_t * pSlot;
+    int16_t bytesWritten;
+
+    ( void ) pParam;
+
+    for( ;; )
+    {
+        if( xQueueReceive( writeSlotQueue, &slotIndex, portMAX_DELAY ) != pdTRUE )
+        {
+            continue;
+        }
+
+        pSlot = &slots[ slotIndex ];
+        bytesWritten = cy_awsport_ota_flash_write_block( pWriterFileContext, stageOffset + pSlot->offset,
+                pSlot->data, pSlot->length );
+
+        taskENTER_CRITICAL();
+        if( bytesWritten == ( int16_t ) pSlot->length )
+        {
+            markDurable( pSlot->offset, pSlot->length );
+            writerStatistics.extentsWritten++;
+            writerStatistics.bytesWritten += pSlot->length;
+        }
+        else
+        {
+            writeFailed = true;
+            writerStatistics.writeErrors++;
+        }
+        taskEXIT_CRITICAL();
+
+        if( bytesWritten != ( int16_t ) pSlot->length )
+        {
+            printf("Flash write of %u bytes at offset %u failed.\n",
+                    (unsigned int)pSlot->length, (unsigned int)pSlot->offset);
+        }
+        else if( ( inOrderFile == true ) && ( writeFailed == false ) && ( feedInOrder( pSlot ) == false ) )
+        {
+            printf("Processing the file failed at offset %u.\n", (unsigned int)bytesFed);
+            writeFailed = true;
+        }
+
+#if ( OTA_CHECKPOINT_ENABLE == 1 )
+        /* Staged files are processed once, so they are never checkpointed. */
+        if( ( bytesWritten == ( int16_t ) pSlot->length ) && ( stagedFile == false ) )
+        {
+            /* Only blocks already in flash are checkpointed. */
+            recordBlockCrcs( pSlot );
+            blocksSinceCheckpoint += ( pSlot->length + otaconfigFILE_BLOCK_SIZE - 1U ) / otaconfigFILE_BLOCK_SIZE;
+            if( blocksSinceCheckpoint >= OTA_CHECKPOINT_BLOCK_INTERVAL )
+            {
+                memcpy( checkpoint.durableBitmap, durableBitmap, sizeof( checkpoint.durableBitmap ) );
+                ( void ) OtaCheckpoint_Save( &checkpoint );
+                blocksSinceCheckpoint = 0U;
+            }
+        }
+#endif
+
+        /* The slot is complete only once the delta stage consumed it. */
+        taskENTER_CRITICAL();
+        writesOutstanding--;
+        taskEXIT_CRITICAL();
+
+        ( void ) xQueueSendToBack( freeSlotQueue, &slotIndex, 0U );
+        ( void ) xSemaphoreGive( writeDoneSemaphore );
+    }
+}
+
+/*******************************************************************************
+ * Function Name: submitFillingSlot()
+ *******************************************************************************
+ * Summary:
+ *  Hands the slot being filled to the writer task. Must be called with
+ *  fillMutex held.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+static void submitFillingSlot( void )
+{
+    if( fillingSlot != NO_SLOT )
+    {
+        taskENTER_CRITICAL();
+        writesOutstanding++;
+        taskEXIT_CRITICAL();
+
+        /* The write queue holds every slot, so this never waits. */
+        ( void ) xQueueSendToBack( writeSlotQueue, &fillingSlot, 0U );
+        fillingSlot = NO_SLOT;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlashWriter_Init()
+ *******************************************************************************
+ * Summary:
+ *  Creates the slot queues and the writer task.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  true on success, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaFlashWriter_Init( void )
+{
+    uint8_t slotIndex;
+
+    freeSlotQueue = xQueueCreate( OTA_FLASH_WRITER_NUM_SLOTS, sizeof( uint8_t ) );
+    writeSlotQueue = xQueueCreate( OTA_FLASH_WRITER_NUM_SLOTS, sizeof( uint8_t ) );
+    writeDoneSemaphore = xSemaphoreCreateBinary();
+    fillMutex = xSemaphoreCreateMutex();
+
+    if( ( freeSlotQueue == NULL ) || ( writeSlotQueue == NULL ) || ( writeDoneSemaphore == NULL ) ||
+            ( fillMutex == NULL ) )
+    {
+        return false;
+    }
+
+    for( slotIndex = 0U; slotIndex < OTA_FLASH_WRITER_NUM_SLOTS; slotIndex++ )
+    {
+        ( void ) xQueueSendToBack( freeSlotQueue, &slotIndex, 0U );
+    }
+
+#if ( OTA_CHECKPOINT_ENABLE == 1 )
+    if( OtaCheckpoint_Init() == false )
+    {
+        printf("OTA download checkpoints are not available.\n");
+    }
+#endif
+
+    return ( xTaskCreate( flashWriterTask, "OTA FLASH WRITER TASK",
+            OTA_FLASH_WRITER_TASK_STACK_SIZE, NULL,
+            OTA_FLASH_WRITER_TASK_PRIORITY, NULL ) == pdPASS );
+}
+
+#if ( OTA_CHECKPOINT_ENABLE == 1 )
+/*******************************************************************************
+ * Function Name: resumeReceiveFile()
+ *******************************************************************************
+ * Summary:
+ *  Resumes the download of a file from its checkpoint. The secondary slot is
+ *  opened without the erase done by the PAL createFile; like the PAL, the
+ *  flash area is used as the file handle. Every checkpointed block is read
+ *  back in full and checked against its CRC; blocks torn by the reset or
+ *  erased since are downloaded again. The restored blocks are marked
+ *  durable and removed from the receive bitmap of the OTA agent, so only the
+ *  missing blocks are requested.
+ *
+ * Parameters:
+ *  pFileContext: OTA file context.
+ *
+ * Return:
+ *  true if the download was resumed, false if the file must be created anew.
+ *
+ *******************************************************************************/
+static bool resumeReceiveFile( OtaFileContext_t * const pFileContext )
+{
+    const struct flash_area * pArea = NULL;
+    uint8_t chunk[ RESUME_READ_SIZE ];
+    uint32_t blockIndex;
+    uint32_t blockLength;
+    uint32_t position;
+    uint32_t length;
+    uint16_t crc;
+    uint32_t restoredBlocks = 0U;
+    uint8_t blockMask;
+
+    if( ( pFileContext->pRxBlockBitmap == NULL ) ||
+            ( flash_area_open( FLASH_AREA_IMAGE_SECONDARY( 0 ), &pArea ) != 0 ) )
+    {
+        return false;
+    }
+
+    for( blockIndex = 0U; blockIndex < checkpoint.numBlocks; blockIndex++ )
+    {
+        blockMask = ( uint8_t ) ( 1U << ( blockIndex % 8U ) );
+        if( ( checkpoint.durableBitmap[ blockIndex / 8U ] & blockMask ) == 0U )
+        {
+            continue;
+        }
+
+        checkpoint.durableBitmap[ blockIndex / 8U ] &= ( uint8_t ) ~blockMask;
+
+        blockLength = checkpoint.fileSize - ( blockIndex * otaconfigFILE_BLOCK_SIZE );
+        if( blockLength > otaconfigFILE_BLOCK_SIZE )
+        {
+            blockLength = otaconfigFILE_BLOCK_SIZE;
+        }
+
+        crc = OTA_CHECKPOINT_BLOCK_CRC_INIT;
+        for( position = 0U; position < blockLength; position += length )
+        {
+            length = ( ( blockLength - position ) < sizeof( chunk ) ) ? ( blockLength - position ) : sizeof( chunk );
+            if( flash_area_read( pArea, ( blockIndex * otaconfigFILE_BLOCK_SIZE ) + position, chunk, length ) != 0 )
+            {
+                break;
+            }
+
+            crc = OtaCheckpoint_BlockCrc( crc, chunk, length );
+        }
+
+        if( ( position == blockLength ) && ( crc == checkpoint.blockCrcs[ blockIndex ] ) )
+        {
+            checkpoint.durableBitmap[ blockIndex / 8U ] |= blockMask;
+            durableBitmap[ blockIndex / 8U ] |= blockMask;
+
+            /* The OTA agent marks missing blocks with a set bit. */
+            if( ( pFileContext->pRxBlockBitmap[ blockIndex / 8U ] & blockMask ) != 0U )
+            {
+                pFileContext->pRxBlockBitmap[ blockIndex / 8U ] &= ( uint8_t ) ~blockMask;
+                pFileContext->blocksRemaining--;
+            }
+
+            restoredBlocks++;
+        }
+    }
+
+    if( restoredBlocks == 0U )
+    {
+        flash_area_close( pArea );
+        return false;
+    }
+
+    pFileContext->pFile = ( void * ) pArea;
+    writerStatistics.blocksResumed = restoredBlocks;
+
+    printf("Resuming download from checkpoint: %u of %u blocks restored, "
+            "%u bytes not downloaded again.\n",
+            (unsigned int)restoredBlocks, (unsigned int)checkpoint.numBlocks,
+            (unsigned int)( restoredBlocks * otaconfigFILE_BLOCK_SIZE ));
+
+    return true;
+}
+#endif /* ( OTA_CHECKPOINT_ENABLE == 1 ) */
+
+/*******************************************************************************
+ * Function Name: fileNameEndsWith()
+ *******************************************************************************
+ * Summary:
+ *  Checks whether the name of the update file ends with a suffix, optionally
+ *  followed by another suffix of the given length.
+ *
+ * Parameters:
+ *  pFileContext:   OTA file context.
+ *  pSuffix:        Suffix to look for.
+ *  skipLength:     Length of the suffix following pSuffix, 0 if none.
+ *
+ * Return:
+ *  true if the name ends with the suffix, false otherwise.
+ *
+ *******************************************************************************/
+static bool fileNameEndsWith( const OtaFileContext_t * pFileContext,
+        const char * pSuffix,
+        size_t skipLength )
+{
+    size_t length;
+    size_t suffixLength = strlen( pSuffix );
+
+    if( ( pFileContext == NULL ) || ( pFileContext->pFilePath == NULL ) )
+    {
+        return false;
+    }
+
+    length = strnlen( ( const char * ) pFileContext->pFilePath, pFileContext->filePathMaxSize );
+
+    return ( length > ( suffixLength + skipLength ) ) &&
+            ( memcmp( &pFileContext->pFilePath[ length - skipLength - suffixLength ], pSuffix, suffixLength ) == 0 );
+}
+
+/*******************************************************************************
+ * Function Name: stageFile()
+ *******************************************************************************
+ * Summary:
+ *  Places a delta patch or compressed file at the end of the erased secondary
+ *  slot, below the MCUboot trailer, and starts its stages. The resulting
+ *  image is programmed from the start of the slot up to the staged file. A
+ *  compressed patch is decompressed into the delta stage.
+ *
+ * Parameters:
+ *  pFileContext: OTA file context, holding the flash area of the slot.
+ *
+ * Return:
+ *  true on success, false if the file does not fit the slot.
+ *
+ *******************************************************************************/
+static bool stageFile( OtaFileContext_t * const pFileContext )
+{
+    const struct flash_area * pArea = ( const struct flash_area * ) pFileContext->pFile;
+
+    if( ( pArea == NULL ) ||
+            ( ( pFileContext->fileSize + OTA_FLASH_WRITER_TRAILER_SIZE ) >= pArea->fa_size ) )
+    {
+        printf("Staged file of %u bytes does not fit the secondary slot.\n",
+                (unsigned int)pFileContext->fileSize);
+        return false;
+    }
+
+    stageOffset = ( pArea->fa_size - OTA_FLASH_WRITER_TRAILER_SIZE - pFileContext->fileSize ) &
+            ~( otaconfigFILE_BLOCK_SIZE - 1U );
+    imageOffset = 0U;
+
+    if( ( patchFile == true ) && ( OtaDelta_Begin( pFileContext, stageOffset ) == false ) )
+    {
+        return false;
+    }
+
+    return ( compressedFile == false ) ||
+            ( OtaDecompress_Begin( ( patchFile == true ) ? OtaDelta_Process : writeImage ) == true );
+}
+
+/*******************************************************************************
+ * Function Name: endStages()
+ *******************************************************************************
+ * Summary:
+ *  Ends the stages of a staged file.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  true if every stage consumed its whole input, false otherwise.
+ *
+ *******************************************************************************/
+static bool endStages( void )
+{
+    bool complete = true;
+
+    if( compressedFile == true )
+    {
+        complete = OtaDecompress_End();
+    }
+
+    if( patchFile == true )
+    {
+        complete = ( OtaDelta_End() == true ) && ( complete == true );
+    }
+
+    return complete;
+}
+
+/*******************************************************************************
+ * Function Name: openFile()
+ *******************************************************************************
+ * Summary:
+ *  Lets the receive path stage blocks of the created file.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+static void openFile( void )
+{
+    ( void ) xSemaphoreTake( fillMutex, portMAX_DELAY );
+    fileOpen = true;
+    ( void ) xSemaphoreGive( fillMutex );
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlashWriter_CreateFile()
+ *******************************************************************************
+ * Summary:
+ *  PAL createFile hook. Clears the durable block bitmap and creates the receive
+ *  file through the OTA PAL, which erases the secondary slot before any block
+ *  is programmed. A download interrupted by a reset is resumed from its
+ *  checkpoint instead. A delta patch or compressed file is staged in the
+ *  slot and processed while it is received.
+ *
+ * Parameters:
+ *  pFileContext: OTA file context.
+ *
+ * Return:
+ *  OtaPalSuccess on success, PAL error code otherwise.
+ *
+ *******************************************************************************/
+OtaPalStatus_t OtaFlashWriter_CreateFile( OtaFileContext_t * const pFileContext )
+{
+    OtaPalStatus_t status;
+
+    if( ( pFileContext != NULL ) &&
+            ( pFileContext->fileSize > ( OTA_FLASH_WRITER_MAX_FILE_BLOCKS * otaconfigFILE_BLOCK_SIZE ) ) )
+    {
+        printf("File of %u bytes exceeds the flash writer limit.\n",
+                (unsigned int)pFileContext->fileSize);
+        return OTA_PAL_COMBINE_ERR( OtaPalRxFileTooLarge, 0 );
+    }
+
+    ( void ) xSemaphoreTake( fillMutex, portMAX_DELAY );
+    fileOpen = false;
+    memset( stagedBitmap, 0x00, sizeof( stagedBitmap ) );
+    ( void ) xSemaphoreGive( fillMutex );
+
+    taskENTER_CRITICAL();
+    memset( durableBitmap, 0x00, sizeof( durableBitmap ) );
+    memset( &writerStatistics, 0x00, sizeof( writerStatistics ) );
+    writeFailed = false;
+    taskEXIT_CRITICAL();
+
+    pWriterFileContext = pFileContext;
+    compressedFile = fileNameEndsWith( pFileContext, OTA_DECOMPRESS_FILE_SUFFIX, 0U );
+    patchFile = fileNameEndsWith( pFileContext, OTA_DELTA_FILE_SUFFIX,
+            ( compressedFile == true ) ? strlen( OTA_DECOMPRESS_FILE_SUFFIX ) : 0U );
+    stagedFile = ( patchFile == true ) || ( compressedFile == true );
+
+    inOrderFile = ( stagedFile == true ) || ( OTA_IMAGE_HASH_ENABLE == 1 );
+
+    taskENTER_CRITICAL();
+    writerStatistics.patchFile = patchFile;
+    writerStatistics.compressedFile = compressedFile;
+    taskEXIT_CRITICAL();
+
+    stageOffset = 0U;
+    bytesFed = 0U;
+
+#if ( OTA_IMAGE_HASH_ENABLE == 1 )
+    OtaImageHash_Begin();
+#endif
+
+#if ( OTA_CHECKPOINT_ENABLE == 1 )
+    blocksSinceCheckpoint = 0U;
+
+    if( pFileContext != NULL )
+    {
+        if( ( stagedFile == false ) &&
+                ( OtaCheckpoint_Load( pFileContext, &checkpoint ) == true ) &&
+                ( resumeReceiveFile( pFileContext ) == true ) )
+        {
+            openFile();
+            return OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+        }
+
+        /* The PAL erases the secondary slot, so any older checkpoint is void. */
+        OtaCheckpoint_Clear();
+        OtaCheckpoint_Describe( &checkpoint, pFileContext );
+    }
+#endif
+
+    status = cy_awsport_ota_flash_create_receive_file( pFileContext );
+
+    if( ( stagedFile == true ) && ( OTA_PAL_MAIN_ERR( status ) == OtaPalSuccess ) &&
+            ( stageFile( pFileContext ) == false ) )
+    {
+        ( void ) endStages();
+        ( void ) cy_awsport_ota_flash_abort( pFileContext );
+        status = OTA_PAL_COMBINE_ERR( OtaPalRxFileTooLarge, 0 );
+    }
+
+    if( ( pFileContext != NULL ) && ( OTA_PAL_MAIN_ERR( status ) == OtaPalSuccess ) )
+    {
+        openFile();
+    }
+
+    return status;
+}
+
+/*******************************************************************************
+ * Function Name: copyToSlot()
+ *******************************************************************************
+ * Summary:
+ *  Copies a block into a staging slot, appending it to the slot being filled
+ *  when it directly follows it. Full slots and slots followed by a
+ *  non-adjacent block are handed to the writer task. Waits for a free slot
+ *  only when all slots are queued for programming. Must be called with
+ *  fillMutex held.
+ *
+ * Parameters:
+ *  offset:     Offset of the block in the file.
+ *  pData:      Block data.
+ *  blockSize:  Size of the block.
+ *
+ * Return:
+ *  true if the block was copied, false on timeout.
+ *
+ *******************************************************************************/
+static bool copyToSlot( uint32_t offset,
+        const uint8_t * pData,
+        uint32_t blockSize )
+{
+    OtaFlashWriterSlot_t * pSlot;
+    TickType_t waitStart;
+    uint32_t blockIndex = offset / otaconfigFILE_BLOCK_SIZE;
+
+    if( fillingSlot != NO_SLOT )
+    {
+        pSlot = &slots[ fillingSlot ];
+        if( ( offset != ( pSlot->offset + pSlot->length ) ) ||
+                ( ( pSlot->length + blockSize ) > OTA_FLASH_WRITER_EXTENT_SIZE ) )
+        {
+            submitFillingSlot();
+        }
+    }
+
+    if( fillingSlot == NO_SLOT )
+    {
+        waitStart = xTaskGetTickCount();
+        if( xQueueReceive( freeSlotQueue, &fillingSlot,
+                pdMS_TO_TICKS( OTA_FLASH_WRITER_WAIT_MS ) ) != pdTRUE )
+        {
+            fillingSlot = NO_SLOT;
+            printf("Timed out waiting for a free flash writer slot.\n");
+            return false;
+        }
+
+        taskENTER_CRITICAL();
+        writerStatistics.agentStallMs += ( xTaskGetTickCount() - waitStart ) * portTICK_PERIOD_MS;
+        taskEXIT_CRITICAL();
+
+        slots[ fillingSlot ].offset = offset;
+        slots[ fillingSlot ].length = 0U;
+    }
+
+    pSlot = &slots[ fillingSlot ];
+    memcpy( &pSlot->data[ pSlot->length ], pData, blockSize );
+    pSlot->length += blockSize;
+
+    if( blockIndex < OTA_FLASH_WRITER_MAX_FILE_BLOCKS )
+    {
+        stagedBitmap[ blockIndex / 8U ] |= ( uint8_t ) ( 1U << ( blockIndex % 8U ) );
+    }
+
+    taskENTER_CRITICAL();
+    writerStatistics.blocksQueued++;
+    writerStatistics.bytesQueued += blockSize;
+    taskEXIT_CRITICAL();
+
+    if( pSlot->length == OTA_FLASH_WRITER_EXTENT_SIZE )
+    {
+        submitFillingSlot();
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: isBlockStaged()
+ *******************************************************************************
+ * Summary:
+ *  Checks whether a file block was copied into a slot or restored from a
+ *  download checkpoint. Must be called with fillMutex held.
+ *
+ * Parameters:
+ *  blockIndex: Index of the block in the file.
+ *
+ * Return:
+ *  true if the block is staged, false otherwise.
+ *
+ *******************************************************************************/
+static bool isBlockStaged( uint32_t blockIndex )
+{
+    uint8_t blockMask = ( uint8_t ) ( 1U << ( blockIndex % 8U ) );
+
+    return ( blockIndex < OTA_FLASH_WRITER_MAX_FILE_BLOCKS ) &&
+            ( ( ( stagedBitmap[ blockIndex / 8U ] & blockMask ) != 0U ) ||
+              ( OtaFlashWriter_IsBlockDurable( blockIndex ) == true ) );
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlashWriter_WriteBlock()
+ *******************************************************************************
+ * Summary:
+ *  PAL writeBlock hook. Copies the block into a staging slot.
+ *
+ * Parameters:
+ *  pFileContext:   OTA file context.
+ *  offset:         Offset of the block in the file.
+ *  pData:          Block data.
+ *  blockSize:      Size of the block.
+ *
+ * Return:
+ *  Number of bytes accepted, negative value on failure.
+ *
+ *******************************************************************************/
+int16_t OtaFlashWriter_WriteBlock( OtaFileContext_t * const pFileContext,
+        uint32_t offset,
+        uint8_t * const pData,
+        uint32_t blockSize )
+{
+    bool copied;
+
+    if( ( writeFailed == true ) || ( pData == NULL ) || ( blockSize > OTA_FLASH_WRITER_EXTENT_SIZE ) ||
+            ( pFileContext != pWriterFileContext ) )
+    {
+        return -1;
+    }
+
+    ( void ) xSemaphoreTake( fillMutex, portMAX_DELAY );
+    copied = copyToSlot( offset, pData, blockSize );
+    ( void ) xSemaphoreGive( fillMutex );
+
+    return ( copied == true ) ? ( int16_t ) blockSize : -1;
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlashWriter_StageBlock()
+ *******************************************************************************
+ * Summary:
+ *  Copies a block straight from the network buffer into a staging slot, ahead
+ *  of the OTA agent processing its header. The block must belong to the open
+ *  file and have the size the file implies for its index. Blocks that are
+ *  already staged are not copied again.
+ *
+ * Parameters:
+ *  fileId:     File index from the stream data message.
+ *  blockIndex: Index of the block in the file.
+ *  pData:      Block data.
+ *  blockSize:  Size of the block data.
+ *
+ * Return:
+ *  Number of bytes copied, 0 if the block was already staged, negative value
+ *  if the block was rejected or could not be staged.
+ *
+ *******************************************************************************/
+int16_t OtaFlashWriter_StageBlock( uint32_t fileId,
+        uint32_t blockIndex,
+        const uint8_t * pData,
+        uint32_t blockSize )
+{
+    int16_t result = -1;
+    uint32_t offset = blockIndex * otaconfigFILE_BLOCK_SIZE;
+    uint32_t fileSize;
+
+    if( ( pData == NULL ) || ( blockIndex >= OTA_FLASH_WRITER_MAX_FILE_BLOCKS ) )
+    {
+        return -1;
+    }
+
+    ( void ) xSemaphoreTake( fillMutex, portMAX_DELAY );
+
+    if( ( fileOpen == true ) && ( writeFailed == false ) &&
+            ( fileId == pWriterFileContext->serverFileID ) )
+    {
+        fileSize = pWriterFileContext->fileSize;
+
+        if( ( offset >= fileSize ) ||
+                ( blockSize != ( ( ( fileSize - offset ) < otaconfigFILE_BLOCK_SIZE ) ?
+                        ( fileSize - offset ) : otaconfigFILE_BLOCK_SIZE ) ) )
+        {
+            result = -1;
+        }
+        else if( isBlockStaged( blockIndex ) == true )
+        {
+            result = 0;
+        }
+        else if( copyToSlot( offset, pData, blockSize ) == true )
+        {
+            taskENTER_CRITICAL();
+            writerStatistics.blocksFromNetwork++;
+            taskEXIT_CRITICAL();
+
+            result = ( int16_t ) blockSize;
+        }
+    }
+
+    ( void ) xSemaphoreGive( fillMutex );
+
+    return result;
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlashWriter_ConfirmBlock()
+ *******************************************************************************
+ * Summary:
+ *  PAL writeBlock hook for blocks staged from the network buffer. Accepts the
+ *  block from the OTA agent without copying it; the data passed by the agent
+ *  is not used.
+ *
+ * Parameters:
+ *  pFileContext:   OTA file context.
+ *  offset:         Offset of the block in the file.
+ *  blockSize:      Size of the block.
+ *
+ * Return:
+ *  Number of bytes accepted, negative value if the block was never staged.
+ *
+ *******************************************************************************/
+int16_t OtaFlashWriter_ConfirmBlock( OtaFileContext_t * const pFileContext,
+        uint32_t offset,
+        uint32_t blockSize )
+{
+    bool staged;
+
+    if( ( writeFailed == true ) || ( blockSize > OTA_FLASH_WRITER_EXTENT_SIZE ) ||
+            ( pFileContext != pWriterFileContext ) )
+    {
+        return -1;
+    }
+
+    ( void ) xSemaphoreTake( fillMutex, portMAX_DELAY );
+    staged = isBlockStaged( offset / otaconfigFILE_BLOCK_SIZE );
+    ( void ) xSemaphoreGive( fillMutex );
+
+    return ( staged == true ) ? ( int16_t ) blockSize : -1;
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlashWriter_Flush()
+ *******************************************************************************
+ * Summary:
+ *  Hands the partially filled slot to the writer task and waits until all
+ *  queued blocks are programmed.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  true if all blocks were programmed, false on a write failure or timeout.
+ *
+ *******************************************************************************/
+bool OtaFlashWriter_Flush( void )
+{
+    ( void ) xSemaphoreTake( fillMutex, portMAX_DELAY );
+    submitFillingSlot();
+    ( void ) xSemaphoreGive( fillMutex );
+
+    while( writesOutstanding > 0U )
+    {
+        if( xSemaphoreTake( writeDoneSemaphore, pdMS_TO_TICKS( OTA_FLASH_WRITER_WAIT_MS ) ) != pdTRUE )
+        {
+            printf("Timed out waiting for the flash writer to drain.\n");
+            return false;
+        }
+    }
+
+    return ( writeFailed == false );
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlashWriter_CloseFile()
+ *******************************************************************************
+ * Summary:
+ *  PAL closeFile hook. Flushes the pending blocks and checks that every block
+ *  of the file is durable. The signature is verified from the digest taken
+ *  while the file was received; without it the PAL verifies the file by
+ *  reading it back from flash.
+ *
+ * Parameters:
+ *  pFileContext: OTA file context.
+ *
+ * Return:
+ *  OtaPalSuccess on success, PAL error code otherwise.
+ *
+ *******************************************************************************/
+OtaPalStatus_t OtaFlashWriter_CloseFile( OtaFileContext_t * const pFileContext )
+{
+    OtaPalStatus_t status;
+    TickType_t closeStart = xTaskGetTickCount();
+    uint32_t numBlocks;
+    uint32_t blockIndex;
+
+    ( void ) xSemaphoreTake( fillMutex, portMAX_DELAY );
+    fileOpen = false;
+    ( void ) xSemaphoreGive( fillMutex );
+
+    if( OtaFlashWriter_Flush() == false )
+    {
+        return OTA_PAL_COMBINE_ERR( OtaPalFileClose, 0 );
+    }
+
+    if( pFileContext != NULL )
+    {
+        numBlocks = ( pFileContext->fileSize + ( otaconfigFILE_BLOCK_SIZE - 1U ) ) / otaconfigFILE_BLOCK_SIZE;
+        for( blockIndex = 0U; blockIndex < numBlocks; blockIndex++ )
+        {
+            if( OtaFlashWriter_IsBlockDurable( blockIndex ) == false )
+            {
+                printf("Block %u of the file was never programmed.\n", (unsigned int)blockIndex);
+                return OTA_PAL_COMBINE_ERR( OtaPalFileClose, 0 );
+            }
+        }
+    }
+
+    if( stagedFile == true )
+    {
+        if( endStages() == false )
+        {
+            printf("Staged file ended before the image was complete.\n");
+            return OTA_PAL_COMBINE_ERR( OtaPalFileClose, 0 );
+        }
+    }
+
+#if ( OTA_CHECKPOINT_ENABLE == 1 )
+    OtaCheckpoint_Clear();
+#endif
+
+#if ( OTA_IMAGE_HASH_ENABLE == 1 )
+    /* The whole file was hashed while it was received, so the PAL does not
+     * need to read it back to verify the signature. */
+    if( ( pFileContext != NULL ) && ( bytesFed == pFileContext->fileSize ) )
+    {
+        if( OtaImageHash_Verify( pFileContext ) == false )
+        {
+            return OTA_PAL_COMBINE_ERR( OtaPalSignatureCheckFailed, 0 );
+        }
+
+        flash_area_close( ( const struct flash_area * ) pFileContext->pFile );
+        pFileContext->pFile = NULL;
+
+        taskENTER_CRITICAL();
+        writerStatistics.closeMs = ( xTaskGetTickCount() - closeStart ) * portTICK_PERIOD_MS;
+        taskEXIT_CRITICAL();
+
+        return OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+    }
+#endif
+
+    if( stagedFile == true )
+    {
+        stagedArea = *( const struct flash_area * ) pFileContext->pFile;
+        stagedArea.fa_off += stageOffset;
+        stagedArea.fa_size -= stageOffset;
+        flash_area_close( ( const struct flash_area * ) pFileContext->pFile );
+        pFileContext->pFile = ( void * ) &stagedArea;
+    }
+
+    status = cy_awsport_ota_flash_close_receive_file( pFileContext );
+
+    taskENTER_CRITICAL();
+    writerStatistics.closeMs = ( xTaskGetTickCount() - closeStart ) * portTICK_PERIOD_MS;
+    taskEXIT_CRITICAL();
+
+    return status;
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlashWriter_Abort()
+ *******************************************************************************
+ * Summary:
+ *  PAL abort hook. Lets the writer task finish the queued writes so that it
+ *  does not touch the flash after the PAL aborted the file.
+ *
+ * Parameters:
+ *  pFileContext: OTA file context.
+ *
+ * Return:
+ *  OtaPalSuccess on success, PAL error code otherwise.
+ *
+ *******************************************************************************/
+OtaPalStatus_t OtaFlashWriter_Abort( OtaFileContext_t * const pFileContext )
+{
+    ( void ) xSemaphoreTake( fillMutex, portMAX_DELAY );
+    fileOpen = false;
+    ( void ) xSemaphoreGive( fillMutex );
+
+    ( void ) OtaFlashWriter_Flush();
+
+    if( stagedFile == true )
+    {
+        ( void ) endStages();
+    }
+
+#if ( OTA_CHECKPOINT_ENABLE == 1 )
+    OtaCheckpoint_Clear();
+#endif
+
+    return cy_awsport_ota_flash_abort( pFileContext );
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlashWriter_IsBlockDurable()
+ *******************************************************************************
+ * Summary:
+ *  Checks whether a file block has been programmed to flash.
+ *
+ * Parameters:
+ *  blockIndex: Index of the block in the file.
+ *
+ * Return:
+ *  true if the block is durable, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaFlashWriter_IsBlockDurable( uint32_t blockIndex )
+{
+    bool durable = false;
+
+    if( blockIndex < OTA_FLASH_WRITER_MAX_FILE_BLOCKS )
+    {
+        taskENTER_CRITICAL();
+        durable = ( ( durableBitmap[ blockIndex / 8U ] & ( 1U << ( blockIndex % 8U ) ) ) != 0U );
+        taskEXIT_CRITICAL();
+    }
+
+    return durable;
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlashWriter_IsBlockStaged()
+ *******************************************************************************
+ * Summary:
+ *  Checks whether a block of the open file was staged, so that the OTA agent
+ *  can be handed its header alone.
+ *
+ * Parameters:
+ *  blockIndex: Index of the block in the file.
+ *
+ * Return:
+ *  true if the file is open and the block is staged, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaFlashWriter_IsBlockStaged( uint32_t blockIndex )
+{
+    bool staged;
+
+    ( void ) xSemaphoreTake( fillMutex, portMAX_DELAY );
+    staged = ( fileOpen == true ) && ( isBlockStaged( blockIndex ) == true );
+    ( void ) xSemaphoreGive( fillMutex );
+
+    return staged;
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlashWriter_GetStatistics()
+ *******************************************************************************
+ * Summary:
+ *  Returns a snapshot of the flash writer statistics of the current file.
+ *
+ * Parameters:
+ *  pStatistics: Pointer to the structure receiving the statistics.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaFlashWriter_GetStatistics( OtaFlashWriterStatistics_t * pStatistics )
+{
+    if( pStatistics != NULL )
+    {
+        taskENTER_CRITICAL();
+        *pStatistics = writerStatistics;
+        taskEXIT_CRITICAL();
+    }
+}
+
+/* [] END OF FILE */
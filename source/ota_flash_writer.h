@@ -0,0 +1,156 @@
+/********************************************************************************
+ * File Name: ota_flash_writer.h
+ *
+ * Description: The API of the write-behind flash writer that programs OTA file
+ * blocks from a dedicated task.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef OTA_FLASH_WRITER_H_
+#define OTA_FLASH_WRITER_H_
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* OTA Library include. */
+#include "ota.h"
+#include "ota_config.h"
+
+
+/* Size of the staging slots. Adjacent file blocks are merged into one slot
+ * and programmed with a single PAL write. Must fit in the int16_t result of
+ * the PAL write. The default holds four blocks of 4 KB, or a single block of
+ * the largest supported size. It is not derived from the erase sector size
+ * of the secondary slot: the PAL erases the whole slot when the file is
+ * created, and coalescing full sectors or erasing ahead of the writes is not
+ * implemented. */
+#ifndef OTA_FLASH_WRITER_EXTENT_SIZE
+#define OTA_FLASH_WRITER_EXTENT_SIZE        ( 16U * 1024U )
+#endif
+
+/* Number of staging slots. One slot is being filled while the others wait
+ * for or are being programmed by the writer task. */
+#ifndef OTA_FLASH_WRITER_NUM_SLOTS
+#define OTA_FLASH_WRITER_NUM_SLOTS          (2U)
+#endif
+
+/* Largest file, in blocks, whose durable blocks can be tracked. Matches the
+ * block bitmap of the OTA agent. */
+#ifndef OTA_FLASH_WRITER_MAX_FILE_BLOCKS
+#define OTA_FLASH_WRITER_MAX_FILE_BLOCKS    ( OTA_MAX_BLOCK_BITMAP_SIZE * 8U )
+#endif
+
+/* Time to wait for a free slot or for the outstanding writes to complete. */
+#ifndef OTA_FLASH_WRITER_WAIT_MS
+#define OTA_FLASH_WRITER_WAIT_MS            (10000U)
+#endif
+
+/* Bytes at the end of the secondary slot kept free for the MCUboot image
+ * trailer when a delta patch or compressed file is staged in the slot. */
+#ifndef OTA_FLASH_WRITER_TRAILER_SIZE
+#ifdef MCUBOOT_MAX_IMG_SECTORS
+#define OTA_FLASH_WRITER_TRAILER_SIZE       ( ( MCUBOOT_MAX_IMG_SECTORS * 3U * 8U ) + 4096U )
+#else
+#define OTA_FLASH_WRITER_TRAILER_SIZE       ( 4096U )
+#endif
+#endif
+
+#ifndef OTA_FLASH_WRITER_TASK_STACK_SIZE
+#define OTA_FLASH_WRITER_TASK_STACK_SIZE    (1024U * 4U)
+#endif
+
+#ifndef OTA_FLASH_WRITER_TASK_PRIORITY
+#define OTA_FLASH_WRITER_TASK_PRIORITY      (configMAX_PRIORITIES - 4)
+#endif
+
+#if ( OTA_FLASH_WRITER_EXTENT_SIZE > INT16_MAX ) || ( OTA_FLASH_WRITER_EXTENT_SIZE < otaconfigFILE_BLOCK_SIZE )
+#error "OTA_FLASH_WRITER_EXTENT_SIZE must hold at least one block and at most INT16_MAX bytes."
+#endif
+
+/* Statistics of the flash writer for the current file. */
+typedef struct OtaFlashWriterStatistics
+{
+    uint32_t blocksQueued;          /* Blocks copied into a staging slot. */
+    uint32_t bytesQueued;           /* Bytes copied into a staging slot. */
+    uint32_t blocksFromNetwork;     /* Blocks copied straight from the network buffer. */
+    uint32_t blocksDurable;         /* Blocks programmed to flash. */
+    uint32_t extentsWritten;        /* PAL writes issued by the writer task. */
+    uint32_t bytesWritten;          /* Bytes programmed to flash. */
+    uint32_t agentStallMs;          /* Time spent waiting for a free slot. */
+    uint32_t writeErrors;           /* Failed PAL writes. */
+    uint32_t blocksResumed;         /* Blocks restored from a download checkpoint. */
+    uint32_t bytesInOrder;          /* Bytes of the file processed in file order. */
+    uint32_t bytesReadBack;         /* Bytes read back to process out of order blocks. */
+    uint32_t closeMs;               /* Time from the close request to the verified file. */
+    bool patchFile;                 /* The file is a delta patch. */
+    bool compressedFile;            /* The file is compressed. */
+} OtaFlashWriterStatistics_t;
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+bool OtaFlashWriter_Init( void );
+
+OtaPalStatus_t OtaFlashWriter_CreateFile( OtaFileContext_t * const pFileContext );
+
+int16_t OtaFlashWriter_WriteBlock( OtaFileContext_t * const pFileContext,
+        uint32_t offset,
+        uint8_t * const pData,
+        uint32_t blockSize );
+
+int16_t OtaFlashWriter_StageBlock( uint32_t fileId,
+        uint32_t blockIndex,
+        const uint8_t * pData,
+        uint32_t blockSize );
+
+int16_t OtaFlashWriter_ConfirmBlock( OtaFileContext_t * const pFileContext,
+        uint32_t offset,
+        uint32_t blockSize );
+
+bool OtaFlashWriter_Flush( void );
+
+OtaPalStatus_t OtaFlashWriter_CloseFile( OtaFileContext_t * const pFileContext );
+
+OtaPalStatus_t OtaFlashWriter_Abort( OtaFileContext_t * const pFileContext );
+
+bool OtaFlashWriter_IsBlockDurable( uint32_t blockIndex );
+
+bool OtaFlashWriter_IsBlockStaged( uint32_t blockIndex );
+
+void OtaFlashWriter_GetStatistics( OtaFlashWriterStatistics_t * pStatistics );
+
+
+#endif /* ifndef OTA_FLASH_WRITER_H_ */
@@ -0,0 +1,417 @@
+/********************************************************************************
+ * File Name: ota_flow_control.c
+ *
+ * Description: Implementation of the flow controller adapting the number of OTA
+ * file blocks requested per stream request to the measured RTT, the buffer pool
+ * occupancy and dropped blocks.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <string.h>
+
+/* RTOS includes. */
+#include <FreeRTOS.h>
+#include <task.h>
+
+/* Include header for the OTA event buffer pool. */
+#include "ota_buffer_pool.h"
+
+/* Include header for the OTA flow controller. */
+#include "ota_flow_control.h"
+
+/* Flow controller state. */
+typedef struct OtaFlowControl
+{
+    uint32_t window;                /* Window the next request is encoded with. */
+    uint32_t batchWindow;           /* Window the outstanding request was encoded with. */
+    uint32_t targetWindow;
+    uint32_t slowStartThreshold;
+    uint32_t smoothedRttMs;
+    uint32_t rttVariationMs;
+    uint32_t requestWaitMs;
+    TickType_t requestTick;         /* Time the outstanding request was sent. */
+    uint32_t blocksInBatch;         /* Blocks received for the outstanding request. */
+    bool requestOutstanding;        /* A request waits for its first block. */
+    bool retransmitted;             /* The outstanding request is a re-request. */
+    bool decreasedInBatch;          /* The window was already shrunk for this batch. */
+    uint32_t rttSamples;
+    uint32_t requests;
+    uint32_t timeouts;
+    uint32_t drops;
+    uint32_t windowIncreases;
+    uint32_t windowDecreases;
+} OtaFlowControl_t;
+
+/* State of the current job. */
+static OtaFlowControl_t flowControl =
+{
+    .window = OTA_FLOW_CONTROL_INITIAL_WINDOW,
+    .batchWindow = OTA_FLOW_CONTROL_INITIAL_WINDOW,
+    .targetWindow = OTA_FLOW_CONTROL_INITIAL_WINDOW,
+    .slowStartThreshold = OTA_FLOW_CONTROL_MAX_WINDOW,
+    .requestWaitMs = OTA_FLOW_CONTROL_MAX_REQUEST_WAIT_MS
+};
+
+
+/*******************************************************************************
+ * Function Name: shrinkWindow()
+ *******************************************************************************
+ * Summary:
+ *  Halves the window of the batch in flight on a congestion signal, at most
+ *  once per batch, and applies it to the next request. Must be called inside
+ *  a critical section.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+static void shrinkWindow( void )
+{
+    if( flowControl.decreasedInBatch == false )
+    {
+        flowControl.targetWindow = ( flowControl.batchWindow > 1U ) ? ( flowControl.batchWindow / 2U ) : 1U;
+        flowControl.slowStartThreshold = flowControl.targetWindow;
+        flowControl.window = flowControl.targetWindow;
+        flowControl.decreasedInBatch = true;
+        flowControl.windowDecreases++;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlowControl_IsPoolUnderPressure()
+ *******************************************************************************
+ * Summary:
+ *  Checks whether the OTA event buffer pool is filling up faster than the
+ *  agent drains it.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  true if the pool occupancy is above the pressure threshold.
+ *
+ *******************************************************************************/
+bool OtaFlowControl_IsPoolUnderPressure( void )
+{
+    OtaBufferPoolStatistics_t poolStatistics = { 0 };
+
+    OtaBufferPool_GetStatistics( &poolStatistics );
+
+    return ( ( poolStatistics.inUse * 100U ) >=
+            ( poolStatistics.capacity * OTA_FLOW_CONTROL_POOL_PRESSURE_PERCENT ) );
+}
+
+/*******************************************************************************
+ * Function Name: updateRtt()
+ *******************************************************************************
+ * Summary:
+ *  Folds an RTT sample into the smoothed RTT and its variation and derives the
+ *  request wait time from them. Must be called inside a critical section.
+ *
+ * Parameters:
+ *  sampleMs: Measured RTT in milliseconds.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+static void updateRtt( uint32_t sampleMs )
+{
+    uint32_t deviation;
+    uint32_t waitMs;
+
+    if( flowControl.rttSamples == 0U )
+    {
+        flowControl.smoothedRttMs = sampleMs;
+        flowControl.rttVariationMs = sampleMs / 2U;
+    }
+    else
+    {
+        /* RFC 6298 smoothing with alpha 1/8 and beta 1/4. */
+        deviation = ( sampleMs > flowControl.smoothedRttMs ) ?
+                ( sampleMs - flowControl.smoothedRttMs ) : ( flowControl.smoothedRttMs - sampleMs );
+        flowControl.rttVariationMs = ( ( 3U * flowControl.rttVariationMs ) + deviation ) / 4U;
+        flowControl.smoothedRttMs = ( ( 7U * flowControl.smoothedRttMs ) + sampleMs ) / 8U;
+    }
+
+    flowControl.rttSamples++;
+
+    waitMs = flowControl.smoothedRttMs + ( 4U * flowControl.rttVariationMs );
+    if( waitMs < OTA_FLOW_CONTROL_MIN_REQUEST_WAIT_MS )
+    {
+        waitMs = OTA_FLOW_CONTROL_MIN_REQUEST_WAIT_MS;
+    }
+    else if( waitMs > OTA_FLOW_CONTROL_MAX_REQUEST_WAIT_MS )
+    {
+        waitMs = OTA_FLOW_CONTROL_MAX_REQUEST_WAIT_MS;
+    }
+
+    flowControl.requestWaitMs = waitMs;
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlowControl_Reset()
+ *******************************************************************************
+ * Summary:
+ *  Returns the flow controller to its initial state for a new job.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaFlowControl_Reset( void )
+{
+    taskENTER_CRITICAL();
+    memset( &flowControl, 0x00, sizeof( flowControl ) );
+    flowControl.window = OTA_FLOW_CONTROL_INITIAL_WINDOW;
+    flowControl.batchWindow = OTA_FLOW_CONTROL_INITIAL_WINDOW;
+    flowControl.targetWindow = OTA_FLOW_CONTROL_INITIAL_WINDOW;
+    flowControl.slowStartThreshold = OTA_FLOW_CONTROL_MAX_WINDOW;
+    flowControl.requestWaitMs = OTA_FLOW_CONTROL_MAX_REQUEST_WAIT_MS;
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlowControl_GetBlockWindow()
+ *******************************************************************************
+ * Summary:
+ *  Returns the number of blocks to ask for in the next stream request. The
+ *  OTA agent reads it for the batch it counts and for the request it encodes
+ *  before publishing the request. The value changes when a batch completes or
+ *  congestion is seen, before the agent builds its next request, so the batch
+ *  in flight is always tracked against the window it was encoded with.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  The block request window.
+ *
+ *******************************************************************************/
+uint32_t OtaFlowControl_GetBlockWindow( void )
+{
+    return flowControl.window;
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlowControl_GetRequestWaitMs()
+ *******************************************************************************
+ * Summary:
+ *  Returns how long the OTA agent waits for a block before requesting again.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  The request wait time in milliseconds.
+ *
+ *******************************************************************************/
+uint32_t OtaFlowControl_GetRequestWaitMs( void )
+{
+    return flowControl.requestWaitMs;
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlowControl_OnBlockRequest()
+ *******************************************************************************
+ * Summary:
+ *  Notifies the flow controller that a stream request was sent. A request sent
+ *  before the previous batch completed means the request timer expired, which
+ *  is treated as a congestion signal. The new batch is tracked against the
+ *  number of blocks the OTA agent encoded in the request.
+ *
+ * Parameters:
+ *  numBlocks:  Blocks asked for by the request, 0 if unknown, in which case
+ *              the current window is assumed.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaFlowControl_OnBlockRequest( uint32_t numBlocks )
+{
+    uint32_t requestWindow;
+
+    taskENTER_CRITICAL();
+
+    /* Taken before any shrink below, which only applies to the next request. */
+    requestWindow = ( numBlocks != 0U ) ? numBlocks : flowControl.window;
+
+    flowControl.retransmitted = false;
+    if( ( flowControl.requests > 0U ) && ( flowControl.blocksInBatch < flowControl.batchWindow ) )
+    {
+        flowControl.timeouts++;
+        flowControl.retransmitted = true;
+        shrinkWindow();
+    }
+
+    flowControl.batchWindow = requestWindow;
+    flowControl.blocksInBatch = 0U;
+    flowControl.decreasedInBatch = false;
+    flowControl.requestOutstanding = true;
+    flowControl.requestTick = xTaskGetTickCount();
+    flowControl.requests++;
+
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlowControl_OnBlockReceived()
+ *******************************************************************************
+ * Summary:
+ *  Notifies the flow controller that a file block was handed to the OTA agent.
+ *  The first block of a request yields an RTT sample, except for re-requests
+ *  where the sample would be ambiguous. A completed batch grows the window,
+ *  exponentially below the slow start threshold and by one block above it,
+ *  unless the buffer pool is under pressure.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaFlowControl_OnBlockReceived( void )
+{
+    bool poolUnderPressure = OtaFlowControl_IsPoolUnderPressure();
+    TickType_t now = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+
+    if( flowControl.requestOutstanding == true )
+    {
+        if( flowControl.retransmitted == false )
+        {
+            updateRtt( ( uint32_t ) ( ( now - flowControl.requestTick ) * portTICK_PERIOD_MS ) );
+        }
+
+        flowControl.requestOutstanding = false;
+    }
+
+    flowControl.blocksInBatch++;
+
+    if( ( flowControl.blocksInBatch == flowControl.batchWindow ) &&
+            ( flowControl.decreasedInBatch == false ) &&
+            ( poolUnderPressure == false ) &&
+            ( flowControl.targetWindow < OTA_FLOW_CONTROL_MAX_WINDOW ) )
+    {
+        if( flowControl.targetWindow < flowControl.slowStartThreshold )
+        {
+            flowControl.targetWindow *= 2U;
+        }
+        else
+        {
+            flowControl.targetWindow++;
+        }
+
+        if( flowControl.targetWindow > OTA_FLOW_CONTROL_MAX_WINDOW )
+        {
+            flowControl.targetWindow = OTA_FLOW_CONTROL_MAX_WINDOW;
+        }
+
+        /* The agent builds its next request once it processed this block. */
+        flowControl.window = flowControl.targetWindow;
+
+        flowControl.windowIncreases++;
+    }
+
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlowControl_OnBlockDropped()
+ *******************************************************************************
+ * Summary:
+ *  Notifies the flow controller that a received block could not be handed to
+ *  the OTA agent, e.g. because the buffer pool was exhausted. Shrinks the
+ *  window of the next request.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaFlowControl_OnBlockDropped( void )
+{
+    taskENTER_CRITICAL();
+    flowControl.drops++;
+    shrinkWindow();
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaFlowControl_GetStatistics()
+ *******************************************************************************
+ * Summary:
+ *  Returns a snapshot of the window and RTT estimates.
+ *
+ * Parameters:
+ *  pStatistics: Pointer to the structure receiving the statistics.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaFlowControl_GetStatistics( OtaFlowControlStatistics_t * pStatistics )
+{
+    if( pStatistics != NULL )
+    {
+        taskENTER_CRITICAL();
+        pStatistics->window = flowControl.batchWindow;
+        pStatistics->targetWindow = flowControl.targetWindow;
+        pStatistics->slowStartThreshold = flowControl.slowStartThreshold;
+        pStatistics->smoothedRttMs = flowControl.smoothedRttMs;
+        pStatistics->rttVariationMs = flowControl.rttVariationMs;
+        pStatistics->requestWaitMs = flowControl.requestWaitMs;
+        pStatistics->rttSamples = flowControl.rttSamples;
+        pStatistics->requests = flowControl.requests;
+        pStatistics->timeouts = flowControl.timeouts;
+        pStatistics->drops = flowControl.drops;
+        pStatistics->windowIncreases = flowControl.windowIncreases;
+        pStatistics->windowDecreases = flowControl.windowDecreases;
+        taskEXIT_CRITICAL();
+    }
+}
+
+/* [] END OF FILE */
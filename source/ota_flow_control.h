@@ -0,0 +1,112 @@
+/********************************************************************************
+ * File Name: ota_flow_control.h
+ *
+ * Description: The API of the flow controller adapting the number of OTA file
+ * blocks requested per stream request and the request wait time.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef OTA_FLOW_CONTROL_H_
+#define OTA_FLOW_CONTROL_H_
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/* Number of blocks requested per stream request before any feedback. */
+#ifndef OTA_FLOW_CONTROL_INITIAL_WINDOW
+#define OTA_FLOW_CONTROL_INITIAL_WINDOW         (8U)
+#endif
+
+/* Upper bound of the block request window. The OTA service sends at most
+ * 128 KB per request, e.g. 32 blocks of 4 KB. */
+#ifndef OTA_FLOW_CONTROL_MAX_WINDOW
+#define OTA_FLOW_CONTROL_MAX_WINDOW             ( ( uint32_t ) ( ( 128UL * 1024UL ) / otaconfigFILE_BLOCK_SIZE ) )
+#endif
+
+/* Bounds of the RTT based request wait time, in milliseconds. The upper bound
+ * is also used until the first RTT sample is taken. */
+#ifndef OTA_FLOW_CONTROL_MIN_REQUEST_WAIT_MS
+#define OTA_FLOW_CONTROL_MIN_REQUEST_WAIT_MS    (1000U)
+#endif
+
+#ifndef OTA_FLOW_CONTROL_MAX_REQUEST_WAIT_MS
+#define OTA_FLOW_CONTROL_MAX_REQUEST_WAIT_MS    (10000U)
+#endif
+
+/* Buffer pool occupancy, in percent, above which the window stops growing. */
+#ifndef OTA_FLOW_CONTROL_POOL_PRESSURE_PERCENT
+#define OTA_FLOW_CONTROL_POOL_PRESSURE_PERCENT  (75U)
+#endif
+
+/* Snapshot of the flow controller state. */
+typedef struct OtaFlowControlStatistics
+{
+    uint32_t window;                /* Blocks asked for in the current request. */
+    uint32_t targetWindow;          /* Blocks to ask for in the next request. */
+    uint32_t slowStartThreshold;    /* Window above which growth is linear. */
+    uint32_t smoothedRttMs;         /* Smoothed request to first block RTT. */
+    uint32_t rttVariationMs;        /* Mean deviation of the RTT. */
+    uint32_t requestWaitMs;         /* Current request wait time. */
+    uint32_t rttSamples;            /* Number of RTT samples taken. */
+    uint32_t requests;              /* Stream requests sent. */
+    uint32_t timeouts;              /* Requests re-sent before the batch completed. */
+    uint32_t drops;                 /* Blocks dropped on the receive path. */
+    uint32_t windowIncreases;       /* Times the window was grown. */
+    uint32_t windowDecreases;       /* Times the window was shrunk. */
+} OtaFlowControlStatistics_t;
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+void OtaFlowControl_Reset( void );
+
+uint32_t OtaFlowControl_GetBlockWindow( void );
+
+uint32_t OtaFlowControl_GetRequestWaitMs( void );
+
+void OtaFlowControl_OnBlockRequest( uint32_t numBlocks );
+
+void OtaFlowControl_OnBlockReceived( void );
+
+void OtaFlowControl_OnBlockDropped( void );
+
+bool OtaFlowControl_IsPoolUnderPressure( void );
+
+void OtaFlowControl_GetStatistics( OtaFlowControlStatistics_t * pStatistics );
+
+
+#endif /* ifndef OTA_FLOW_CONTROL_H_ */
@@ -0,0 +1,189 @@
+/********************************************************************************
+ * File Name: ota_image_hash.c
+ *
+ * Description: Implementation of the incremental digest of the update file.
+ * The file is hashed in order while it is received, so closing it only
+ * finishes the digest and verifies the signature.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* RTOS includes. */
+#include <FreeRTOS.h>
+#include <task.h>
+
+/* mbedTLS includes. */
+#include "mbedtls/sha256.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pk.h"
+
+/* Include header for the incremental image digest. */
+#include "ota_image_hash.h"
+
+/* Size of a SHA-256 digest. */
+#define IMAGE_HASH_DIGEST_SIZE          (32U)
+
+/* Digest of the file being received. Only updated from the flash writer
+ * task, and read by the OTA agent once the writer is idle. */
+static mbedtls_sha256_context hashContext;
+
+/* Statistics of the current file. */
+static OtaImageHashStatistics_t hashStatistics;
+
+
+/*******************************************************************************
+ * Function Name: OtaImageHash_Begin()
+ *******************************************************************************
+ * Summary:
+ *  Starts the digest of a new file.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaImageHash_Begin( void )
+{
+    mbedtls_sha256_init( &hashContext );
+    ( void ) mbedtls_sha256_starts_ret( &hashContext, 0 );
+
+    memset( &hashStatistics, 0x00, sizeof( hashStatistics ) );
+}
+
+/*******************************************************************************
+ * Function Name: OtaImageHash_Update()
+ *******************************************************************************
+ * Summary:
+ *  Adds the next bytes of the file to the digest. Must be fed the file in
+ *  order.
+ *
+ * Parameters:
+ *  pData:  Next bytes of the file.
+ *  length: Number of bytes.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaImageHash_Update( const uint8_t * pData,
+        uint32_t length )
+{
+    ( void ) mbedtls_sha256_update_ret( &hashContext, pData, length );
+    hashStatistics.bytesHashed += length;
+}
+
+/*******************************************************************************
+ * Function Name: OtaImageHash_Verify()
+ *******************************************************************************
+ * Summary:
+ *  Finishes the digest and verifies the ECDSA signature of the job against
+ *  the code signing certificate, as the PAL does after reading the file back.
+ *
+ * Parameters:
+ *  pFileContext: OTA file context, holding the size and signature of the file.
+ *
+ * Return:
+ *  true if the whole file was hashed and the signature matches, false
+ *  otherwise.
+ *
+ *******************************************************************************/
+bool OtaImageHash_Verify( const OtaFileContext_t * pFileContext )
+{
+    static const char signingCertificate[] = AWS_IOT_OTA_SIGNING_CERT;
+    uint8_t digest[ IMAGE_HASH_DIGEST_SIZE ];
+    mbedtls_x509_crt certificate;
+    TickType_t verifyStart = xTaskGetTickCount();
+    bool verified = false;
+
+    if( ( pFileContext == NULL ) || ( pFileContext->pSignature == NULL ) ||
+            ( hashStatistics.bytesHashed != pFileContext->fileSize ) )
+    {
+        mbedtls_sha256_free( &hashContext );
+        return false;
+    }
+
+    ( void ) mbedtls_sha256_finish_ret( &hashContext, digest );
+    mbedtls_sha256_free( &hashContext );
+
+    mbedtls_x509_crt_init( &certificate );
+
+    if( mbedtls_x509_crt_parse( &certificate, ( const unsigned char * ) signingCertificate,
+            sizeof( signingCertificate ) ) != 0 )
+    {
+        printf("Failed to parse the code signing certificate.\n");
+    }
+    else if( mbedtls_pk_verify( &certificate.pk, MBEDTLS_MD_SHA256, digest, sizeof( digest ),
+            pFileContext->pSignature->data, pFileContext->pSignature->size ) != 0 )
+    {
+        printf("Signature of the received file does not match.\n");
+    }
+    else
+    {
+        verified = true;
+    }
+
+    mbedtls_x509_crt_free( &certificate );
+
+    hashStatistics.verifyMs = ( xTaskGetTickCount() - verifyStart ) * portTICK_PERIOD_MS;
+
+    return verified;
+}
+
+/*******************************************************************************
+ * Function Name: OtaImageHash_GetStatistics()
+ *******************************************************************************
+ * Summary:
+ *  Returns the statistics of the current file.
+ *
+ * Parameters:
+ *  pStatistics: Pointer to the structure receiving the statistics.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaImageHash_GetStatistics( OtaImageHashStatistics_t * pStatistics )
+{
+    if( pStatistics != NULL )
+    {
+        *pStatistics = hashStatistics;
+    }
+}
+
+/* [] END OF FILE */
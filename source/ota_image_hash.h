@@ -0,0 +1,80 @@
+/********************************************************************************
+ * File Name: ota_image_hash.h
+ *
+ * Description: Defines the API of the incremental digest of the update file,
+ * used to verify its signature without reading the file back from flash.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef OTA_IMAGE_HASH_H_
+#define OTA_IMAGE_HASH_H_
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* OTA Library include. */
+#include "ota.h"
+#include "ota_config.h"
+
+
+/* Set to 1 to hash the file while it is received and verify its signature on
+ * close from that digest, instead of the PAL reading the whole file back from
+ * the secondary slot. */
+#ifndef OTA_IMAGE_HASH_ENABLE
+#define OTA_IMAGE_HASH_ENABLE           (1)
+#endif
+
+/* Statistics of the file being hashed. */
+typedef struct OtaImageHashStatistics
+{
+    uint32_t bytesHashed;           /* Bytes of the file added to the digest. */
+    uint32_t verifyMs;              /* Time to finish the digest and verify the signature. */
+} OtaImageHashStatistics_t;
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+void OtaImageHash_Begin( void );
+
+void OtaImageHash_Update( const uint8_t * pData,
+        uint32_t length );
+
+bool OtaImageHash_Verify( const OtaFileContext_t * pFileContext );
+
+void OtaImageHash_GetStatistics( OtaImageHashStatistics_t * pStatistics );
+
+
+#endif /* ifndef OTA_IMAGE_HASH_H_ */
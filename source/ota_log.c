@@ -0,0 +1,338 @@
+/********************************************************************************
+ * File Name: ota_log.c
+ *
+ * Description: Implementation of a deferred, non-blocking log pipeline for the
+ * OTA data path. Records are queued in RAM and printed by a low priority task.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+
+/* RTOS includes. */
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+
+/* Include header for the deferred log pipeline. */
+#include "ota_log.h"
+
+/* A log record as stored in the queue. */
+typedef struct OtaLogRecord
+{
+    char message[ OTA_LOG_RECORD_SIZE ];
+} OtaLogRecord_t;
+
+/* Short tags printed in front of the records of each module. */
+static const char * const logModuleTags[ OTA_LOG_MODULE_MAX ] =
+{
+    "APP",
+    "MQTT",
+    "DATA"
+};
+
+/* Short tags printed after the module tag for each level. */
+static const char * const logLevelTags[ OTA_LOG_LEVEL_DEBUG + 1 ] =
+{
+    "",
+    "E",
+    "W",
+    "I",
+    "D"
+};
+
+/* Current log level of every module, adjustable at runtime. */
+static _Atomic uint8_t logLevels[ OTA_LOG_MODULE_MAX ] =
+{
+    OTA_LOG_DEFAULT_LEVEL,
+    OTA_LOG_DEFAULT_LEVEL,
+    OTA_LOG_DEFAULT_LEVEL
+};
+
+/* Static storage of the record queue and the log task. */
+static uint8_t logQueueStorage[ OTA_LOG_QUEUE_LENGTH * sizeof( OtaLogRecord_t ) ];
+static StaticQueue_t logQueueBuffer;
+static StackType_t logTaskStack[ OTA_LOG_TASK_STACK_SIZE / sizeof( StackType_t ) ];
+static StaticTask_t logTaskBuffer;
+static TaskHandle_t logTaskHandle = NULL;
+
+/* Queue of records waiting to be printed, NULL until the pipeline is started. */
+static QueueHandle_t logQueue = NULL;
+
+/* Pipeline statistics. */
+static _Atomic uint32_t recordsWritten = 0U;
+static _Atomic uint32_t recordsDropped = 0U;
+static _Atomic uint32_t queueHighWaterMark = 0U;
+
+/* Drops not yet reported by the log task. */
+static _Atomic uint32_t unreportedDrops = 0U;
+
+
+/*******************************************************************************
+ * Function Name: logTask()
+ *******************************************************************************
+ * Summary:
+ *  Low priority task printing the queued log records. Runs when the data path
+ *  is idle and reports how many records were dropped under overload.
+ *
+ * Parameters:
+ *  pParam: Unused.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+static void logTask( void * pParam )
+{
+    OtaLogRecord_t record;
+    uint32_t drops;
+
+    ( void ) pParam;
+
+    for( ;; )
+    {
+        if( xQueueReceive( logQueue, &record, portMAX_DELAY ) == pdTRUE )
+        {
+            printf( "%s", record.message );
+        }
+
+        drops = atomic_exchange( &unreportedDrops, 0U );
+        if( drops > 0U )
+        {
+            printf( "[LOG] %u log messages dropped.\n", ( unsigned int ) drops );
+        }
+    }
+}
+
+/*******************************************************************************
+ * Function Name: OtaLog_Init()
+ *******************************************************************************
+ * Summary:
+ *  Creates the record queue and the log task. Messages logged before this
+ *  call are printed synchronously.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  true on success, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaLog_Init( void )
+{
+    bool status = false;
+    QueueHandle_t queue;
+
+    queue = xQueueCreateStatic( OTA_LOG_QUEUE_LENGTH, sizeof( OtaLogRecord_t ),
+            logQueueStorage, &logQueueBuffer );
+
+    if( queue != NULL )
+    {
+        logQueue = queue;
+
+        logTaskHandle = xTaskCreateStatic( logTask, "OTA LOG TASK",
+                OTA_LOG_TASK_STACK_SIZE / sizeof( StackType_t ), NULL,
+                OTA_LOG_TASK_PRIORITY, logTaskStack, &logTaskBuffer );
+
+        if( logTaskHandle != NULL )
+        {
+            status = true;
+        }
+        else
+        {
+            logQueue = NULL;
+        }
+    }
+
+    return status;
+}
+
+/*******************************************************************************
+ * Function Name: OtaLog_SetLevel()
+ *******************************************************************************
+ * Summary:
+ *  Changes the log level of a module at runtime.
+ *
+ * Parameters:
+ *  module: Module whose level is changed.
+ *  level:  New log level.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaLog_SetLevel( OtaLogModule_t module,
+        OtaLogLevel_t level )
+{
+    if( module < OTA_LOG_MODULE_MAX )
+    {
+        atomic_store( &logLevels[ module ], ( uint8_t ) level );
+    }
+}
+
+/*******************************************************************************
+ * Function Name: OtaLog_GetLevel()
+ *******************************************************************************
+ * Summary:
+ *  Returns the current log level of a module.
+ *
+ * Parameters:
+ *  module: Module whose level is returned.
+ *
+ * Return:
+ *  The log level of the module.
+ *
+ *******************************************************************************/
+OtaLogLevel_t OtaLog_GetLevel( OtaLogModule_t module )
+{
+    OtaLogLevel_t level = OTA_LOG_LEVEL_NONE;
+
+    if( module < OTA_LOG_MODULE_MAX )
+    {
+        level = ( OtaLogLevel_t ) atomic_load( &logLevels[ module ] );
+    }
+
+    return level;
+}
+
+/*******************************************************************************
+ * Function Name: OtaLog_IsEnabled()
+ *******************************************************************************
+ * Summary:
+ *  Checks whether messages of a level are enabled for a module.
+ *
+ * Parameters:
+ *  module: Module of the message.
+ *  level:  Level of the message.
+ *
+ * Return:
+ *  true if the message is to be logged, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaLog_IsEnabled( OtaLogModule_t module,
+        OtaLogLevel_t level )
+{
+    return ( ( level != OTA_LOG_LEVEL_NONE ) && ( level <= OtaLog_GetLevel( module ) ) );
+}
+
+/*******************************************************************************
+ * Function Name: OtaLog_Write()
+ *******************************************************************************
+ * Summary:
+ *  Formats a message into a log record and appends it to the record queue
+ *  without waiting. If the queue is full the record is dropped and counted.
+ *  The message is formatted by the caller because its arguments often point
+ *  at topic names and payloads that are gone once the caller returns. The
+ *  messages logged per block are at debug level, which is disabled by
+ *  default, so the block data path does not format anything.
+ *
+ * Parameters:
+ *  module:     Module of the message.
+ *  level:      Level of the message.
+ *  pFormat:    printf style format string, followed by its arguments.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaLog_Write( OtaLogModule_t module,
+        OtaLogLevel_t level,
+        const char * pFormat, ... )
+{
+    OtaLogRecord_t record;
+    va_list args;
+    int length;
+    uint32_t waiting;
+    uint32_t highWaterMark;
+
+    length = snprintf( record.message, sizeof( record.message ), "[%s:%s] ",
+            ( module < OTA_LOG_MODULE_MAX ) ? logModuleTags[ module ] : "?",
+            ( level <= OTA_LOG_LEVEL_DEBUG ) ? logLevelTags[ level ] : "?" );
+
+    va_start( args, pFormat );
+    ( void ) vsnprintf( &record.message[ length ], sizeof( record.message ) - ( size_t ) length,
+            pFormat, args );
+    va_end( args );
+
+    if( logQueue == NULL )
+    {
+        /* The pipeline is not running yet, print synchronously. */
+        printf( "%s", record.message );
+    }
+    else if( xQueueSendToBack( logQueue, &record, 0U ) == pdTRUE )
+    {
+        atomic_fetch_add( &recordsWritten, 1U );
+
+        waiting = ( uint32_t ) uxQueueMessagesWaiting( logQueue );
+        highWaterMark = atomic_load( &queueHighWaterMark );
+        while( ( waiting > highWaterMark ) &&
+                !atomic_compare_exchange_weak( &queueHighWaterMark, &highWaterMark, waiting ) )
+        {
+        }
+    }
+    else
+    {
+        atomic_fetch_add( &recordsDropped, 1U );
+        atomic_fetch_add( &unreportedDrops, 1U );
+    }
+}
+
+/*******************************************************************************
+ * Function Name: OtaLog_GetStatistics()
+ *******************************************************************************
+ * Summary:
+ *  Returns a snapshot of the log pipeline statistics.
+ *
+ * Parameters:
+ *  pStatistics: Pointer to the structure receiving the statistics.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaLog_GetStatistics( OtaLogStatistics_t * pStatistics )
+{
+    if( pStatistics != NULL )
+    {
+        pStatistics->recordsWritten = atomic_load( &recordsWritten );
+        pStatistics->recordsDropped = atomic_load( &recordsDropped );
+        pStatistics->queueHighWaterMark = atomic_load( &queueHighWaterMark );
+        pStatistics->stackUnusedBytes = ( logTaskHandle != NULL ) ?
+                ( uint32_t ) uxTaskGetStackHighWaterMark( logTaskHandle ) * sizeof( StackType_t ) : 0U;
+    }
+}
+
+/* [] END OF FILE */
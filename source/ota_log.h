@@ -0,0 +1,141 @@
+/********************************************************************************
+ * File Name: ota_log.h
+ *
+ * Description: The API of a deferred, non-blocking log pipeline for the OTA
+ * data path.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef OTA_LOG_H_
+#define OTA_LOG_H_
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/* Number of log records buffered in RAM waiting to be printed. */
+#ifndef OTA_LOG_QUEUE_LENGTH
+#define OTA_LOG_QUEUE_LENGTH            (32U)
+#endif
+
+/* Maximum length of one log record, including the NULL terminator. Longer
+ * messages are truncated. */
+#ifndef OTA_LOG_RECORD_SIZE
+#define OTA_LOG_RECORD_SIZE             (128U)
+#endif
+
+/* Stack size and priority of the task draining the log records to the UART.
+ * The task calls printf, so it gets the stack of the other tasks of the
+ * application; the unused part is reported in the log statistics. */
+#ifndef OTA_LOG_TASK_STACK_SIZE
+#define OTA_LOG_TASK_STACK_SIZE         (1024U * 4U)
+#endif
+
+#ifndef OTA_LOG_TASK_PRIORITY
+#define OTA_LOG_TASK_PRIORITY           (tskIDLE_PRIORITY + 1U)
+#endif
+
+/* Default level of all modules. */
+#ifndef OTA_LOG_DEFAULT_LEVEL
+#define OTA_LOG_DEFAULT_LEVEL           OTA_LOG_LEVEL_INFO
+#endif
+
+/* Log levels, in increasing verbosity. */
+typedef enum OtaLogLevel
+{
+    OTA_LOG_LEVEL_NONE = 0,
+    OTA_LOG_LEVEL_ERROR,
+    OTA_LOG_LEVEL_WARN,
+    OTA_LOG_LEVEL_INFO,
+    OTA_LOG_LEVEL_DEBUG
+} OtaLogLevel_t;
+
+/* Modules with an individually adjustable log level. */
+typedef enum OtaLogModule
+{
+    OTA_LOG_MODULE_APP = 0,     /* Demo supervisor and OTA agent callbacks. */
+    OTA_LOG_MODULE_MQTT,        /* MQTT events, publish, subscribe. */
+    OTA_LOG_MODULE_DATA,        /* File block and job document data path. */
+    OTA_LOG_MODULE_MAX
+} OtaLogModule_t;
+
+/* Statistics of the deferred log pipeline. */
+typedef struct OtaLogStatistics
+{
+    uint32_t recordsWritten;    /* Records queued for printing. */
+    uint32_t recordsDropped;    /* Records dropped because the queue was full. */
+    uint32_t queueHighWaterMark;/* Largest number of records waiting at once. */
+    uint32_t stackUnusedBytes;  /* Stack of the log task never used so far. */
+} OtaLogStatistics_t;
+
+/* Logs a message if the level is enabled for the module. The message is
+ * formatted into a RAM record and printed later by the log task, so the caller
+ * never waits for the UART. Disabled levels cost only the level check. */
+#define OTA_LOG( module, level, ... )                           \
+    do                                                          \
+    {                                                           \
+        if( OtaLog_IsEnabled( ( module ), ( level ) ) == true ) \
+        {                                                       \
+            OtaLog_Write( ( module ), ( level ), __VA_ARGS__ ); \
+        }                                                       \
+    } while( 0 )
+
+#define OTA_LOG_ERROR( module, ... )    OTA_LOG( ( module ), OTA_LOG_LEVEL_ERROR, __VA_ARGS__ )
+#define OTA_LOG_WARN( module, ... )     OTA_LOG( ( module ), OTA_LOG_LEVEL_WARN, __VA_ARGS__ )
+#define OTA_LOG_INFO( module, ... )     OTA_LOG( ( module ), OTA_LOG_LEVEL_INFO, __VA_ARGS__ )
+#define OTA_LOG_DEBUG( module, ... )    OTA_LOG( ( module ), OTA_LOG_LEVEL_DEBUG, __VA_ARGS__ )
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+bool OtaLog_Init( void );
+
+void OtaLog_SetLevel( OtaLogModule_t module,
+        OtaLogLevel_t level );
+
+OtaLogLevel_t OtaLog_GetLevel( OtaLogModule_t module );
+
+bool OtaLog_IsEnabled( OtaLogModule_t module,
+        OtaLogLevel_t level );
+
+void OtaLog_Write( OtaLogModule_t module,
+        OtaLogLevel_t level,
+        const char * pFormat, ... );
+
+void OtaLog_GetStatistics( OtaLogStatistics_t * pStatistics );
+
+
+#endif /* ifndef OTA_LOG_H_ */
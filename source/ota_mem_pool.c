@@ -0,0 +1,338 @@
+/********************************************************************************
+ * File Name: ota_mem_pool.c
+ *
+ * Description: Implementation of a fixed-block allocator with size classes,
+ * which serves the memory requests of the OTA agent in constant time and
+ * without fragmentation.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <string.h>
+
+/* RTOS includes. */
+#include <FreeRTOS.h>
+#include <task.h>
+
+/* Include header for the OTA memory pool. */
+#include "ota_mem_pool.h"
+
+/* Total number of blocks and bytes over all classes. */
+#define OTA_MEM_POOL_TOTAL_BLOCKS       ( OTA_MEM_POOL_CLASS_0_COUNT + OTA_MEM_POOL_CLASS_1_COUNT + \
+                                          OTA_MEM_POOL_CLASS_2_COUNT + OTA_MEM_POOL_CLASS_3_COUNT )
+
+#define OTA_MEM_POOL_ARENA_SIZE         ( ( OTA_MEM_POOL_CLASS_0_SIZE * OTA_MEM_POOL_CLASS_0_COUNT ) + \
+                                          ( OTA_MEM_POOL_CLASS_1_SIZE * OTA_MEM_POOL_CLASS_1_COUNT ) + \
+                                          ( OTA_MEM_POOL_CLASS_2_SIZE * OTA_MEM_POOL_CLASS_2_COUNT ) + \
+                                          ( OTA_MEM_POOL_CLASS_3_SIZE * OTA_MEM_POOL_CLASS_3_COUNT ) )
+
+#if ( ( OTA_MEM_POOL_CLASS_0_SIZE % 8U ) != 0U ) || ( ( OTA_MEM_POOL_CLASS_1_SIZE % 8U ) != 0U ) || \
+    ( ( OTA_MEM_POOL_CLASS_2_SIZE % 8U ) != 0U ) || ( ( OTA_MEM_POOL_CLASS_3_SIZE % 8U ) != 0U )
+#error "OTA memory pool block sizes must be multiples of 8."
+#endif
+
+#if ( OTA_MEM_POOL_CLASS_0_SIZE >= OTA_MEM_POOL_CLASS_1_SIZE ) || \
+    ( OTA_MEM_POOL_CLASS_1_SIZE >= OTA_MEM_POOL_CLASS_2_SIZE ) || \
+    ( OTA_MEM_POOL_CLASS_2_SIZE >= OTA_MEM_POOL_CLASS_3_SIZE )
+#error "OTA memory pool size classes must be in ascending order."
+#endif
+
+#if ( OTA_MEM_POOL_TOTAL_BLOCKS > UINT16_MAX )
+#error "OTA memory pool has too many blocks."
+#endif
+
+/* State of one size class. The free blocks of a class are kept as a stack of
+ * block numbers in its segment of the freeStack array. */
+typedef struct OtaMemPoolClass
+{
+    uint32_t blockSize;
+    uint32_t blockCount;
+    uint8_t * pStorage;             /* First block of the class in the arena. */
+    uint16_t * pFreeStack;          /* Block numbers of the free blocks. */
+    bool * pAllocated;              /* Ownership flag of every block. */
+    uint32_t freeCount;             /* Number of entries on the free stack. */
+    OtaMemPoolClassStatistics_t statistics;
+} OtaMemPoolClass_t;
+
+/* Block storage of all classes, 8-byte aligned. */
+static uint64_t arena[ OTA_MEM_POOL_ARENA_SIZE / sizeof( uint64_t ) ];
+
+/* Free stacks and ownership flags of all classes. */
+static uint16_t freeStack[ OTA_MEM_POOL_TOTAL_BLOCKS ];
+static bool blockAllocated[ OTA_MEM_POOL_TOTAL_BLOCKS ];
+
+/* Size classes, smallest first. */
+static OtaMemPoolClass_t sizeClasses[ OTA_MEM_POOL_NUM_CLASSES ] =
+{
+    { .blockSize = OTA_MEM_POOL_CLASS_0_SIZE, .blockCount = OTA_MEM_POOL_CLASS_0_COUNT },
+    { .blockSize = OTA_MEM_POOL_CLASS_1_SIZE, .blockCount = OTA_MEM_POOL_CLASS_1_COUNT },
+    { .blockSize = OTA_MEM_POOL_CLASS_2_SIZE, .blockCount = OTA_MEM_POOL_CLASS_2_COUNT },
+    { .blockSize = OTA_MEM_POOL_CLASS_3_SIZE, .blockCount = OTA_MEM_POOL_CLASS_3_COUNT }
+};
+
+/* Requests no class could serve. */
+static uint32_t allocationFailures = 0U;
+
+/* Frees of foreign or already free blocks. */
+static uint32_t invalidFrees = 0U;
+
+/* Hook called on allocation failures. */
+static OtaMemPoolFailureHook_t failureHook = NULL;
+
+
+/*******************************************************************************
+ * Function Name: OtaMemPool_Init()
+ *******************************************************************************
+ * Summary:
+ *  Splits the arena into the size classes, puts all blocks on the free stacks
+ *  and clears the statistics. Must be called before OTA_Init().
+ *
+ * Parameters:
+ *  hook: Function called when an allocation fails, may be NULL.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaMemPool_Init( OtaMemPoolFailureHook_t hook )
+{
+    uint8_t * pStorage = ( uint8_t * ) arena;
+    uint32_t firstBlock = 0U;
+    uint32_t classIndex;
+    uint32_t block;
+    OtaMemPoolClass_t * pClass;
+
+    taskENTER_CRITICAL();
+
+    for( classIndex = 0U; classIndex < OTA_MEM_POOL_NUM_CLASSES; classIndex++ )
+    {
+        pClass = &sizeClasses[ classIndex ];
+
+        pClass->pStorage = pStorage;
+        pClass->pFreeStack = &freeStack[ firstBlock ];
+        pClass->pAllocated = &blockAllocated[ firstBlock ];
+        pClass->freeCount = pClass->blockCount;
+
+        /* Stack the blocks so that they are handed out in address order. */
+        for( block = 0U; block < pClass->blockCount; block++ )
+        {
+            pClass->pFreeStack[ block ] = ( uint16_t ) ( pClass->blockCount - 1U - block );
+            pClass->pAllocated[ block ] = false;
+        }
+
+        memset( &pClass->statistics, 0x00, sizeof( pClass->statistics ) );
+        pClass->statistics.blockSize = pClass->blockSize;
+        pClass->statistics.blockCount = pClass->blockCount;
+
+        pStorage += pClass->blockSize * pClass->blockCount;
+        firstBlock += pClass->blockCount;
+    }
+
+    allocationFailures = 0U;
+    invalidFrees = 0U;
+    failureHook = hook;
+
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaMemPool_Malloc()
+ *******************************************************************************
+ * Summary:
+ *  Allocates a block from the smallest class that fits the request. If that
+ *  class is exhausted the next larger one is tried. Runs in constant time,
+ *  the memory never fragments.
+ *
+ * Parameters:
+ *  size: Number of bytes requested.
+ *
+ * Return:
+ *  Pointer to the block, NULL if no class can serve the request.
+ *
+ *******************************************************************************/
+void * OtaMemPool_Malloc( size_t size )
+{
+    void * pBlock = NULL;
+    bool spilled = false;
+    uint32_t classIndex;
+    uint32_t block;
+    OtaMemPoolClass_t * pClass;
+
+    taskENTER_CRITICAL();
+
+    for( classIndex = 0U; ( classIndex < OTA_MEM_POOL_NUM_CLASSES ) && ( pBlock == NULL ); classIndex++ )
+    {
+        pClass = &sizeClasses[ classIndex ];
+
+        if( size > pClass->blockSize )
+        {
+            continue;
+        }
+
+        if( pClass->freeCount == 0U )
+        {
+            spilled = true;
+            continue;
+        }
+
+        block = pClass->pFreeStack[ --pClass->freeCount ];
+        pClass->pAllocated[ block ] = true;
+        pBlock = pClass->pStorage + ( block * pClass->blockSize );
+
+        pClass->statistics.allocations++;
+        pClass->statistics.inUse++;
+        if( pClass->statistics.inUse > pClass->statistics.highWaterMark )
+        {
+            pClass->statistics.highWaterMark = pClass->statistics.inUse;
+        }
+        if( spilled == true )
+        {
+            pClass->statistics.spills++;
+        }
+    }
+
+    if( pBlock == NULL )
+    {
+        allocationFailures++;
+    }
+
+    taskEXIT_CRITICAL();
+
+    if( ( pBlock == NULL ) && ( failureHook != NULL ) )
+    {
+        failureHook( size );
+    }
+
+    return pBlock;
+}
+
+/*******************************************************************************
+ * Function Name: OtaMemPool_Free()
+ *******************************************************************************
+ * Summary:
+ *  Returns a block to its class in constant time. Pointers that do not start
+ *  a block of the pool and blocks that are already free are rejected and
+ *  counted.
+ *
+ * Parameters:
+ *  pBlock: Pointer to the block to release, NULL is ignored.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaMemPool_Free( void * pBlock )
+{
+    uint8_t * pByte = ( uint8_t * ) pBlock;
+    bool released = false;
+    uint32_t classIndex;
+    uint32_t offset;
+    uint32_t block;
+    OtaMemPoolClass_t * pClass;
+
+    if( pBlock == NULL )
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+
+    for( classIndex = 0U; classIndex < OTA_MEM_POOL_NUM_CLASSES; classIndex++ )
+    {
+        pClass = &sizeClasses[ classIndex ];
+
+        if( ( pByte < pClass->pStorage ) ||
+                ( pByte >= ( pClass->pStorage + ( pClass->blockSize * pClass->blockCount ) ) ) )
+        {
+            continue;
+        }
+
+        offset = ( uint32_t ) ( pByte - pClass->pStorage );
+        block = offset / pClass->blockSize;
+
+        if( ( ( offset % pClass->blockSize ) == 0U ) && ( pClass->pAllocated[ block ] == true ) )
+        {
+            pClass->pAllocated[ block ] = false;
+            pClass->pFreeStack[ pClass->freeCount++ ] = ( uint16_t ) block;
+            pClass->statistics.inUse--;
+            released = true;
+        }
+
+        break;
+    }
+
+    if( released == false )
+    {
+        invalidFrees++;
+    }
+
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaMemPool_GetStatistics()
+ *******************************************************************************
+ * Summary:
+ *  Returns a snapshot of the allocator statistics.
+ *
+ * Parameters:
+ *  pStatistics: Pointer to the structure receiving the statistics.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaMemPool_GetStatistics( OtaMemPoolStatistics_t * pStatistics )
+{
+    uint32_t classIndex;
+
+    if( pStatistics == NULL )
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+
+    for( classIndex = 0U; classIndex < OTA_MEM_POOL_NUM_CLASSES; classIndex++ )
+    {
+        pStatistics->classes[ classIndex ] = sizeClasses[ classIndex ].statistics;
+    }
+
+    pStatistics->allocationFailures = allocationFailures;
+    pStatistics->invalidFrees = invalidFrees;
+
+    taskEXIT_CRITICAL();
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,136 @@
+/********************************************************************************
+ * File Name: ota_mem_pool.h
+ *
+ * Description: The API of a fixed-block allocator with size classes, which
+ * serves the memory requests of the OTA agent.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef OTA_MEM_POOL_H_
+#define OTA_MEM_POOL_H_
+
+/* Standard includes. */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/* Block size and number of blocks of the size classes, smallest first. The
+ * OTA agent allocates short strings from the job document and one signature
+ * buffer per file; the largest class leaves headroom for other schemes. Block
+ * sizes must be multiples of 8. */
+#ifndef OTA_MEM_POOL_CLASS_0_SIZE
+#define OTA_MEM_POOL_CLASS_0_SIZE       (32U)
+#endif
+
+#ifndef OTA_MEM_POOL_CLASS_0_COUNT
+#define OTA_MEM_POOL_CLASS_0_COUNT      (16U)
+#endif
+
+#ifndef OTA_MEM_POOL_CLASS_1_SIZE
+#define OTA_MEM_POOL_CLASS_1_SIZE       (128U)
+#endif
+
+#ifndef OTA_MEM_POOL_CLASS_1_COUNT
+#define OTA_MEM_POOL_CLASS_1_COUNT      (8U)
+#endif
+
+#ifndef OTA_MEM_POOL_CLASS_2_SIZE
+#define OTA_MEM_POOL_CLASS_2_SIZE       (512U)
+#endif
+
+#ifndef OTA_MEM_POOL_CLASS_2_COUNT
+#define OTA_MEM_POOL_CLASS_2_COUNT      (4U)
+#endif
+
+#ifndef OTA_MEM_POOL_CLASS_3_SIZE
+#define OTA_MEM_POOL_CLASS_3_SIZE       (2048U)
+#endif
+
+#ifndef OTA_MEM_POOL_CLASS_3_COUNT
+#define OTA_MEM_POOL_CLASS_3_COUNT      (2U)
+#endif
+
+/* Number of size classes. */
+#define OTA_MEM_POOL_NUM_CLASSES        (4U)
+
+/* Usage statistics of one size class. */
+typedef struct OtaMemPoolClassStatistics
+{
+    uint32_t blockSize;             /* Size of the blocks of the class. */
+    uint32_t blockCount;            /* Number of blocks of the class. */
+    uint32_t inUse;                 /* Number of blocks currently allocated. */
+    uint32_t highWaterMark;         /* Largest number of blocks allocated at the same time. */
+    uint32_t allocations;           /* Number of blocks handed out. */
+    uint32_t spills;                /* Allocations served by this class because smaller ones were full. */
+} OtaMemPoolClassStatistics_t;
+
+/* Usage statistics of the allocator. */
+typedef struct OtaMemPoolStatistics
+{
+    OtaMemPoolClassStatistics_t classes[ OTA_MEM_POOL_NUM_CLASSES ];
+    uint32_t allocationFailures;    /* Requests no class could serve. */
+    uint32_t invalidFrees;          /* Frees of foreign or already free blocks. */
+} OtaMemPoolStatistics_t;
+
+/*******************************************************************************
+ * Function Name: (* OtaMemPoolFailureHook_t )()
+ *******************************************************************************
+ * Summary:
+ *  Hook called when an allocation request cannot be served, before NULL is
+ *  returned to the caller.
+ *
+ * Parameters:
+ *  size: Number of bytes requested.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+typedef void (* OtaMemPoolFailureHook_t )( size_t size );
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+void OtaMemPool_Init( OtaMemPoolFailureHook_t failureHook );
+
+void * OtaMemPool_Malloc( size_t size );
+
+void OtaMemPool_Free( void * pBlock );
+
+void OtaMemPool_GetStatistics( OtaMemPoolStatistics_t * pStatistics );
+
+
+#endif /* ifndef OTA_MEM_POOL_H_ */
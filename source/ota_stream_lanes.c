@@ -0,0 +1,689 @@
+/********************************************************************************
+ * File Name: ota_stream_lanes.c
+ *
+ * Description: Implementation of the stream lanes. Follows every stream request
+ * of the OTA agent with requests for the next blocks, and adapts the number
+ * of requests in flight to the measured throughput.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <string.h>
+
+/* RTOS includes. */
+#include <FreeRTOS.h>
+#include <task.h>
+
+/* OTA Library includes, to decode the request of the OTA agent and encode
+ * the requests of the other lanes. */
+#include "cbor.h"
+#include "ota_cbor.h"
+
+/* Include header for the flow controller, for the request wait time. */
+#include "ota_flow_control.h"
+
+/* Include header for the stream lanes. */
+#include "ota_stream_lanes.h"
+
+/* Largest client token copied from the request of the OTA agent. */
+#define LANES_CLIENT_TOKEN_SIZE         (16U)
+
+/* Stream request of the OTA agent, decoded. */
+typedef struct OtaStreamRequest
+{
+    char clientToken[ LANES_CLIENT_TOKEN_SIZE ];
+    int fileId;
+    int blockSize;
+    int blockOffset;
+    int numBlocks;
+    size_t bitmapSize;
+    uint8_t bitmap[ OTA_MAX_BLOCK_BITMAP_SIZE ];
+} OtaStreamRequest_t;
+
+/* Lane controller state. */
+typedef struct OtaStreamLanes
+{
+    uint32_t lanes;
+    TickType_t roundTick;           /* Time the current round started. */
+    bool roundStarted;
+    uint32_t blocksInRound;
+    uint32_t duplicatesInRound;
+    uint32_t dropsInRound;
+    uint32_t probeBaseRate;         /* Throughput before the lane was added. */
+    bool probing;                   /* The last round ran with an added lane. */
+    uint32_t holdRounds;
+    OtaStreamLanesStatistics_t statistics;
+} OtaStreamLanes_t;
+
+/* State of the current job. */
+static OtaStreamLanes_t streamLanes = { .lanes = 1U };
+
+/* Fields of a request of the OTA agent the requests for single blocks are
+ * built from. */
+typedef struct OtaStreamRequestSnapshot
+{
+    char clientToken[ LANES_CLIENT_TOKEN_SIZE ];
+    int fileId;
+    int blockSize;
+    int blockOffset;
+    size_t bitmapSize;
+    bool valid;
+} OtaStreamRequestSnapshot_t;
+
+/* Last request of the OTA agent. Only accessed from the OTA agent task. */
+static OtaStreamRequest_t agentRequest;
+static bool agentRequestValid = false;
+
+/* Copy of the last request of the OTA agent for the requests for single
+ * blocks, which are built on the MQTT dispatcher task. Only accessed inside
+ * a critical section. */
+static OtaStreamRequestSnapshot_t requestSnapshot;
+
+#if ( OTA_STREAM_LANES_MAX > 1U )
+/* Bitmap of the lane request being built. */
+static uint8_t laneBitmap[ OTA_MAX_BLOCK_BITMAP_SIZE ];
+
+/* Blocks asked for by earlier requests that have not arrived yet. They are
+ * left out of later requests until they arrive or the request wait time has
+ * passed since the oldest of them was asked for. Only accessed from the OTA
+ * agent task. */
+static uint8_t outstandingBitmap[ OTA_MAX_BLOCK_BITMAP_SIZE ];
+static bool outstandingBlocks = false;
+static TickType_t outstandingTick = 0U;
+
+/* Blocks asked for in the current round. Only accessed from the OTA agent
+ * task. */
+static uint8_t roundBitmap[ OTA_MAX_BLOCK_BITMAP_SIZE ];
+#endif /* ( OTA_STREAM_LANES_MAX > 1U ) */
+
+
+/*******************************************************************************
+ * Function Name: findInteger()
+ *******************************************************************************
+ * Summary:
+ *  Reads an integer field of the request map.
+ *
+ * Parameters:
+ *  pMap:   Request map.
+ *  pKey:   Key of the field.
+ *  pValue: Receives the value.
+ *
+ * Return:
+ *  true on success, false if the field is missing or not an integer.
+ *
+ *******************************************************************************/
+static bool findInteger( const CborValue * pMap,
+        const char * pKey,
+        int * pValue )
+{
+    CborValue value;
+
+    return ( cbor_value_map_find_value( pMap, pKey, &value ) == CborNoError ) &&
+            ( cbor_value_is_integer( &value ) == true ) &&
+            ( cbor_value_get_int( &value, pValue ) == CborNoError );
+}
+
+/*******************************************************************************
+ * Function Name: decodeRequest()
+ *******************************************************************************
+ * Summary:
+ *  Decodes the stream request of the OTA agent.
+ *
+ * Parameters:
+ *  pRequest:       Encoded request.
+ *  requestSize:    Size of the encoded request.
+ *
+ * Return:
+ *  true on success, false otherwise.
+ *
+ *******************************************************************************/
+static bool decodeRequest( const uint8_t * pRequest,
+        size_t requestSize )
+{
+    CborParser parser;
+    CborValue map;
+    CborValue value;
+    size_t length = sizeof( agentRequest.clientToken ) - 1U;
+
+    memset( &agentRequest, 0x00, sizeof( agentRequest ) );
+    agentRequest.bitmapSize = sizeof( agentRequest.bitmap );
+
+    if( ( cbor_parser_init( pRequest, requestSize, 0U, &parser, &map ) != CborNoError ) ||
+            ( cbor_value_is_map( &map ) == false ) )
+    {
+        return false;
+    }
+
+    if( ( cbor_value_map_find_value( &map, "c", &value ) != CborNoError ) ||
+            ( cbor_value_is_text_string( &value ) == false ) ||
+            ( cbor_value_copy_text_string( &value, agentRequest.clientToken, &length, NULL ) != CborNoError ) )
+    {
+        return false;
+    }
+
+    if( ( cbor_value_map_find_value( &map, "b", &value ) != CborNoError ) ||
+            ( cbor_value_is_byte_string( &value ) == false ) ||
+            ( cbor_value_copy_byte_string( &value, agentRequest.bitmap, &agentRequest.bitmapSize, NULL ) != CborNoError ) )
+    {
+        return false;
+    }
+
+    return ( findInteger( &map, "f", &agentRequest.fileId ) == true ) &&
+            ( findInteger( &map, "l", &agentRequest.blockSize ) == true ) &&
+            ( findInteger( &map, "o", &agentRequest.blockOffset ) == true ) &&
+            ( findInteger( &map, "n", &agentRequest.numBlocks ) == true ) &&
+            ( agentRequest.numBlocks > 0 );
+}
+
+/*******************************************************************************
+ * Function Name: adaptLanes()
+ *******************************************************************************
+ * Summary:
+ *  Grows or shrinks the number of lanes at the end of a round by hill
+ *  climbing on the measured throughput. A lane is added while the previous
+ *  addition brought at least OTA_STREAM_LANES_GAIN_PERCENT more throughput;
+ *  dropped blocks and rounds without any block remove a lane. Must be called
+ *  inside a critical section.
+ *
+ * Parameters:
+ *  rate: Blocks per second of the round, 0 if no block arrived.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+static void adaptLanes( uint32_t rate )
+{
+    streamLanes.statistics.blocksPerSecond = rate;
+
+    if( ( streamLanes.dropsInRound > 0U ) || ( rate == 0U ) )
+    {
+        if( streamLanes.lanes > 1U )
+        {
+            streamLanes.lanes--;
+            streamLanes.statistics.laneDecreases++;
+        }
+        streamLanes.probing = false;
+        streamLanes.holdRounds = OTA_STREAM_LANES_HOLD_ROUNDS;
+    }
+    else if( streamLanes.probing == true )
+    {
+        streamLanes.probing = false;
+        if( ( ( uint64_t ) rate * 100U ) <
+                ( ( uint64_t ) streamLanes.probeBaseRate * ( 100U + OTA_STREAM_LANES_GAIN_PERCENT ) ) )
+        {
+            streamLanes.lanes--;
+            streamLanes.statistics.laneDecreases++;
+            streamLanes.holdRounds = OTA_STREAM_LANES_HOLD_ROUNDS;
+        }
+    }
+    else if( streamLanes.holdRounds > 0U )
+    {
+        streamLanes.holdRounds--;
+    }
+    else if( streamLanes.lanes < OTA_STREAM_LANES_MAX )
+    {
+        streamLanes.probeBaseRate = rate;
+        streamLanes.probing = true;
+        streamLanes.lanes++;
+        streamLanes.statistics.laneIncreases++;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: OtaStreamLanes_Reset()
+ *******************************************************************************
+ * Summary:
+ *  Returns to a single lane and clears the statistics for a new job.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaStreamLanes_Reset( void )
+{
+    taskENTER_CRITICAL();
+    memset( &streamLanes, 0x00, sizeof( streamLanes ) );
+    streamLanes.lanes = 1U;
+    requestSnapshot.valid = false;
+    taskEXIT_CRITICAL();
+
+    agentRequestValid = false;
+#if ( OTA_STREAM_LANES_MAX > 1U )
+    memset( outstandingBitmap, 0x00, sizeof( outstandingBitmap ) );
+    memset( roundBitmap, 0x00, sizeof( roundBitmap ) );
+    outstandingBlocks = false;
+#endif
+}
+
+#if ( OTA_STREAM_LANES_MAX > 1U )
+/*******************************************************************************
+ * Function Name: updateOutstandingBlocks()
+ *******************************************************************************
+ * Summary:
+ *  Forgets the outstanding blocks that arrived, which the OTA agent no longer
+ *  asks for, and all outstanding blocks once they are overdue or blocks were
+ *  dropped on the receive path, so that they are asked for again.
+ *
+ * Parameters:
+ *  now:        Current tick count.
+ *  dropped:    Blocks were dropped in the round that ended.
+ *
+ * Return:
+ *  true if blocks missing for the agent are not outstanding, false if all
+ *  missing blocks are in flight.
+ *
+ *******************************************************************************/
+static bool updateOutstandingBlocks( TickType_t now,
+        bool dropped )
+{
+    bool blocksAvailable = false;
+    size_t byteIndex;
+
+    if( ( outstandingBlocks == true ) &&
+            ( ( dropped == true ) ||
+            ( ( now - outstandingTick ) >= pdMS_TO_TICKS( OtaFlowControl_GetRequestWaitMs() ) ) ) )
+    {
+        memset( outstandingBitmap, 0x00, sizeof( outstandingBitmap ) );
+
+        taskENTER_CRITICAL();
+        streamLanes.statistics.outstandingExpired++;
+        taskEXIT_CRITICAL();
+    }
+
+    outstandingBlocks = false;
+
+    for( byteIndex = 0U; byteIndex < sizeof( outstandingBitmap ); byteIndex++ )
+    {
+        if( byteIndex < agentRequest.bitmapSize )
+        {
+            outstandingBitmap[ byteIndex ] &= agentRequest.bitmap[ byteIndex ];
+            if( ( agentRequest.bitmap[ byteIndex ] & ( uint8_t ) ~outstandingBitmap[ byteIndex ] ) != 0U )
+            {
+                blocksAvailable = true;
+            }
+        }
+        else
+        {
+            outstandingBitmap[ byteIndex ] = 0U;
+        }
+
+        if( outstandingBitmap[ byteIndex ] != 0U )
+        {
+            outstandingBlocks = true;
+        }
+    }
+
+    return blocksAvailable;
+}
+#endif /* ( OTA_STREAM_LANES_MAX > 1U ) */
+
+/*******************************************************************************
+ * Function Name: OtaStreamLanes_OnBlockRequest()
+ *******************************************************************************
+ * Summary:
+ *  Notifies the lanes that the OTA agent is about to send a stream request,
+ *  which ends the current round. The request is kept to build the requests
+ *  for single blocks. With more than one lane it is also used to build the
+ *  request sent in its place and the requests of the other lanes, which all
+ *  leave out the blocks still in flight from earlier requests.
+ *
+ * Parameters:
+ *  pRequest:       Encoded stream request of the OTA agent.
+ *  requestSize:    Size of the encoded request.
+ *
+ * Return:
+ *  Number of lanes for this round, including the request of the agent. 0 if
+ *  all blocks missing for the agent are in flight and no request is needed.
+ *
+ *******************************************************************************/
+uint32_t OtaStreamLanes_OnBlockRequest( const uint8_t * pRequest,
+        size_t requestSize )
+{
+    TickType_t now = xTaskGetTickCount();
+    uint32_t elapsedMs;
+    uint32_t newBlocks;
+    uint32_t lanes;
+#if ( OTA_STREAM_LANES_MAX > 1U )
+    bool dropped;
+#endif
+
+    taskENTER_CRITICAL();
+    /* Only blocks that were not received before count towards the rate. */
+    if( streamLanes.roundStarted == true )
+    {
+        elapsedMs = ( now - streamLanes.roundTick ) * portTICK_PERIOD_MS;
+        newBlocks = ( streamLanes.blocksInRound > streamLanes.duplicatesInRound ) ?
+                ( streamLanes.blocksInRound - streamLanes.duplicatesInRound ) : 0U;
+        adaptLanes( ( elapsedMs > 0U ) ?
+                ( uint32_t ) ( ( ( uint64_t ) newBlocks * 1000U ) / elapsedMs ) : 0U );
+    }
+#if ( OTA_STREAM_LANES_MAX > 1U )
+    dropped = ( streamLanes.dropsInRound > 0U );
+#endif
+    streamLanes.roundStarted = true;
+    streamLanes.roundTick = now;
+    streamLanes.blocksInRound = 0U;
+    streamLanes.duplicatesInRound = 0U;
+    streamLanes.dropsInRound = 0U;
+    streamLanes.statistics.rounds++;
+    streamLanes.statistics.lanes = streamLanes.lanes;
+    lanes = streamLanes.lanes;
+    taskEXIT_CRITICAL();
+
+    agentRequestValid = decodeRequest( pRequest, requestSize );
+
+#if ( OTA_STREAM_LANES_MAX > 1U )
+    memset( roundBitmap, 0x00, sizeof( roundBitmap ) );
+
+    if( ( agentRequestValid == true ) && ( updateOutstandingBlocks( now, dropped ) == false ) )
+    {
+        lanes = 0U;
+
+        taskENTER_CRITICAL();
+        streamLanes.statistics.requestsSkipped++;
+        taskEXIT_CRITICAL();
+    }
+#endif
+
+    taskENTER_CRITICAL();
+    if( agentRequestValid == true )
+    {
+        memcpy( requestSnapshot.clientToken, agentRequest.clientToken, sizeof( requestSnapshot.clientToken ) );
+        requestSnapshot.fileId = agentRequest.fileId;
+        requestSnapshot.blockSize = agentRequest.blockSize;
+        requestSnapshot.blockOffset = agentRequest.blockOffset;
+        requestSnapshot.bitmapSize = agentRequest.bitmapSize;
+    }
+    requestSnapshot.valid = agentRequestValid;
+    taskEXIT_CRITICAL();
+
+    return ( agentRequestValid == true ) ? lanes : 1U;
+}
+
+#if ( OTA_STREAM_LANES_MAX > 1U )
+/*******************************************************************************
+ * Function Name: OtaStreamLanes_BuildRequest()
+ *******************************************************************************
+ * Summary:
+ *  Encodes the request of a lane. Every lane asks for the first numBlocks
+ *  blocks missing for the OTA agent that are not in flight, and marks them as
+ *  in flight, so lane n asks for the blocks following those of lanes 0 to
+ *  n - 1. Lane 0 is sent in place of the request of the agent.
+ *
+ * Parameters:
+ *  lane:           Lane number, 0 for the request of the agent.
+ *  pBuffer:        Buffer receiving the encoded request.
+ *  bufferSize:     Size of the buffer.
+ *  pEncodedSize:   Receives the size of the encoded request.
+ *
+ * Return:
+ *  true if a request was encoded, false if no blocks are left for the lane.
+ *
+ *******************************************************************************/
+bool OtaStreamLanes_BuildRequest( uint32_t lane,
+        uint8_t * pBuffer,
+        size_t bufferSize,
+        size_t * pEncodedSize )
+{
+    uint32_t blocksLeft = ( uint32_t ) agentRequest.numBlocks;
+    size_t byteIndex;
+    uint8_t bitMask;
+
+    if( agentRequestValid == false )
+    {
+        return false;
+    }
+
+    memset( laneBitmap, 0x00, sizeof( laneBitmap ) );
+
+    for( byteIndex = 0U; ( byteIndex < agentRequest.bitmapSize ) && ( blocksLeft > 0U ); byteIndex++ )
+    {
+        for( bitMask = 1U; ( bitMask != 0U ) && ( blocksLeft > 0U ); bitMask = ( uint8_t ) ( bitMask << 1 ) )
+        {
+            if( ( ( agentRequest.bitmap[ byteIndex ] & bitMask ) != 0U ) &&
+                    ( ( outstandingBitmap[ byteIndex ] & bitMask ) == 0U ) )
+            {
+                laneBitmap[ byteIndex ] |= bitMask;
+                blocksLeft--;
+            }
+        }
+    }
+
+    if( ( blocksLeft == ( uint32_t ) agentRequest.numBlocks ) ||
+            ( OTA_CBOR_Encode_GetStreamRequestMessage( pBuffer, bufferSize, pEncodedSize,
+                    agentRequest.clientToken, agentRequest.fileId, agentRequest.blockSize,
+                    agentRequest.blockOffset, laneBitmap, agentRequest.bitmapSize,
+                    agentRequest.numBlocks ) == false ) )
+    {
+        return false;
+    }
+
+    if( outstandingBlocks == false )
+    {
+        outstandingBlocks = true;
+        outstandingTick = xTaskGetTickCount();
+    }
+
+    for( byteIndex = 0U; byteIndex < agentRequest.bitmapSize; byteIndex++ )
+    {
+        outstandingBitmap[ byteIndex ] |= laneBitmap[ byteIndex ];
+        roundBitmap[ byteIndex ] |= laneBitmap[ byteIndex ];
+    }
+
+    if( lane > 0U )
+    {
+        taskENTER_CRITICAL();
+        streamLanes.statistics.laneRequests++;
+        taskEXIT_CRITICAL();
+    }
+
+    return true;
+}
+#endif /* ( OTA_STREAM_LANES_MAX > 1U ) */
+
+/*******************************************************************************
+ * Function Name: OtaStreamLanes_GetAgentRequest()
+ *******************************************************************************
+ * Summary:
+ *  Returns the blocks asked for by the requests of the current round, in
+ *  chunks of numBlocks blocks per request. With a single lane these are the
+ *  blocks missing for the OTA agent. Must be called from the OTA agent task.
+ *
+ * Parameters:
+ *  pBitmap:        Receives the blocks asked for in the round.
+ *  bitmapSize:     Size of the bitmap buffer.
+ *  pNumBlocks:     Receives the number of blocks asked for per request.
+ *
+ * Return:
+ *  true on success, false if no request of the agent is known.
+ *
+ *******************************************************************************/
+bool OtaStreamLanes_GetAgentRequest( uint8_t * pBitmap,
+        size_t bitmapSize,
+        uint32_t * pNumBlocks )
+{
+    if( ( agentRequestValid == false ) || ( pBitmap == NULL ) || ( pNumBlocks == NULL ) )
+    {
+        return false;
+    }
+
+    memset( pBitmap, 0x00, bitmapSize );
+#if ( OTA_STREAM_LANES_MAX > 1U )
+    memcpy( pBitmap, roundBitmap,
+            ( sizeof( roundBitmap ) < bitmapSize ) ? sizeof( roundBitmap ) : bitmapSize );
+#else
+    memcpy( pBitmap, agentRequest.bitmap,
+            ( agentRequest.bitmapSize < bitmapSize ) ? agentRequest.bitmapSize : bitmapSize );
+#endif
+    *pNumBlocks = ( uint32_t ) agentRequest.numBlocks;
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: OtaStreamLanes_BuildBlockRequest()
+ *******************************************************************************
+ * Summary:
+ *  Encodes a stream request for the given blocks, with the client token,
+ *  file and block size of the last request of the OTA agent. Safe to call
+ *  from any task, the request is built from a snapshot of these fields.
+ *
+ * Parameters:
+ *  pBitmap:        Blocks to ask for, one bit per block.
+ *  numBlocks:      Number of blocks set in the bitmap.
+ *  pBuffer:        Buffer receiving the encoded request.
+ *  bufferSize:     Size of the buffer.
+ *  pEncodedSize:   Receives the size of the encoded request.
+ *
+ * Return:
+ *  true if a request was encoded, false otherwise.
+ *
+ *******************************************************************************/
+bool OtaStreamLanes_BuildBlockRequest( const uint8_t * pBitmap,
+        uint32_t numBlocks,
+        uint8_t * pBuffer,
+        size_t bufferSize,
+        size_t * pEncodedSize )
+{
+    OtaStreamRequestSnapshot_t request;
+
+    if( ( pBitmap == NULL ) || ( numBlocks == 0U ) )
+    {
+        return false;
+    }
+
+    taskENTER_CRITICAL();
+    request = requestSnapshot;
+    taskEXIT_CRITICAL();
+
+    if( request.valid == false )
+    {
+        return false;
+    }
+
+    return OTA_CBOR_Encode_GetStreamRequestMessage( pBuffer, bufferSize, pEncodedSize,
+            request.clientToken, request.fileId, request.blockSize,
+            request.blockOffset, pBitmap, request.bitmapSize, ( int32_t ) numBlocks );
+}
+
+/*******************************************************************************
+ * Function Name: OtaStreamLanes_OnBlockReceived()
+ *******************************************************************************
+ * Summary:
+ *  Counts a block received in the current round.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaStreamLanes_OnBlockReceived( void )
+{
+    taskENTER_CRITICAL();
+    streamLanes.blocksInRound++;
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaStreamLanes_OnDuplicateBlock()
+ *******************************************************************************
+ * Summary:
+ *  Counts a block of the current round that had been received before, which
+ *  does not count towards the throughput of the round.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaStreamLanes_OnDuplicateBlock( void )
+{
+    taskENTER_CRITICAL();
+    streamLanes.duplicatesInRound++;
+    streamLanes.statistics.duplicateBlocks++;
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaStreamLanes_OnBlockDropped()
+ *******************************************************************************
+ * Summary:
+ *  Counts a block dropped on the receive path in the current round.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaStreamLanes_OnBlockDropped( void )
+{
+    taskENTER_CRITICAL();
+    streamLanes.dropsInRound++;
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaStreamLanes_GetStatistics()
+ *******************************************************************************
+ * Summary:
+ *  Returns a snapshot of the lane statistics of the current job.
+ *
+ * Parameters:
+ *  pStatistics: Pointer to the structure receiving the statistics.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaStreamLanes_GetStatistics( OtaStreamLanesStatistics_t * pStatistics )
+{
+    if( pStatistics != NULL )
+    {
+        taskENTER_CRITICAL();
+        *pStatistics = streamLanes.statistics;
+        taskEXIT_CRITICAL();
+    }
+}
+
+/* [] END OF FILE */
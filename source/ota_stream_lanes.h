@@ -0,0 +1,124 @@
+/********************************************************************************
+ * File Name: ota_stream_lanes.h
+ *
+ * Description: Defines the API of the stream lanes, which keep several block
+ * requests in flight on the MQTT connection.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef OTA_STREAM_LANES_H_
+#define OTA_STREAM_LANES_H_
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* OTA Library include. */
+#include "ota.h"
+
+
+/* Largest number of stream requests kept in flight at once. Each stream
+ * request of the OTA agent is followed by up to OTA_STREAM_LANES_MAX - 1
+ * requests for the blocks after it, so the service always has queued work.
+ * All lanes share the one MQTT connection: the requests are pipelined, the
+ * blocks still arrive through a single TCP window. 1 disables the lanes and
+ * the stream requests of the agent are published untouched. */
+#ifndef OTA_STREAM_LANES_MAX
+#define OTA_STREAM_LANES_MAX            (1U)
+#endif
+
+/* Throughput gain, in percent, an added lane must bring to be kept. */
+#ifndef OTA_STREAM_LANES_GAIN_PERCENT
+#define OTA_STREAM_LANES_GAIN_PERCENT   (10U)
+#endif
+
+/* Requests to wait after the lane count was shrunk before probing again. */
+#ifndef OTA_STREAM_LANES_HOLD_ROUNDS
+#define OTA_STREAM_LANES_HOLD_ROUNDS    (8U)
+#endif
+
+/* Size of an encoded stream request. */
+#define OTA_STREAM_LANES_REQUEST_SIZE   ( OTA_MAX_BLOCK_BITMAP_SIZE + 64U )
+
+/* Statistics of the stream lanes of the current job. */
+typedef struct OtaStreamLanesStatistics
+{
+    uint32_t lanes;                 /* Requests kept in flight. */
+    uint32_t rounds;                /* Stream requests of the OTA agent. */
+    uint32_t laneRequests;          /* Extra requests sent. */
+    uint32_t laneIncreases;         /* Times a lane was added. */
+    uint32_t laneDecreases;         /* Times a lane was removed. */
+    uint32_t duplicateBlocks;       /* Blocks received more than once. */
+    uint32_t outstandingExpired;    /* Times blocks in flight were asked for again. */
+    uint32_t requestsSkipped;       /* Agent requests not sent, all blocks were in flight. */
+    uint32_t blocksPerSecond;       /* Throughput of the last round. */
+} OtaStreamLanesStatistics_t;
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+void OtaStreamLanes_Reset( void );
+
+uint32_t OtaStreamLanes_OnBlockRequest( const uint8_t * pRequest,
+        size_t requestSize );
+
+#if ( OTA_STREAM_LANES_MAX > 1U )
+bool OtaStreamLanes_BuildRequest( uint32_t lane,
+        uint8_t * pBuffer,
+        size_t bufferSize,
+        size_t * pEncodedSize );
+#endif
+
+bool OtaStreamLanes_GetAgentRequest( uint8_t * pBitmap,
+        size_t bitmapSize,
+        uint32_t * pNumBlocks );
+
+bool OtaStreamLanes_BuildBlockRequest( const uint8_t * pBitmap,
+        uint32_t numBlocks,
+        uint8_t * pBuffer,
+        size_t bufferSize,
+        size_t * pEncodedSize );
+
+void OtaStreamLanes_OnBlockReceived( void );
+
+void OtaStreamLanes_OnDuplicateBlock( void );
+
+void OtaStreamLanes_OnBlockDropped( void );
+
+void OtaStreamLanes_GetStatistics( OtaStreamLanesStatistics_t * pStatistics );
+
+
+#endif /* ifndef OTA_STREAM_LANES_H_ */
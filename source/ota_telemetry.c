@@ -0,0 +1,574 @@
+/********************************************************************************
+ * File Name: ota_telemetry.c
+ *
+ * Description: Implementation of the OTA performance telemetry. Measures the
+ * latency of every file block through the OTA agent and reports the job
+ * statistics as a compact JSON document.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* Device and RTOS includes. */
+#include "cyhal.h"
+#include <FreeRTOS.h>
+#include <task.h>
+
+/* Include header for the OTA event buffer pool. */
+#include "ota_buffer_pool.h"
+
+/* Include header for the OTA telemetry. */
+#include "ota_telemetry.h"
+
+/* Number of latency histogram buckets. Latencies below 4 us have a bucket of
+ * their own, above that every octave is split into four buckets, which covers
+ * the whole 32-bit range of microseconds. */
+#define OTA_TELEMETRY_LATENCY_BUCKETS       ( 124U )
+
+/* Per-job telemetry counters. */
+typedef struct OtaTelemetryJob
+{
+    uint32_t latencyHistogram[ OTA_TELEMETRY_LATENCY_BUCKETS ];
+    uint32_t latencySamples;
+    uint32_t latencyMaxUs;
+    uint32_t reconnects;
+    bool firstBlockSeen;
+    TickType_t firstBlockTick;
+    TickType_t lastBlockTick;
+    uint32_t blocksReceived;
+    uint32_t bytesReceived;
+    bool disconnectPending;
+    TickType_t disconnectTick;
+    uint32_t recoveries;
+    uint32_t lastRecoveryMs;
+    uint32_t maxRecoveryMs;
+} OtaTelemetryJob_t;
+
+/* Counters of the current job. */
+static OtaTelemetryJob_t currentJob;
+
+/* Cycle count at which each pool buffer was handed to the OTA agent. A buffer
+ * is owned by a single task at any time, so the entries need no locking. */
+static uint32_t queuedCycles[ otaconfigMAX_NUM_OTA_DATA_BUFFERS ];
+
+/* Set while the buffer carries a file block that is being measured. */
+static bool queuedStamped[ otaconfigMAX_NUM_OTA_DATA_BUFFERS ];
+
+
+/*******************************************************************************
+ * Function Name: cyclesToUs()
+ *******************************************************************************
+ * Summary:
+ *  Converts a number of CPU cycles into microseconds.
+ *
+ * Parameters:
+ *  cycles: Number of CPU cycles.
+ *
+ * Return:
+ *  The duration in microseconds.
+ *
+ *******************************************************************************/
+static uint32_t cyclesToUs( uint32_t cycles )
+{
+    uint32_t cyclesPerUs = SystemCoreClock / 1000000UL;
+
+    return ( cyclesPerUs == 0U ) ? 0U : ( cycles / cyclesPerUs );
+}
+
+/*******************************************************************************
+ * Function Name: latencyBucket()
+ *******************************************************************************
+ * Summary:
+ *  Maps a latency to its histogram bucket.
+ *
+ * Parameters:
+ *  latencyUs: Latency in microseconds.
+ *
+ * Return:
+ *  Index of the histogram bucket.
+ *
+ *******************************************************************************/
+static uint32_t latencyBucket( uint32_t latencyUs )
+{
+    uint32_t msb = 2U;
+
+    if( latencyUs < 4U )
+    {
+        return latencyUs;
+    }
+
+    while( ( latencyUs >> ( msb + 1U ) ) != 0U )
+    {
+        msb++;
+    }
+
+    /* The two bits below the most significant one select the quarter. */
+    return ( ( msb - 1U ) * 4U ) + ( ( latencyUs >> ( msb - 2U ) ) & 0x3U );
+}
+
+/*******************************************************************************
+ * Function Name: latencyBucketLimit()
+ *******************************************************************************
+ * Summary:
+ *  Returns the largest latency falling into a histogram bucket.
+ *
+ * Parameters:
+ *  bucket: Index of the histogram bucket.
+ *
+ * Return:
+ *  Upper bound of the bucket in microseconds.
+ *
+ *******************************************************************************/
+static uint32_t latencyBucketLimit( uint32_t bucket )
+{
+    uint32_t shift;
+
+    if( bucket < 4U )
+    {
+        return bucket;
+    }
+
+    shift = ( bucket / 4U ) - 1U;
+
+    return ( ( ( 4U + ( bucket % 4U ) ) << shift ) - 1U ) + ( 1U << shift );
+}
+
+/*******************************************************************************
+ * Function Name: latencyPercentile()
+ *******************************************************************************
+ * Summary:
+ *  Finds a percentile in a snapshot of the latency histogram.
+ *
+ * Parameters:
+ *  pJob:       Snapshot of the job counters.
+ *  percent:    Percentile to find, 1 to 100.
+ *
+ * Return:
+ *  The percentile in microseconds, 0 if no latency was measured.
+ *
+ *******************************************************************************/
+static uint32_t latencyPercentile( const OtaTelemetryJob_t * pJob,
+        uint32_t percent )
+{
+    uint32_t rank;
+    uint32_t count = 0U;
+    uint32_t bucket;
+    uint32_t limit = 0U;
+
+    if( pJob->latencySamples == 0U )
+    {
+        return 0U;
+    }
+
+    /* Nearest rank, i.e. the smallest sample that is not exceeded by the
+     * given percentage of all samples. */
+    rank = ( uint32_t ) ( ( ( ( uint64_t ) pJob->latencySamples * percent ) + 99U ) / 100U );
+
+    for( bucket = 0U; bucket < OTA_TELEMETRY_LATENCY_BUCKETS; bucket++ )
+    {
+        count += pJob->latencyHistogram[ bucket ];
+        if( count >= rank )
+        {
+            limit = latencyBucketLimit( bucket );
+            break;
+        }
+    }
+
+    return ( limit < pJob->latencyMaxUs ) ? limit : pJob->latencyMaxUs;
+}
+
+/*******************************************************************************
+ * Function Name: OtaTelemetry_Init()
+ *******************************************************************************
+ * Summary:
+ *  Starts the DWT cycle counter used to time the file blocks and clears the
+ *  job counters.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaTelemetry_Init( void )
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0U;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    OtaTelemetry_Reset();
+}
+
+/*******************************************************************************
+ * Function Name: OtaTelemetry_Reset()
+ *******************************************************************************
+ * Summary:
+ *  Clears the counters of the current job.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaTelemetry_Reset( void )
+{
+    taskENTER_CRITICAL();
+    memset( &currentJob, 0x00, sizeof( currentJob ) );
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaTelemetry_RecordBlockQueued()
+ *******************************************************************************
+ * Summary:
+ *  Stamps a file block right before it is handed to the OTA agent. Must be
+ *  called before the event is signalled, as the agent may process it at once.
+ *
+ * Parameters:
+ *  pBuffer: Event buffer holding the file block.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaTelemetry_RecordBlockQueued( const OtaEventData_t * pBuffer )
+{
+    int32_t index = OtaBufferPool_GetIndex( pBuffer );
+
+    if( index >= 0 )
+    {
+        queuedCycles[ index ] = DWT->CYCCNT;
+        queuedStamped[ index ] = true;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: OtaTelemetry_RecordBlockReclaimed()
+ *******************************************************************************
+ * Summary:
+ *  Discards the stamp of a file block that could not be handed to the OTA
+ *  agent after all.
+ *
+ * Parameters:
+ *  pBuffer: Event buffer holding the file block.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaTelemetry_RecordBlockReclaimed( const OtaEventData_t * pBuffer )
+{
+    int32_t index = OtaBufferPool_GetIndex( pBuffer );
+
+    if( index >= 0 )
+    {
+        queuedStamped[ index ] = false;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: OtaTelemetry_RecordBlockProcessed()
+ *******************************************************************************
+ * Summary:
+ *  Adds the latency of a file block to the histogram once the OTA agent hands
+ *  its buffer back. Buffers that did not carry a stamped file block, such as
+ *  job documents, are ignored. The cycle counter wraps after some tens of
+ *  seconds, far above any sane block latency.
+ *
+ * Parameters:
+ *  pBuffer: Event buffer returned by the OTA agent.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaTelemetry_RecordBlockProcessed( const OtaEventData_t * pBuffer )
+{
+    int32_t index = OtaBufferPool_GetIndex( pBuffer );
+    uint32_t latencyUs;
+
+    if( ( index < 0 ) || ( queuedStamped[ index ] == false ) )
+    {
+        return;
+    }
+
+    queuedStamped[ index ] = false;
+    latencyUs = cyclesToUs( DWT->CYCCNT - queuedCycles[ index ] );
+
+    taskENTER_CRITICAL();
+    currentJob.latencyHistogram[ latencyBucket( latencyUs ) ]++;
+    currentJob.latencySamples++;
+    if( latencyUs > currentJob.latencyMaxUs )
+    {
+        currentJob.latencyMaxUs = latencyUs;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaTelemetry_RecordBlockReceived()
+ *******************************************************************************
+ * Summary:
+ *  Accounts a file block handed from the MQTT receive path to the OTA agent.
+ *  The first block of a job starts the download timer, the first block after
+ *  a disconnect closes the recovery interval.
+ *
+ * Parameters:
+ *  payloadLength:  Size of the received block message.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaTelemetry_RecordBlockReceived( uint32_t payloadLength )
+{
+    TickType_t now = xTaskGetTickCount();
+    uint32_t recoveryMs;
+
+    taskENTER_CRITICAL();
+    if( currentJob.firstBlockSeen == false )
+    {
+        currentJob.firstBlockSeen = true;
+        currentJob.firstBlockTick = now;
+    }
+
+    if( currentJob.disconnectPending == true )
+    {
+        recoveryMs = ( uint32_t ) ( now - currentJob.disconnectTick ) * portTICK_PERIOD_MS;
+        currentJob.disconnectPending = false;
+        currentJob.recoveries++;
+        currentJob.lastRecoveryMs = recoveryMs;
+        if( recoveryMs > currentJob.maxRecoveryMs )
+        {
+            currentJob.maxRecoveryMs = recoveryMs;
+        }
+    }
+
+    currentJob.lastBlockTick = now;
+    currentJob.blocksReceived++;
+    currentJob.bytesReceived += payloadLength;
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaTelemetry_RecordDisconnect()
+ *******************************************************************************
+ * Summary:
+ *  Marks the loss of the MQTT connection. The next received block closes the
+ *  interval and accounts the time from disconnect to resumed block flow.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaTelemetry_RecordDisconnect( void )
+{
+    TickType_t now = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+    if( ( currentJob.firstBlockSeen == true ) && ( currentJob.disconnectPending == false ) )
+    {
+        currentJob.disconnectPending = true;
+        currentJob.disconnectTick = now;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaTelemetry_RecordReconnect()
+ *******************************************************************************
+ * Summary:
+ *  Counts an MQTT reconnect during the current job.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaTelemetry_RecordReconnect( void )
+{
+    taskENTER_CRITICAL();
+    currentJob.reconnects++;
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaTelemetry_GetLatency()
+ *******************************************************************************
+ * Summary:
+ *  Returns the block latency percentiles of the current job.
+ *
+ * Parameters:
+ *  pLatency: Pointer to the structure receiving the percentiles.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaTelemetry_GetLatency( OtaTelemetryLatency_t * pLatency )
+{
+    if( pLatency == NULL )
+    {
+        return;
+    }
+
+    /* A few hundred additions, cheaper than copying the histogram. */
+    taskENTER_CRITICAL();
+    pLatency->samples = currentJob.latencySamples;
+    pLatency->p50Us = latencyPercentile( &currentJob, 50U );
+    pLatency->p90Us = latencyPercentile( &currentJob, 90U );
+    pLatency->p99Us = latencyPercentile( &currentJob, 99U );
+    pLatency->maxUs = currentJob.latencyMaxUs;
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: OtaTelemetry_GetThroughput()
+ *******************************************************************************
+ * Summary:
+ *  Returns the throughput of the current job and the time it took to resume
+ *  the block flow after disconnects.
+ *
+ * Parameters:
+ *  pThroughput: Pointer to the structure receiving the throughput.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void OtaTelemetry_GetThroughput( OtaTelemetryThroughput_t * pThroughput )
+{
+    if( pThroughput == NULL )
+    {
+        return;
+    }
+
+    memset( pThroughput, 0x00, sizeof( OtaTelemetryThroughput_t ) );
+
+    taskENTER_CRITICAL();
+    pThroughput->blocksReceived = currentJob.blocksReceived;
+    pThroughput->bytesReceived = currentJob.bytesReceived;
+    pThroughput->downloadTimeMs = ( uint32_t ) ( currentJob.lastBlockTick - currentJob.firstBlockTick ) *
+            portTICK_PERIOD_MS;
+    pThroughput->recoveries = currentJob.recoveries;
+    pThroughput->lastRecoveryMs = currentJob.lastRecoveryMs;
+    pThroughput->maxRecoveryMs = currentJob.maxRecoveryMs;
+    taskEXIT_CRITICAL();
+
+    if( pThroughput->downloadTimeMs != 0U )
+    {
+        pThroughput->blocksPerSecond = ( uint32_t ) ( ( ( uint64_t ) pThroughput->blocksReceived * 1000U ) /
+                pThroughput->downloadTimeMs );
+        pThroughput->bytesPerSecond = ( uint32_t ) ( ( ( uint64_t ) pThroughput->bytesReceived * 1000U ) /
+                pThroughput->downloadTimeMs );
+    }
+}
+
+/*******************************************************************************
+ * Function Name: OtaTelemetry_BuildDocument()
+ *******************************************************************************
+ * Summary:
+ *  Formats the statistics of the current job as a compact JSON document:
+ *  the packet counters of the OTA agent, the effective throughput, the block
+ *  latency percentiles, the buffer pool high-water mark and the number of
+ *  reconnects.
+ *
+ * Parameters:
+ *  pBuffer:    Buffer receiving the document.
+ *  bufferSize: Size of the buffer in bytes.
+ *  final:      true for the summary sent at the end of the job.
+ *
+ * Return:
+ *  Length of the document, 0 if it does not fit into the buffer.
+ *
+ *******************************************************************************/
+size_t OtaTelemetry_BuildDocument( char * pBuffer,
+        size_t bufferSize,
+        bool final )
+{
+    OtaAgentStatistics_t agentStatistics = { 0 };
+    OtaTelemetryThroughput_t throughput = { 0 };
+    OtaBufferPoolStatistics_t poolStatistics = { 0 };
+    OtaTelemetryLatency_t latency = { 0 };
+    int length;
+
+    if( ( pBuffer == NULL ) || ( bufferSize == 0U ) )
+    {
+        return 0U;
+    }
+
+    ( void ) OTA_GetStatistics( &agentStatistics );
+    OtaTelemetry_GetThroughput( &throughput );
+    OtaBufferPool_GetStatistics( &poolStatistics );
+    OtaTelemetry_GetLatency( &latency );
+
+    length = snprintf( pBuffer, bufferSize,
+            "{\"final\":%s,\"rx\":%u,\"queued\":%u,\"processed\":%u,\"dropped\":%u,"
+            "\"bytesPerSec\":%u,\"blocksPerSec\":%u,"
+            "\"latencyUs\":{\"n\":%u,\"p50\":%u,\"p90\":%u,\"p99\":%u,\"max\":%u},"
+            "\"poolHwm\":%u,\"reconnects\":%u}",
+            final ? "true" : "false",
+            (unsigned int)agentStatistics.otaPacketsReceived,
+            (unsigned int)agentStatistics.otaPacketsQueued,
+            (unsigned int)agentStatistics.otaPacketsProcessed,
+            (unsigned int)agentStatistics.otaPacketsDropped,
+            (unsigned int)throughput.bytesPerSecond,
+            (unsigned int)throughput.blocksPerSecond,
+            (unsigned int)latency.samples,
+            (unsigned int)latency.p50Us,
+            (unsigned int)latency.p90Us,
+            (unsigned int)latency.p99Us,
+            (unsigned int)latency.maxUs,
+            (unsigned int)poolStatistics.highWaterMark,
+            (unsigned int)currentJob.reconnects );
+
+    if( ( length < 0 ) || ( ( size_t ) length >= bufferSize ) )
+    {
+        return 0U;
+    }
+
+    return ( size_t ) length;
+}
+
+/* [] END OF FILE */
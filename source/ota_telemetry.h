@@ -0,0 +1,107 @@
+/********************************************************************************
+ * File Name: ota_telemetry.h
+ *
+ * Description: The API of the OTA performance telemetry, which condenses the
+ * statistics of the current OTA job into a compact JSON document.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef OTA_TELEMETRY_H_
+#define OTA_TELEMETRY_H_
+
+/* Standard includes. */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* OTA Library include. */
+#include "ota.h"
+
+
+/* Percentiles of the time from handing a file block to the OTA agent until
+ * the agent returns its buffer, in microseconds. The values are resolved to
+ * a quarter octave, i.e. they are at most 25 % above the exact figure. */
+typedef struct OtaTelemetryLatency
+{
+    uint32_t samples;               /* Number of blocks measured. */
+    uint32_t p50Us;                 /* Median block latency. */
+    uint32_t p90Us;                 /* 90th percentile block latency. */
+    uint32_t p99Us;                 /* 99th percentile block latency. */
+    uint32_t maxUs;                 /* Largest block latency. */
+} OtaTelemetryLatency_t;
+
+/* Throughput of the current (or last) job, measured from the first to the
+ * last file block handed to the OTA agent. */
+typedef struct OtaTelemetryThroughput
+{
+    uint32_t blocksReceived;        /* File blocks handed to the OTA agent. */
+    uint32_t bytesReceived;         /* Size of the received block messages. */
+    uint32_t downloadTimeMs;        /* Time from the first to the last block. */
+    uint32_t blocksPerSecond;       /* Average block rate over the download time. */
+    uint32_t bytesPerSecond;        /* Average byte rate over the download time. */
+    uint32_t recoveries;            /* Disconnects followed by resumed block flow. */
+    uint32_t lastRecoveryMs;        /* Time from the last disconnect to the next block. */
+    uint32_t maxRecoveryMs;         /* Longest time from a disconnect to the next block. */
+} OtaTelemetryThroughput_t;
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+void OtaTelemetry_Init( void );
+
+void OtaTelemetry_Reset( void );
+
+void OtaTelemetry_RecordBlockQueued( const OtaEventData_t * pBuffer );
+
+void OtaTelemetry_RecordBlockReclaimed( const OtaEventData_t * pBuffer );
+
+void OtaTelemetry_RecordBlockProcessed( const OtaEventData_t * pBuffer );
+
+void OtaTelemetry_RecordBlockReceived( uint32_t payloadLength );
+
+void OtaTelemetry_RecordDisconnect( void );
+
+void OtaTelemetry_RecordReconnect( void );
+
+void OtaTelemetry_GetLatency( OtaTelemetryLatency_t * pLatency );
+
+void OtaTelemetry_GetThroughput( OtaTelemetryThroughput_t * pThroughput );
+
+size_t OtaTelemetry_BuildDocument( char * pBuffer,
+        size_t bufferSize,
+        bool final );
+
+
+#endif /* ifndef OTA_TELEMETRY_H_ */
@@ -0,0 +1,189 @@
+/********************************************************************************
+ * File Name: retry_backoff.c
+ *
+ * Description: Implementation of a capped exponential retry backoff with full
+ * jitter, used to spread reconnect attempts across a fleet of devices.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <stddef.h>
+
+/* Include header for the retry backoff. */
+#include "retry_backoff.h"
+
+/* Non-zero seed used when the supplied seed is zero. */
+#define RETRY_BACKOFF_DEFAULT_SEED      ( 0x9E3779B9UL )
+
+/* FNV-1a hash parameters. */
+#define FNV_OFFSET_BASIS                ( 0x811C9DC5UL )
+#define FNV_PRIME                       ( 0x01000193UL )
+
+
+/*******************************************************************************
+ * Function Name: nextRandom()
+ *******************************************************************************
+ * Summary:
+ *  Advances the xorshift32 generator of a backoff.
+ *
+ * Parameters:
+ *  pBackoff: Backoff state.
+ *
+ * Return:
+ *  The next pseudo random number.
+ *
+ *******************************************************************************/
+static uint32_t nextRandom( RetryBackoff_t * pBackoff )
+{
+    uint32_t x = pBackoff->randomState;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pBackoff->randomState = x;
+
+    return x;
+}
+
+/*******************************************************************************
+ * Function Name: RetryBackoff_Init()
+ *******************************************************************************
+ * Summary:
+ *  Initializes a backoff. The seed should differ between devices so that
+ *  devices losing connectivity together do not retry in lockstep.
+ *
+ * Parameters:
+ *  pBackoff:       Backoff state to initialize.
+ *  baseDelayMs:    Upper bound of the first delay.
+ *  maxDelayMs:     Cap of the delay upper bound.
+ *  seed:           Seed of the jitter generator.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void RetryBackoff_Init( RetryBackoff_t * pBackoff,
+        uint32_t baseDelayMs,
+        uint32_t maxDelayMs,
+        uint32_t seed )
+{
+    pBackoff->baseDelayMs = baseDelayMs;
+    pBackoff->maxDelayMs = ( maxDelayMs < baseDelayMs ) ? baseDelayMs : maxDelayMs;
+    pBackoff->attempts = 0U;
+    pBackoff->randomState = ( seed != 0U ) ? seed : RETRY_BACKOFF_DEFAULT_SEED;
+}
+
+/*******************************************************************************
+ * Function Name: RetryBackoff_Reset()
+ *******************************************************************************
+ * Summary:
+ *  Restarts the backoff from the base delay, e.g. after a successful attempt.
+ *
+ * Parameters:
+ *  pBackoff: Backoff state.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void RetryBackoff_Reset( RetryBackoff_t * pBackoff )
+{
+    pBackoff->attempts = 0U;
+}
+
+/*******************************************************************************
+ * Function Name: RetryBackoff_NextDelayMs()
+ *******************************************************************************
+ * Summary:
+ *  Returns the delay before the next attempt, drawn uniformly from zero to
+ *  min( maxDelayMs, baseDelayMs * 2^attempts ) ("full jitter").
+ *
+ * Parameters:
+ *  pBackoff: Backoff state.
+ *
+ * Return:
+ *  The delay in milliseconds.
+ *
+ *******************************************************************************/
+uint32_t RetryBackoff_NextDelayMs( RetryBackoff_t * pBackoff )
+{
+    uint32_t ceilingMs = pBackoff->baseDelayMs;
+    uint32_t doublings = pBackoff->attempts;
+
+    while( ( doublings > 0U ) && ( ceilingMs < pBackoff->maxDelayMs ) )
+    {
+        ceilingMs = ( ceilingMs > ( pBackoff->maxDelayMs / 2U ) ) ? pBackoff->maxDelayMs : ( ceilingMs * 2U );
+        doublings--;
+    }
+
+    if( pBackoff->attempts < UINT32_MAX )
+    {
+        pBackoff->attempts++;
+    }
+
+    return ( ceilingMs == UINT32_MAX ) ? nextRandom( pBackoff ) :
+            ( nextRandom( pBackoff ) % ( ceilingMs + 1U ) );
+}
+
+/*******************************************************************************
+ * Function Name: RetryBackoff_SeedFromString()
+ *******************************************************************************
+ * Summary:
+ *  Derives a jitter seed from a device unique string, such as the MQTT client
+ *  identifier, mixed with a runtime entropy value.
+ *
+ * Parameters:
+ *  pString:    NULL terminated device unique string.
+ *  entropy:    Runtime value mixed into the seed, e.g. a cycle counter.
+ *
+ * Return:
+ *  The seed.
+ *
+ *******************************************************************************/
+uint32_t RetryBackoff_SeedFromString( const char * pString,
+        uint32_t entropy )
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+
+    while( ( pString != NULL ) && ( *pString != '\0' ) )
+    {
+        hash ^= ( uint8_t ) *pString;
+        hash *= FNV_PRIME;
+        pString++;
+    }
+
+    return hash ^ entropy;
+}
+
+/* [] END OF FILE */
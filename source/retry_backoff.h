@@ -0,0 +1,72 @@
+/********************************************************************************
+ * File Name: retry_backoff.h
+ *
+ * Description: The API of a capped exponential retry backoff with full jitter.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef RETRY_BACKOFF_H_
+#define RETRY_BACKOFF_H_
+
+/* Standard includes. */
+#include <stdint.h>
+
+
+/* State of a capped exponential backoff with full jitter. */
+typedef struct RetryBackoff
+{
+    uint32_t baseDelayMs;       /* Upper bound of the first delay. */
+    uint32_t maxDelayMs;        /* Cap of the delay upper bound. */
+    uint32_t attempts;          /* Delays handed out since the last reset. */
+    uint32_t randomState;       /* xorshift32 state, never zero. */
+} RetryBackoff_t;
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+void RetryBackoff_Init( RetryBackoff_t * pBackoff,
+        uint32_t baseDelayMs,
+        uint32_t maxDelayMs,
+        uint32_t seed );
+
+void RetryBackoff_Reset( RetryBackoff_t * pBackoff );
+
+uint32_t RetryBackoff_NextDelayMs( RetryBackoff_t * pBackoff );
+
+uint32_t RetryBackoff_SeedFromString( const char * pString,
+        uint32_t entropy );
+
+
+#endif /* ifndef RETRY_BACKOFF_H_ */
@@ -0,0 +1,234 @@
+/********************************************************************************
+ * File Name: wifi_ap_cache.c
+ *
+ * Description: Implementation of the cache of the Wi-Fi access point
+ * last joined. The access point is kept as a single record in an erase sector
+ * of external flash.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Include header for the Wi-Fi access point cache. */
+#include "wifi_ap_cache.h"
+
+#if ( WIFI_AP_CACHE_ENABLE == 1 )
+
+/* Serial flash include. */
+#include "cy_serial_flash_qspi.h"
+
+/* Marks an access point cache record ("WAPC"). */
+#define WIFI_AP_CACHE_MAGIC                 ( 0x57415043UL )
+
+/* An access point cache record as stored in flash. */
+typedef struct WifiApCacheRecord
+{
+    uint32_t magic;
+    WifiApCacheEntry_t entry;
+    uint32_t crc;
+} WifiApCacheRecord_t;
+
+/* Location of the cache, found by WifiApCache_Init(). */
+static uint32_t cacheAddress = 0U;
+static uint32_t sectorSize = 0U;
+
+/* Record in flash, kept in RAM. */
+static WifiApCacheRecord_t cachedRecord;
+static bool cachedValid = false;
+
+
+/*******************************************************************************
+ * Function Name: crc32()
+ *******************************************************************************
+ * Summary:
+ *  Computes the CRC-32 (IEEE 802.3) of a buffer.
+ *
+ * Parameters:
+ *  pData:  Data to checksum.
+ *  length: Number of bytes.
+ *
+ * Return:
+ *  The CRC-32 of the data.
+ *
+ *******************************************************************************/
+static uint32_t crc32( const uint8_t * pData,
+        size_t length )
+{
+    uint32_t crc = 0xFFFFFFFFUL;
+    uint8_t bit;
+
+    while( length-- > 0U )
+    {
+        crc ^= *pData++;
+        for( bit = 0U; bit < 8U; bit++ )
+        {
+            crc = ( crc >> 1 ) ^ ( 0xEDB88320UL & ( 0U - ( crc & 1U ) ) );
+        }
+    }
+
+    return ~crc;
+}
+
+/*******************************************************************************
+ * Function Name: WifiApCache_Init()
+ *******************************************************************************
+ * Summary:
+ *  Locates the cache sector and reads the cached access point. The serial
+ *  flash must be initialized.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  true on success, false if the cache sector cannot be used.
+ *
+ *******************************************************************************/
+bool WifiApCache_Init( void )
+{
+    sectorSize = ( uint32_t ) cy_serial_flash_qspi_get_erase_size( WIFI_AP_CACHE_FLASH_ADDRESS );
+    if( sectorSize != 0U )
+    {
+        cacheAddress = ( ( ( WIFI_AP_CACHE_FLASH_ADDRESS + sectorSize - 1U ) / sectorSize ) +
+                WIFI_AP_CACHE_FLASH_SECTOR ) * sectorSize;
+    }
+
+    if( ( sectorSize < sizeof( WifiApCacheRecord_t ) ) ||
+            ( ( cacheAddress + sectorSize ) > ( uint32_t ) cy_serial_flash_qspi_get_size() ) )
+    {
+        printf("Wi-Fi AP cache at 0x%08X is not usable.\n",
+                (unsigned int)WIFI_AP_CACHE_FLASH_ADDRESS);
+        sectorSize = 0U;
+        return false;
+    }
+
+    cachedValid = false;
+
+    if( cy_serial_flash_qspi_read( cacheAddress, sizeof( cachedRecord ),
+            ( uint8_t * ) &cachedRecord ) != CY_RSLT_SUCCESS )
+    {
+        return false;
+    }
+
+    /* An erased sector or a torn record leaves the cache empty. */
+    cachedValid = ( cachedRecord.magic == WIFI_AP_CACHE_MAGIC ) &&
+            ( cachedRecord.crc == crc32( ( const uint8_t * ) &cachedRecord,
+                    offsetof( WifiApCacheRecord_t, crc ) ) );
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: WifiApCache_Load()
+ *******************************************************************************
+ * Summary:
+ *  Returns the cached access point if it was joined with the given SSID.
+ *
+ * Parameters:
+ *  pSsid:  SSID to be joined.
+ *  pEntry: Receives the cached access point.
+ *
+ * Return:
+ *  true if an access point of this SSID is cached, false otherwise.
+ *
+ *******************************************************************************/
+bool WifiApCache_Load( const char * pSsid,
+        WifiApCacheEntry_t * pEntry )
+{
+    if( ( cachedValid == false ) || ( pSsid == NULL ) || ( pEntry == NULL ) ||
+            ( strncmp( cachedRecord.entry.ssid, pSsid, sizeof( cachedRecord.entry.ssid ) ) != 0 ) )
+    {
+        return false;
+    }
+
+    *pEntry = cachedRecord.entry;
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: WifiApCache_Save()
+ *******************************************************************************
+ * Summary:
+ *  Stores the access point just joined. The sector is only rewritten when the
+ *  access point differs from the cached one, so joining the same access point
+ *  on every boot does not wear the flash.
+ *
+ * Parameters:
+ *  pEntry: Access point joined.
+ *
+ * Return:
+ *  true if the access point is cached, false otherwise.
+ *
+ *******************************************************************************/
+bool WifiApCache_Save( const WifiApCacheEntry_t * pEntry )
+{
+    static WifiApCacheRecord_t record;
+
+    if( ( sectorSize == 0U ) || ( pEntry == NULL ) )
+    {
+        return false;
+    }
+
+    memset( &record, 0x00, sizeof( record ) );
+    record.magic = WIFI_AP_CACHE_MAGIC;
+    record.entry = *pEntry;
+    record.entry.ssid[ WIFI_AP_CACHE_MAX_SSID_LENGTH ] = '\0';
+    record.crc = crc32( ( const uint8_t * ) &record, offsetof( WifiApCacheRecord_t, crc ) );
+
+    if( ( cachedValid == true ) && ( memcmp( &record, &cachedRecord, sizeof( record ) ) == 0 ) )
+    {
+        return true;
+    }
+
+    cachedValid = false;
+
+    if( ( cy_serial_flash_qspi_erase( cacheAddress, sectorSize ) != CY_RSLT_SUCCESS ) ||
+            ( cy_serial_flash_qspi_write( cacheAddress, sizeof( record ),
+                    ( const uint8_t * ) &record ) != CY_RSLT_SUCCESS ) )
+    {
+        return false;
+    }
+
+    cachedRecord = record;
+    cachedValid = true;
+
+    return true;
+}
+
+#endif /* ( WIFI_AP_CACHE_ENABLE == 1 ) */
+
+/* [] END OF FILE */
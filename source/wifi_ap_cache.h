@@ -0,0 +1,97 @@
+/********************************************************************************
+ * File Name: wifi_ap_cache.h
+ *
+ * Description: Interface of the cache of the Wi-Fi access point last
+ * joined, kept in external flash across resets.
+ *
+ ********************************************************************************
+ * Copyright 2022, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef WIFI_AP_CACHE_H_
+#define WIFI_AP_CACHE_H_
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* OTA download checkpoint include, for the default location of the cache. */
+#include "ota_checkpoint.h"
+
+
+/* Set to 1 to keep the access point last joined in flash, so that the next
+ * boot joins it directly instead of scanning all channels for the SSID.
+ * Requires a free erase sector in external flash. */
+#ifndef WIFI_AP_CACHE_ENABLE
+#ifdef CY_BOOT_USE_EXTERNAL_FLASH
+#define WIFI_AP_CACHE_ENABLE                (1U)
+#else
+#define WIFI_AP_CACHE_ENABLE                (0U)
+#endif
+#endif
+
+/* The cache takes the erase sector WIFI_AP_CACHE_FLASH_SECTOR sectors after
+ * WIFI_AP_CACHE_FLASH_ADDRESS, rounded up to an erase sector. By default
+ * this is the sector following the two sectors of the OTA checkpoint area. */
+#ifndef WIFI_AP_CACHE_FLASH_ADDRESS
+#define WIFI_AP_CACHE_FLASH_ADDRESS         ( OTA_CHECKPOINT_FLASH_ADDRESS )
+#endif
+
+#ifndef WIFI_AP_CACHE_FLASH_SECTOR
+#define WIFI_AP_CACHE_FLASH_SECTOR          (2U)
+#endif
+
+/* Maximum length of an SSID. */
+#define WIFI_AP_CACHE_MAX_SSID_LENGTH       (32U)
+
+/* Parameters of the access point last joined. */
+typedef struct WifiApCacheEntry
+{
+    char ssid[ WIFI_AP_CACHE_MAX_SSID_LENGTH + 1U ];
+    uint8_t bssid[ 6 ];
+    uint8_t channel;
+    uint8_t band;                   /* cy_wcm_wifi_band_t of the channel. */
+} WifiApCacheEntry_t;
+
+
+/******************************************************************************
+ * Function Prototypes
+ *******************************************************************************/
+bool WifiApCache_Init( void );
+
+bool WifiApCache_Load( const char * pSsid,
+        WifiApCacheEntry_t * pEntry );
+
+bool WifiApCache_Save( const WifiApCacheEntry_t * pEntry );
+
+
+#endif /* ifndef WIFI_AP_CACHE_H_ */